@@ -0,0 +1,113 @@
+#include "adaptive_sampling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+const std::size_t SamplingOptions::DefaultSamples;
+constexpr double SamplingOptions::DefaultTolerance;
+
+// an interval between two samples, by index, and the error of its parent
+struct Interval {
+  std::size_t left;
+  std::size_t right;
+  double error;
+};
+
+// the distance of (mx, my) from the line through (ax, ay) and (bx, by)
+static double chordDistance(double ax, double ay, double bx, double by, double mx, double my){
+  double dx = bx - ax;
+  double dy = by - ay;
+  double length = std::hypot(dx, dy);
+  if(length == 0){
+    return std::hypot(mx - ax, my - ay);
+  }
+  return std::abs(dx * (ay - my) - (ax - mx) * dy) / length;
+}
+
+SampledCurve sampleAdaptively(const BatchFunction & function, double minX, double maxX,
+                              const SamplingOptions & options){
+  std::size_t budget = std::max<std::size_t>(options.samples, 2);
+  std::size_t intervals = std::min(InitialIntervals, budget - 1);
+
+  // the samples in the order they were taken
+  std::vector<double> x(intervals + 1);
+  std::vector<double> y;
+  for(std::size_t i = 0; i < intervals; ++i){
+    x[i] = minX + (maxX - minX) * i / intervals;
+  }
+  x[intervals] = maxX;
+  function(x, y);
+
+  std::vector<Interval> pending;
+  for(std::size_t i = 0; i < intervals; ++i){
+    pending.push_back(Interval{i, i + 1, std::numeric_limits<double>::infinity()});
+  }
+
+  double scaleX = PlotSize / (maxX - minX);
+  std::vector<double> midX, midY;
+  while(!pending.empty() && x.size() < budget){
+
+    // the rest of the budget goes to the largest errors
+    if(pending.size() > budget - x.size()){
+      std::stable_sort(pending.begin(), pending.end(),
+                       [](const Interval & a, const Interval & b){ return a.error > b.error; });
+      pending.resize(budget - x.size());
+    }
+
+    midX.clear();
+    for(const Interval & interval : pending){
+      midX.push_back(x[interval.left] + (x[interval.right] - x[interval.left]) / 2);
+    }
+    function(midX, midY);
+    std::size_t first = x.size();
+    x.insert(x.end(), midX.begin(), midX.end());
+    y.insert(y.end(), midY.begin(), midY.end());
+
+    // errors are measured at the scale the samples so far are drawn at
+    double minY = std::numeric_limits<double>::infinity();
+    double maxY = -minY;
+    for(double value : y){
+      if(std::isfinite(value)){
+        minY = std::min(minY, value);
+        maxY = std::max(maxY, value);
+      }
+    }
+    double scaleY = (maxY > minY) ? PlotSize / (maxY - minY) : 0;
+
+    std::vector<Interval> next;
+    for(std::size_t i = 0; i < pending.size(); ++i){
+      std::size_t left = pending[i].left;
+      std::size_t right = pending[i].right;
+      std::size_t middle = first + i;
+
+      // nothing is drawn through a point that is not finite
+      if(!std::isfinite(y[left]) || !std::isfinite(y[middle]) || !std::isfinite(y[right])){
+        continue;
+      }
+      double error = chordDistance(x[left] * scaleX, y[left] * scaleY, x[right] * scaleX, y[right] * scaleY,
+                                   x[middle] * scaleX, y[middle] * scaleY);
+      double halfWidth = (x[middle] - x[left]) * scaleX;
+      if(error > options.tolerance && halfWidth > options.tolerance){
+        next.push_back(Interval{left, middle, error});
+        next.push_back(Interval{middle, right, error});
+      }
+    }
+    pending.swap(next);
+  }
+
+  // order the samples by abscissa
+  std::vector<std::size_t> order(x.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&x](std::size_t a, std::size_t b){ return x[a] < x[b]; });
+
+  SampledCurve curve;
+  curve.x.reserve(x.size());
+  curve.y.reserve(y.size());
+  for(std::size_t i : order){
+    curve.x.push_back(x[i]);
+    curve.y.push_back(y[i]);
+  }
+  return curve;
+}
@@ -0,0 +1,73 @@
+/*! \file adaptive_sampling.hpp
+Defines the adaptive sampler continuous-plot draws functions with.
+
+The function is first sampled on a coarse uniform grid. Each round then
+samples the midpoint of every interval still to be refined, in one batch,
+and measures how far the midpoint is from the chord between the interval's
+ends, in the units of the 20 unit square the plot is drawn in. An interval
+whose midpoint is further than the tolerance has both halves refined in the
+next round, unless they are already narrower than the tolerance. Sampling
+stops when no interval is left or the sample budget is spent, the budget
+going to the intervals with the largest error first.
+
+Smooth curves are drawn from few samples, and samples concentrate where a
+curve bends sharply.
+ */
+#ifndef ADAPTIVE_SAMPLING_HPP
+#define ADAPTIVE_SAMPLING_HPP
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+/*! \struct SamplingOptions
+\brief The limits of adaptive sampling.
+*/
+struct SamplingOptions {
+
+  /// the default sample budget
+  static const std::size_t DefaultSamples = 1024;
+
+  /// the default tolerance, in plot units
+  static constexpr double DefaultTolerance = 0.05;
+
+  /// the most times the function is evaluated, at least 2
+  std::size_t samples = DefaultSamples;
+
+  /// the largest distance, in plot units, a line drawn between two samples
+  /// may be from the function at their midpoint
+  double tolerance = DefaultTolerance;
+};
+
+/*! \struct SampledCurve
+\brief The samples of a function, ordered by abscissa.
+*/
+struct SampledCurve {
+  std::vector<double> x;
+  std::vector<double> y;
+};
+
+/*! A function evaluated at a batch of points.
+  \param x the points
+  \param y set to the value of the function at each point, in order
+*/
+typedef std::function<void(const std::vector<double> & x, std::vector<double> & y)> BatchFunction;
+
+/// the number of intervals of the initial uniform grid
+const std::size_t InitialIntervals = 16;
+
+/// the width and height of the square a plot is drawn in
+const double PlotSize = 20;
+
+/*! Sample a function adaptively.
+  \param function the function, called once for the grid and once for each
+  round of refinement
+  \param minX the lower bound of the abscissa
+  \param maxX the upper bound of the abscissa, greater than minX
+  \param options the sample budget and tolerance
+  \return the samples
+*/
+SampledCurve sampleAdaptively(const BatchFunction & function, double minX, double maxX,
+                              const SamplingOptions & options = SamplingOptions());
+
+#endif
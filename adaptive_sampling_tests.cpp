@@ -0,0 +1,118 @@
+#include "catch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "adaptive_sampling.hpp"
+
+// a BatchFunction of f, counting its evaluations
+template <typename F>
+static BatchFunction counted(F f, std::size_t & evaluations) {
+  return [f, &evaluations](const std::vector<double> & x, std::vector<double> & y) {
+    y.clear();
+    for (double point : x) {
+      y.push_back(f(point));
+    }
+    evaluations += x.size();
+  };
+}
+
+// the largest distance, in plot units, from f to the lines between samples,
+// checked at points between each pair
+template <typename F>
+static double largestError(const SampledCurve & curve, F f, double minX, double maxX, double minY, double maxY) {
+  double scaleX = PlotSize / (maxX - minX);
+  double scaleY = PlotSize / (maxY - minY);
+  double largest = 0;
+  for (std::size_t i = 0; i + 1 < curve.x.size(); ++i) {
+    for (double t : {0.25, 0.5, 0.75}) {
+      double x = curve.x[i] + (curve.x[i + 1] - curve.x[i]) * t;
+      double line = curve.y[i] + (curve.y[i + 1] - curve.y[i]) * t;
+      double dx = (curve.x[i + 1] - curve.x[i]) * scaleX;
+      double dy = (curve.y[i + 1] - curve.y[i]) * scaleY;
+      largest = std::max(largest, std::abs(f(x) - line) * scaleY * dx / std::hypot(dx, dy));
+    }
+  }
+  return largest;
+}
+
+TEST_CASE( "Test adaptive sampling of a line", "[adaptive_sampling]" ) {
+
+  std::size_t evaluations = 0;
+  SampledCurve curve = sampleAdaptively(counted([](double x) { return 2 * x + 1; }, evaluations), -2, 2);
+
+  // the grid and one round of midpoints, which lie on the chords
+  REQUIRE(evaluations == 2 * InitialIntervals + 1);
+  REQUIRE(curve.x.size() == evaluations);
+  REQUIRE(curve.y.size() == evaluations);
+  REQUIRE(curve.x.front() == -2);
+  REQUIRE(curve.x.back() == 2);
+  REQUIRE(std::is_sorted(curve.x.begin(), curve.x.end()));
+  for (std::size_t i = 0; i < curve.x.size(); ++i) {
+    REQUIRE(curve.y[i] == Approx(2 * curve.x[i] + 1));
+  }
+}
+
+TEST_CASE( "Test adaptive sampling meets the tolerance", "[adaptive_sampling]" ) {
+
+  auto f = [](double x) { return std::sin(10 * x); };
+  for (double tolerance : {0.5, 0.05, 0.005}) {
+    INFO(tolerance);
+    std::size_t evaluations = 0;
+    SamplingOptions options;
+    options.samples = 100000;
+    options.tolerance = tolerance;
+    SampledCurve curve = sampleAdaptively(counted(f, evaluations), -2, 2, options);
+
+    REQUIRE(evaluations == curve.x.size());
+    REQUIRE(std::adjacent_find(curve.x.begin(), curve.x.end()) == curve.x.end());
+    // the distance is only measured at midpoints, so a line through a
+    // point where the curve changes its bend can be somewhat further
+    REQUIRE(largestError(curve, f, -2, 2, -1, 1) <= tolerance * 2);
+  }
+}
+
+TEST_CASE( "Test adaptive sampling concentrates samples at bends", "[adaptive_sampling]" ) {
+
+  // a kink away from the grid points
+  std::size_t evaluations = 0;
+  SampledCurve curve = sampleAdaptively(counted([](double x) { return std::abs(x - 0.3); }, evaluations), -2, 2);
+
+  std::size_t near = 0;
+  for (double x : curve.x) {
+    near += (std::abs(x - 0.3) < 0.25) ? 1 : 0;
+  }
+  // the interval around the kink is halved well below the grid spacing
+  REQUIRE(near > 5);
+  REQUIRE(evaluations < 100);
+}
+
+TEST_CASE( "Test adaptive sampling budget", "[adaptive_sampling]" ) {
+
+  auto f = [](double x) { return std::sin(50 * x); };
+  for (std::size_t samples : {2, 5, 17, 40, 200}) {
+    INFO(samples);
+    std::size_t evaluations = 0;
+    SamplingOptions options;
+    options.samples = samples;
+    SampledCurve curve = sampleAdaptively(counted(f, evaluations), 0, 1, options);
+
+    REQUIRE(evaluations == samples);
+    REQUIRE(curve.x.size() == samples);
+    REQUIRE(curve.x.front() == 0);
+    REQUIRE(curve.x.back() == 1);
+    REQUIRE(std::is_sorted(curve.x.begin(), curve.x.end()));
+  }
+}
+
+TEST_CASE( "Test adaptive sampling of values that are not finite", "[adaptive_sampling]" ) {
+
+  std::size_t evaluations = 0;
+  SampledCurve curve = sampleAdaptively(counted([](double x) { return std::sqrt(x); }, evaluations), -2, 2);
+
+  REQUIRE(evaluations == curve.x.size());
+  REQUIRE(evaluations < SamplingOptions::DefaultSamples);
+  REQUIRE(std::isnan(curve.y.front()));
+  REQUIRE(curve.y.back() == Approx(std::sqrt(2)));
+}
@@ -0,0 +1,365 @@
+#include "ast_cache.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <sstream>
+
+// identifies a cache file and the layout of its numbers
+const char MAGIC[8] = {'P', 'L', 'S', 'A', 'S', 'T', '1', '\0'};
+const std::uint32_t ORDER_MARK = 0x01020304;
+
+// record tags in a cache file
+const char FORM_RECORD = 'F';
+const char INVALID_RECORD = 'X';
+const char END_RECORD = 'E';
+
+// atom kinds in a serialized tree
+enum AtomTag : unsigned char { NoneTag, NumberTag, NewSymbolTag, SymbolTag, StringTag };
+
+// longest string or tail accepted when reading, guards against corrupt data
+const std::uint32_t MAX_LENGTH = 1u << 30;
+
+// trees are read and written through the stream buffer, which avoids the
+// cost of a stream sentry for every small value
+
+template <typename T>
+static bool writeValue(std::streambuf & out, const T & value){
+  return out.sputn(reinterpret_cast<const char *>(&value), sizeof(T)) == sizeof(T);
+}
+
+template <typename T>
+static bool readValue(std::streambuf & in, T & value){
+  return in.sgetn(reinterpret_cast<char *>(&value), sizeof(T)) == sizeof(T);
+}
+
+// lengths and symbol numbers are written seven bits per byte, low bits first
+static bool writeCount(std::streambuf & out, std::uint32_t count){
+  while(count >= 0x80){
+    if(out.sputc(static_cast<char>((count & 0x7f) | 0x80)) == std::char_traits<char>::eof()) return false;
+    count >>= 7;
+  }
+  return out.sputc(static_cast<char>(count)) != std::char_traits<char>::eof();
+}
+
+static bool readCount(std::streambuf & in, std::uint32_t & count){
+  count = 0;
+  for(int shift = 0; shift < 35; shift += 7){
+    int byte = in.sbumpc();
+    if(byte == std::char_traits<char>::eof()) return false;
+    count |= static_cast<std::uint32_t>(byte & 0x7f) << shift;
+    if((byte & 0x80) == 0) return count <= MAX_LENGTH;
+  }
+  return false;
+}
+
+static bool writeText(std::streambuf & out, const std::string & text){
+  return writeCount(out, static_cast<std::uint32_t>(text.size())) &&
+    out.sputn(text.data(), text.size()) == static_cast<std::streamsize>(text.size());
+}
+
+static bool readText(std::streambuf & in, std::string & text){
+  std::uint32_t length;
+  if(!readCount(in, length)) return false;
+  text.resize(length);
+  return in.sgetn(&text[0], length) == length;
+}
+
+std::uint64_t hashContent(std::istream & stream){
+  std::uint64_t hash = 14695981039346656037ull;
+  char buffer[65536];
+  while(stream.read(buffer, sizeof(buffer)) || stream.gcount() > 0){
+    std::streamsize count = stream.gcount();
+    for(std::streamsize i = 0; i < count; ++i){
+      hash ^= static_cast<unsigned char>(buffer[i]);
+      hash *= 1099511628211ull;
+    }
+  }
+  return hash;
+}
+
+// Write the head and tail length of node, numbering symbols in order of
+// first appearance: the first occurrence of a symbol is written as its
+// name, later ones as its number.
+static bool writeNode(std::streambuf & out, const Expression & node, SymbolNumbers & symbols){
+  const Atom & head = node.head();
+  if(node.isPacked()) return false;
+
+  bool ok;
+  if(head.isNone()){
+    ok = writeValue(out, static_cast<unsigned char>(NoneTag));
+  }
+  else if(head.isNumber()){
+    ok = writeValue(out, static_cast<unsigned char>(NumberTag)) && writeValue(out, head.asNumber());
+  }
+  else if(head.isSymbol()){
+    auto found = symbols.find(head.asSymbolId());
+    if(found == symbols.end()){
+      ok = writeValue(out, static_cast<unsigned char>(NewSymbolTag)) && writeText(out, head.asSymbol());
+      symbols.emplace(head.asSymbolId(), static_cast<std::uint32_t>(symbols.size()));
+    }
+    else{
+      ok = writeValue(out, static_cast<unsigned char>(SymbolTag)) && writeCount(out, found->second);
+    }
+  }
+  else if(head.isString()){
+    ok = writeValue(out, static_cast<unsigned char>(StringTag)) && writeText(out, head.asString());
+  }
+  else{
+    return false;
+  }
+
+  return ok && writeCount(out, node.getTailLength());
+}
+
+// Write ast in pre-order. The tails still to be written are kept on an
+// explicit stack, as the parser does, so deeply nested forms do not
+// overflow the call stack.
+static bool writeTree(std::streambuf & out, const Expression & ast, SymbolNumbers & symbols){
+  typedef Expression::ConstIteratorType Iterator;
+  std::vector<std::pair<Iterator, Iterator> > pending;
+
+  if(!writeNode(out, ast, symbols)) return false;
+  pending.emplace_back(ast.tailConstBegin(), ast.tailConstEnd());
+  while(!pending.empty()){
+    std::pair<Iterator, Iterator> & top = pending.back();
+    if(top.first == top.second){
+      pending.pop_back();
+      continue;
+    }
+    const Expression & node = *top.first;
+    ++top.first;
+    if(!writeNode(out, node, symbols)) return false;
+    if(node.getTailLength() > 0){
+      pending.emplace_back(node.tailConstBegin(), node.tailConstEnd());
+    }
+  }
+  return true;
+}
+
+// a node whose tail is being read
+struct PartialNode {
+  Atom head;
+  std::uint32_t remaining;
+  std::vector<Expression> tail;
+};
+
+// Read the head and tail length of a node written by writeNode with the
+// same symbol numbering.
+static bool readNode(std::streambuf & in, Atom & head, std::uint32_t & length, std::vector<SymbolId> & symbols){
+  unsigned char tag;
+  if(!readValue(in, tag)) return false;
+
+  std::string text;
+  switch(tag){
+  case NoneTag:
+    head = Atom();
+    break;
+  case NumberTag:{
+    double value;
+    if(!readValue(in, value)) return false;
+    head = Atom(value);
+    break;
+  }
+  case NewSymbolTag:
+    // a symbol is rebuilt from its text exactly as parsed
+    if(!readText(in, text) || text.empty()) return false;
+    head = Atom(text.data(), text.size());
+    if(!head.isSymbol()) return false;
+    symbols.push_back(head.asSymbolId());
+    break;
+  case SymbolTag:{
+    std::uint32_t number;
+    if(!readCount(in, number) || number >= symbols.size()) return false;
+    head = Atom::fromSymbolId(symbols[number]);
+    break;
+  }
+  case StringTag:
+    if(!readText(in, text) || text.empty()) return false;
+    head = Atom(text.data(), text.size());
+    if(!head.isString()) return false;
+    break;
+  default:
+    return false;
+  }
+
+  return readCount(in, length);
+}
+
+// Read a tree written by writeTree. Nodes are built once their tails are
+// complete, the unfinished ones kept on an explicit stack.
+static bool readTree(std::streambuf & in, Expression & ast, std::vector<SymbolId> & symbols){
+  std::vector<PartialNode> pending;
+
+  while(true){
+    Atom head;
+    std::uint32_t length;
+    if(!readNode(in, head, length, symbols)) return false;
+
+    if(length > 0){
+      // reserve in steps, so a corrupt length cannot allocate much before failing
+      pending.push_back(PartialNode{head, length, std::vector<Expression>()});
+      pending.back().tail.reserve(std::min<std::uint32_t>(length, 4096));
+      continue;
+    }
+
+    // complete the nodes whose last element this is
+    Expression node(head, std::vector<Expression>());
+    while(!pending.empty()){
+      PartialNode & parent = pending.back();
+      parent.tail.push_back(std::move(node));
+      if(--parent.remaining > 0){
+	break;
+      }
+      node = Expression(parent.head, std::move(parent.tail));
+      pending.pop_back();
+    }
+    if(pending.empty()){
+      ast = std::move(node);
+      return true;
+    }
+  }
+}
+
+bool writeAst(std::ostream & out, const Expression & ast){
+  SymbolNumbers symbols;
+  return out.rdbuf() && writeTree(*out.rdbuf(), ast, symbols);
+}
+
+bool readAst(std::istream & in, Expression & ast){
+  std::vector<SymbolId> symbols;
+  return in.rdbuf() && readTree(*in.rdbuf(), ast, symbols);
+}
+
+std::string astCachePath(const std::string & filename){
+  return filename + ".ast";
+}
+
+// a name for a new cache file, unique to this writer so that processes
+// caching the same script do not write or rename each other's files
+static std::string tempCachePath(const std::string & cachePath, const void * writer){
+  std::random_device device;
+  std::uint64_t suffix = (static_cast<std::uint64_t>(device()) << 32) ^ device() ^
+    static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()) ^
+    reinterpret_cast<std::uintptr_t>(writer);
+  std::ostringstream name;
+  name << cachePath << '.' << std::hex << suffix << ".tmp";
+  return name.str();
+}
+
+ScriptReader::ScriptReader(const std::string & filename):
+  m_filename(filename), m_cachePath(astCachePath(filename)), m_tempPath(tempCachePath(m_cachePath, this)),
+  m_hash(0), m_open(false), m_fromCache(false), m_done(false), m_count(0), m_source(filename, std::ios::binary){
+
+  if(!m_source) return;
+  m_open = true;
+
+  m_hash = hashContent(m_source);
+  m_source.clear();
+  m_source.seekg(0);
+
+  // use the cache if it was written for this content
+  m_cache.open(m_cachePath, std::ios::binary);
+  char magic[sizeof(MAGIC)];
+  std::uint32_t order;
+  std::uint64_t hash;
+  if(m_cache.read(magic, sizeof(magic)) && std::equal(magic, magic + sizeof(magic), MAGIC) &&
+     readValue(*m_cache.rdbuf(), order) && order == ORDER_MARK &&
+     readValue(*m_cache.rdbuf(), hash) && hash == m_hash){
+    m_fromCache = true;
+    return;
+  }
+  m_cache.close();
+
+  m_forms.reset(new FormReader(m_source));
+  m_writer.open(m_tempPath, std::ios::binary | std::ios::trunc);
+  if(m_writer){
+    m_writer.write(MAGIC, sizeof(MAGIC));
+    writeValue(*m_writer.rdbuf(), ORDER_MARK);
+    writeValue(*m_writer.rdbuf(), m_hash);
+  }
+}
+
+ScriptReader::~ScriptReader(){
+  if(m_writer.is_open()){
+    m_writer.close();
+    std::remove(m_tempPath.c_str());
+  }
+}
+
+bool ScriptReader::isOpen() const noexcept{
+  return m_open;
+}
+
+bool ScriptReader::fromCache() const noexcept{
+  return m_fromCache;
+}
+
+bool ScriptReader::next(Expression & ast){
+  if(!m_open || m_done) return false;
+
+  if(m_fromCache){
+    char record;
+    if(readValue(*m_cache.rdbuf(), record)){
+      if(record == END_RECORD){
+	m_done = true;
+	return false;
+      }
+      if(record == INVALID_RECORD){
+	ast = Expression();
+	++m_count;
+	return true;
+      }
+      if(record == FORM_RECORD && readTree(*m_cache.rdbuf(), ast, m_readSymbols)){
+	++m_count;
+	return true;
+      }
+    }
+    recover();
+  }
+
+  return parseNext(ast);
+}
+
+bool ScriptReader::parseNext(Expression & ast){
+  std::string form;
+  if(!m_forms->next(form)){
+    m_done = true;
+
+    // every form has been read, install the new cache
+    if(m_writer.is_open()){
+      bool ok = writeValue(*m_writer.rdbuf(), END_RECORD);
+      m_writer.close();
+      if(!ok || !m_writer || std::rename(m_tempPath.c_str(), m_cachePath.c_str()) != 0){
+	std::remove(m_tempPath.c_str());
+      }
+    }
+    return false;
+  }
+
+  ast = parse(form.data(), form.size());
+  ++m_count;
+
+  if(m_writer.is_open()){
+    bool parsed = (ast != Expression());
+    if(!writeValue(*m_writer.rdbuf(), parsed ? FORM_RECORD : INVALID_RECORD) ||
+       (parsed && !writeTree(*m_writer.rdbuf(), ast, m_writeSymbols))){
+      m_writer.close();
+      std::remove(m_tempPath.c_str());
+    }
+  }
+  return true;
+}
+
+void ScriptReader::recover(){
+  // the cache is damaged: remove it and parse the rest of the script
+  m_fromCache = false;
+  m_cache.close();
+  std::remove(m_cachePath.c_str());
+
+  m_forms.reset(new FormReader(m_source));
+  std::string form;
+  for(std::size_t i = 0; i < m_count && m_forms->next(form); ++i){
+  }
+}
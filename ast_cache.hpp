@@ -0,0 +1,108 @@
+/*! \file ast_cache.hpp
+Defines a compact binary form of parsed Expressions, and a cache of the
+parsed forms of a script file kept next to it.
+ */
+#ifndef AST_CACHE_HPP
+#define AST_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "expression.hpp"
+#include "parse.hpp"
+
+/*! \typedef SymbolNumbers
+Numbers given to the symbols written to a cache, in order of first appearance.
+ */
+typedef std::unordered_map<SymbolId, std::uint32_t> SymbolNumbers;
+
+/// return the 64-bit FNV-1a hash of the characters remaining in stream
+std::uint64_t hashContent(std::istream & stream);
+
+/*! Write an abstract syntax tree in binary form.
+
+  Only what the parser produces is supported: Number, Symbol and String
+  atoms and unpacked tails. Properties are not written. A symbol is written
+  by name once and by number afterwards.
+  \param out the destination stream
+  \param ast the tree to write
+  \return false if ast holds anything the parser cannot produce
+*/
+bool writeAst(std::ostream & out, const Expression & ast);
+
+/*! Read an abstract syntax tree written by writeAst.
+  \param in the source stream
+  \param ast the tree read
+  \return false if the data is truncated or malformed
+*/
+bool readAst(std::istream & in, Expression & ast);
+
+/// return the name of the cache file kept for the script filename
+std::string astCachePath(const std::string & filename);
+
+/*! \class ScriptReader
+\brief Reads the top-level forms of a script file as abstract syntax trees.
+
+Next to the script is a cache holding its parsed forms and a hash of its
+content. When the hash matches the script, forms are read from the cache
+and nothing is parsed. Otherwise the script is read with FormReader and
+parsed, and the forms are written to a new cache, which replaces the old
+one once the last form has been read. Failing to write the cache is not
+an error.
+*/
+class ScriptReader {
+public:
+
+  /// open the script filename
+  explicit ScriptReader(const std::string & filename);
+
+  /// remove an unfinished cache
+  ~ScriptReader();
+
+  /// return true if the script could be opened
+  bool isOpen() const noexcept;
+
+  /// return true if forms are read from the cache
+  bool fromCache() const noexcept;
+
+  /*! Read the next form.
+    \param ast set to the form, or to the None Expression if it does not parse
+    \return false at the end of the script
+  */
+  bool next(Expression & ast);
+
+private:
+
+  // switch from the cache to parsing the script, skipping the forms already read
+  void recover();
+
+  // read the next form from the script itself
+  bool parseNext(Expression & ast);
+
+  std::string m_filename;
+  std::string m_cachePath;
+  std::string m_tempPath;
+  std::uint64_t m_hash;
+  bool m_open;
+  bool m_fromCache;
+  bool m_done;
+  std::size_t m_count;
+
+  std::ifstream m_source;
+  std::unique_ptr<FormReader> m_forms;
+  std::ifstream m_cache;
+  std::ofstream m_writer;
+
+  // symbols are numbered across the whole cache, not per form
+  std::vector<SymbolId> m_readSymbols;
+  SymbolNumbers m_writeSymbols;
+};
+
+#endif
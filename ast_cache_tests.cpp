@@ -0,0 +1,172 @@
+#include "catch.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ast_cache.hpp"
+#include "interpreter.hpp"
+
+// write text to filename, replacing it
+static void writeFile(const std::string & filename, const std::string & text) {
+  std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+  out << text;
+}
+
+// read every form of filename with a ScriptReader
+static std::vector<Expression> readForms(const std::string & filename, bool & fromCache) {
+  ScriptReader reader(filename);
+  REQUIRE(reader.isOpen());
+  fromCache = reader.fromCache();
+  std::vector<Expression> forms;
+  Expression form;
+  while (reader.next(form)) {
+    forms.push_back(form);
+  }
+  return forms;
+}
+
+TEST_CASE( "Test AST serialization", "[ast_cache]" ) {
+
+  std::string program = "(begin (define s \"a string\") (define f (lambda (x) (* x -2.5e-3))) "
+                        "(list 1 0.1 pi s (f 3)))";
+  Expression ast = parse(program.data(), program.size());
+  REQUIRE(ast != Expression());
+
+  std::stringstream buffer;
+  REQUIRE(writeAst(buffer, ast));
+
+  Expression copy;
+  REQUIRE(readAst(buffer, copy));
+  REQUIRE(copy == ast);
+  REQUIRE(copy.getValueInTail(1).getValueInTail(1).head().isString() == false);
+  REQUIRE(copy.getValueInTail(0).getValueInTail(1).head().isString());
+
+  // truncated data is rejected
+  std::string data = buffer.str();
+  std::stringstream truncated(std::string(data, 0, data.size() / 2));
+  REQUIRE(!readAst(truncated, copy));
+
+  // only what the parser produces can be written
+  std::stringstream unsupported;
+  REQUIRE(!writeAst(unsupported, Expression(std::vector<double>({1, 2}))));
+  REQUIRE(!writeAst(unsupported, Expression(Atom(std::complex<double>(0, 1)))));
+}
+
+TEST_CASE( "Test AST serialization of deeply nested forms", "[ast_cache]" ) {
+
+  // deeper than the call stack allows a recursive writer or reader
+  const std::size_t depth = 200000;
+  std::string program;
+  for (std::size_t i = 0; i < depth; ++i) {
+    program += "(list ";
+  }
+  program += "1" + std::string(depth, ')');
+  Expression ast = parse(program.data(), program.size());
+  // compared outside REQUIRE, which would print the tree recursively
+  bool parsed = (ast != Expression());
+  REQUIRE(parsed);
+
+  std::stringstream buffer;
+  REQUIRE(writeAst(buffer, ast));
+  Expression copy;
+  REQUIRE(readAst(buffer, copy));
+
+  std::size_t levels = 0;
+  const Expression * node = &copy;
+  while (node->getTailLength() == 1 && node->head() == Atom(std::string("list"))) {
+    node = &*node->tailConstBegin();
+    ++levels;
+  }
+  REQUIRE(levels == depth);
+  REQUIRE(*node == Expression(1.));
+}
+
+TEST_CASE( "Test script AST cache", "[ast_cache]" ) {
+
+  const std::string filename = "ast_cache_test.pls";
+  const std::string cache = astCachePath(filename);
+  std::remove(cache.c_str());
+
+  writeFile(filename, "(define a 1) ; comment\n(+ a 2) (1abc) \"text\"");
+
+  bool fromCache;
+  std::vector<Expression> cold = readForms(filename, fromCache);
+  REQUIRE(!fromCache);
+  REQUIRE(cold.size() == 4);
+  REQUIRE(cold[2] == Expression());
+
+  INFO("the second read uses the cache and gives the same forms")
+  std::vector<Expression> warm = readForms(filename, fromCache);
+  REQUIRE(fromCache);
+  REQUIRE(warm == cold);
+
+  INFO("changing the script invalidates the cache")
+  writeFile(filename, "(define a 2)");
+  std::vector<Expression> changed = readForms(filename, fromCache);
+  REQUIRE(!fromCache);
+  REQUIRE(changed.size() == 1);
+  REQUIRE(readForms(filename, fromCache) == changed);
+  REQUIRE(fromCache);
+
+  INFO("a damaged cache is dropped and the script parsed")
+  writeFile(filename, "(define a 1) (+ a 2) (+ a 3)");
+  readForms(filename, fromCache);
+  {
+    std::fstream damage(cache, std::ios::binary | std::ios::in | std::ios::out);
+    damage.seekp(0, std::ios::end);
+    std::streamoff size = damage.tellp();
+    // the atom tag of the 3 in the last form, before its number, tail length and end record
+    damage.seekp(size - 11);
+    damage.put('\x7f');
+  }
+  std::vector<Expression> recovered = readForms(filename, fromCache);
+  REQUIRE(fromCache);
+  REQUIRE(recovered.size() == 3);
+  REQUIRE(recovered[2] == parse(std::string("(+ a 3)").data(), 7));
+
+  INFO("readers caching the same script at once each write their own file")
+  writeFile(filename, "(define a 1) (+ a 2) (+ a 3)");
+  {
+    ScriptReader first(filename);
+    REQUIRE(!first.fromCache());
+    Expression form;
+    REQUIRE(first.next(form));
+    {
+      // a reader that stops early removes only its own unfinished cache
+      ScriptReader abandoned(filename);
+      REQUIRE(!abandoned.fromCache());
+      REQUIRE(abandoned.next(form));
+    }
+    while (first.next(form)) {
+    }
+  }
+  {
+    ScriptReader reader(filename);
+    std::vector<Expression> forms;
+    Expression form;
+    while (reader.next(form)) {
+      forms.push_back(form);
+    }
+    REQUIRE(reader.fromCache());
+    REQUIRE(forms.size() == 3);
+    REQUIRE(forms[2] == parse(std::string("(+ a 3)").data(), 7));
+  }
+
+  INFO("an interpreter loads a single-expression file through the cache")
+  writeFile(filename, "(begin (define b 4) (* b 2))");
+  for (int i = 0; i < 2; ++i) {
+    Interpreter interp;
+    REQUIRE(interp.parseFile(filename));
+    REQUIRE(interp.evaluate() == Expression(8.));
+  }
+  writeFile(filename, "(+ 1 2) (+ 3 4)");
+  Interpreter interp;
+  REQUIRE(!interp.parseFile(filename));
+  REQUIRE(!interp.parseFile("no_such_file.pls"));
+
+  std::remove(filename.c_str());
+  std::remove(cache.c_str());
+}
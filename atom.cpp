@@ -1,63 +1,166 @@
 #include "atom.hpp"
 
 #include <sstream>
+#include <cstdint>
 #include <cctype>
 #include <cmath>
 #include <limits>
 #include <iostream>
 
+#include "closure.hpp"
+
 Atom::Atom(): m_type(NoneKind) {}
 
-Atom::Atom(double value){
+Atom::Atom(double value): Atom(){
 
   setNumber(value);
 }
 
 Atom::Atom(const Token & token): Atom(){
+  std::string text = token.asString();
+  setFromText(text.data(), text.size());
+}
+
+Atom::Atom(const char * text, std::size_t length): Atom(){
+  setFromText(text, length);
+}
+
+// result of the fast number parser
+enum NumberParse {IsNumber, NotNumber, NeedsStream};
+
+// exactly representable powers of ten
+static const double exactPowers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+				     1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// Parse a decimal number without a stream or locale. Succeeds only when the
+// whole text is a number whose value is exact in a single multiplication or
+// division (at most 15 significant digits and a power of ten of at most 22),
+// so the result is correctly rounded, as from a stream. Text that might still
+// be read by a stream is left to it.
+static NumberParse parseNumber(const char * text, std::size_t length, double & value){
+  const char * p = text;
+  const char * end = text + length;
+
+  bool negative = false;
+  if(p != end && (*p == '-' || *p == '+')){
+    negative = (*p == '-');
+    ++p;
+  }
+  if(p == end || (!std::isdigit(static_cast<unsigned char>(*p)) && *p != '.')){
+    // a stream can only read a number starting with a digit or a point
+    return (p == text || p == end) ? NotNumber : NeedsStream;
+  }
+
+  std::uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool anyDigit = false;
+
+  for(; p != end && std::isdigit(static_cast<unsigned char>(*p)); ++p){
+    anyDigit = true;
+    if(mantissa != 0 || *p != '0'){
+      mantissa = mantissa * 10 + (*p - '0');
+      if(++digits > 15) return NeedsStream;
+    }
+  }
+  if(p != end && *p == '.'){
+    for(++p; p != end && std::isdigit(static_cast<unsigned char>(*p)); ++p){
+      anyDigit = true;
+      if(mantissa != 0 || *p != '0'){
+	mantissa = mantissa * 10 + (*p - '0');
+	if(++digits > 15) return NeedsStream;
+      }
+      --exponent;
+    }
+  }
+  if(!anyDigit) return NeedsStream;
+
+  if(p != end && (*p == 'e' || *p == 'E')){
+    ++p;
+    bool negativeExponent = false;
+    if(p != end && (*p == '-' || *p == '+')){
+      negativeExponent = (*p == '-');
+      ++p;
+    }
+    if(p == end) return NeedsStream;
+    int explicitExponent = 0;
+    for(; p != end && std::isdigit(static_cast<unsigned char>(*p)); ++p){
+      if(explicitExponent > 1000) return NeedsStream;
+      explicitExponent = explicitExponent * 10 + (*p - '0');
+    }
+    exponent += negativeExponent ? -explicitExponent : explicitExponent;
+  }
+  if(p != end) return NeedsStream;
+
+  double result = static_cast<double>(mantissa);
+  if(mantissa != 0){
+    if(exponent < -22 || exponent > 22) return NeedsStream;
+    result = (exponent < 0) ? result / exactPowers[-exponent] : result * exactPowers[exponent];
+  }
+  value = negative ? -result : result;
+  return IsNumber;
+}
+
+void Atom::setFromText(const char * text, std::size_t length){
+  if(length == 0) return;
+
   // is token a number?
   double temp;
-  std::istringstream iss(token.asString());
-  if(iss >> temp){
-    // check for trailing characters if >> succeeds
-    if(iss.rdbuf()->in_avail() == 0){
-      setNumber(temp);
+  NumberParse parsed = parseNumber(text, length, temp);
+  if(parsed == IsNumber){
+    setNumber(temp);
+    return;
+  }
+  if(parsed == NeedsStream){
+    std::istringstream iss(std::string(text, length));
+    if(iss >> temp){
+      // check for trailing characters if >> succeeds
+      if(iss.rdbuf()->in_avail() == 0){
+	setNumber(temp);
+      }
+      return;
     }
   }
-  else{ // else assume symbol
-    // make sure does not start with number
-    if(!std::isdigit(token.asString()[0])){
-		bool startQuote = false;
-		bool endQuote = false;
-		bool middleQuote = true;
-		int quoteCount = 0;
-		if (token.asString()[0] == '"') {
-			startQuote = true;
-		}
-		if (token.asString()[token.asString().length() - 1] == '"') {
-			endQuote = true;
-		}
-		for (unsigned int i = 0; i < token.asString().length(); i++) {
-			if (token.asString()[i] == '"') {
-				quoteCount++;
-			}
-		}
-		if (quoteCount == 2) {
-			middleQuote = false;
-		}
-		if (startQuote && endQuote && !middleQuote) {
-			setString(token.asString());
-		}
-		else {
-			setSymbol(token.asString());
-		}
 
+  // else assume symbol, make sure does not start with number
+  if(!std::isdigit(static_cast<unsigned char>(text[0]))){
+    // a string is a token quoted at both ends with no other quotes
+    int quoteCount = 0;
+    for(std::size_t i = 0; i < length; i++){
+      if(text[i] == '"'){
+	quoteCount++;
+      }
+    }
+    if(text[0] == '"' && text[length - 1] == '"' && quoteCount == 2){
+      setString(std::string(text, length));
+    }
+    else{
+      setSymbol(std::string(text, length));
     }
   }
 }
 
+Atom Atom::fromSymbolId(SymbolId id) {
+  Atom a;
+  a.setSymbol(id);
+  return a;
+}
+
+Atom Atom::fromParameter(SymbolId id, std::uint32_t slot) {
+  Atom a;
+  a.setParameter(ParameterValue{id, slot});
+  return a;
+}
+
+Atom Atom::fromClosure(std::shared_ptr<const Closure> closure) {
+  Atom a;
+  a.setLambda(std::move(closure));
+  return a;
+}
+
 Atom::Atom(const std::string & value): Atom() {
   if (value == "lambda") {
-	  setLambda(value);
+	  setLambda(nullptr);
   }
   else if (value.front() == '"') {
 	  setString(value);
@@ -70,76 +173,55 @@ Atom::Atom(const std::string & value): Atom() {
   }
 }
 
-Atom::Atom(const std::complex<double> & value) {
+Atom::Atom(const std::complex<double> & value): Atom() {
 	setComplex(value);
 }
 
-Atom::Atom(const bool & value) {
+Atom::Atom(const bool & value): Atom() {
 	setList(value);
 }
 
 Atom::Atom(const Atom & x): Atom(){
-  if(x.isNumber()){
-    setNumber(x.numberValue);
-  }
-  else if(x.isSymbol()){
-    setSymbol(x.stringValue);
-  }
-  else if (x.isComplex()) {
-	  setComplex(x.complexValue);
-  }
-  else if (x.isList()) {
-	  setList(x.listValue);
-  }
-  else if (x.isLambda()) {
-	  setLambda(x.lambdaValue);
-  }
-  else if (x.isString()) {
-	  setString(x.stringValue);
-  }
-  else if (x.isError()) {
-	  setError(x.errorValue);
-  }
+  copy(x);
+}
+
+Atom::Atom(Atom && x) noexcept: Atom(){
+  move(std::move(x));
 }
 
 Atom & Atom::operator=(const Atom & x){
   if(this != &x){
-    if(x.m_type == NoneKind){
-      m_type = NoneKind;
-    }
-    else if(x.m_type == NumberKind){
-      setNumber(x.numberValue);
-    }
-    else if(x.m_type == SymbolKind){
-      setSymbol(x.stringValue);
-    }
-	else if (x.m_type == ComplexKind) {
-		setComplex(x.complexValue);
-	}
-	else if (x.m_type == ListKind) {
-		setList(x.listValue);
-	}
-	else if (x.m_type == LambdaKind) {
-		setLambda(x.lambdaValue);
-	}
-	else if (x.m_type == StringKind) {
-		setString(x.stringValue);
-	}
-	else if (x.m_type == ErrorKind) {
-		setError(x.errorValue);
-	}
+    reset();
+    copy(x);
+  }
+  return *this;
+}
+
+Atom & Atom::operator=(Atom && x) noexcept{
+  if(this != &x){
+    reset();
+    move(std::move(x));
   }
   return *this;
 }
   
 Atom::~Atom(){
 
-  // we need to ensure the destructor of the symbol string is called
-  if(m_type == SymbolKind){
-    stringValue.~basic_string();
-  }
-  else if (m_type == LambdaKind) {
-	 lambdaValue.~basic_string();
+  // we need to ensure the destructor of the string members is called
+  reset();
+}
+
+void Atom::reset() noexcept{
+
+  if (m_type == LambdaKind) {
+	 // dropping the last owner besides the bindings the closure captured
+	 // may leave them reachable only through themselves
+	 std::shared_ptr<const Environment> captured;
+	 if (closureValue.use_count() == 2) {
+		 captured = closureValue->captured();
+	 }
+	 closureValue.~shared_ptr();
+	 Environment::release(captured);
   }
   else if (m_type == StringKind) {
 	  stringValue.~basic_string();
@@ -147,7 +229,60 @@ Atom::~Atom(){
   else if (m_type == ErrorKind) {
 	  errorValue.~basic_string();
   }
+  m_type = NoneKind;
+}
+
+void Atom::copy(const Atom & x){
+  switch(x.m_type){
+  case NoneKind:
+    break;
+  case NumberKind:
+    setNumber(x.numberValue);
+    break;
+  case SymbolKind:
+    setSymbol(x.symbolValue);
+    break;
+  case ComplexKind:
+    setComplex(x.complexValue);
+    break;
+  case ListKind:
+    setList(x.listValue);
+    break;
+  case LambdaKind:
+    setLambda(x.closureValue);
+    break;
+  case StringKind:
+    setString(x.stringValue);
+    break;
+  case ErrorKind:
+    setError(x.errorValue);
+    break;
+  case ParameterKind:
+    setParameter(x.parameterValue);
+    break;
+  }
+}
 
+void Atom::move(Atom && x) noexcept{
+  // the string kinds steal the buffer and a Lambda its closure,
+  // everything else is a plain copy
+  switch(x.m_type){
+  case LambdaKind:
+    new (&closureValue) std::shared_ptr<const Closure>(std::move(x.closureValue));
+    m_type = LambdaKind;
+    break;
+  case StringKind:
+    new (&stringValue) std::string(std::move(x.stringValue));
+    m_type = StringKind;
+    break;
+  case ErrorKind:
+    new (&errorValue) std::string(std::move(x.errorValue));
+    m_type = ErrorKind;
+    break;
+  default:
+    copy(x);
+    break;
+  }
 }
 
 bool Atom::isNone() const noexcept{
@@ -182,65 +317,76 @@ bool Atom::isError() const noexcept {
 	return m_type == ErrorKind;
 }
 
+bool Atom::isParameter() const noexcept {
+  return m_type == ParameterKind;
+}
+
 void Atom::setNumber(double value){
 
+  reset();
   m_type = NumberKind;
   numberValue = value;
 }
 
 void Atom::setSymbol(const std::string & value){
-  // we need to ensure the destructor of the symbol string is called
-  if(m_type == SymbolKind){
-    stringValue.~basic_string();
-  }
-    
-  m_type = SymbolKind;
 
-  // copy construct in place
-  new (&stringValue) std::string(value);
+  setSymbol(intern(value));
+}
+
+void Atom::setSymbol(SymbolId value){
+
+  reset();
+  m_type = SymbolKind;
+  symbolValue = value;
 }
 
 void Atom::setComplex(const std::complex<double> & value){
 
+	reset();
 	m_type = ComplexKind;
 	complexValue = value;
 }
 
 void Atom::setList(const bool & value) {
 
+	reset();
 	m_type = ListKind;
 
 	new (&listValue) bool(value);
 }
 
-void Atom::setLambda(const std::string & value) {
-	if (m_type == ListKind) {
-	}
+void Atom::setLambda(std::shared_ptr<const Closure> value) {
 
-	m_type = LambdaKind;
+	reset();
 
-	// copy construct in place
-	new (&lambdaValue) std::string(value);
+	// move construct in place
+	new (&closureValue) std::shared_ptr<const Closure>(std::move(value));
+	m_type = LambdaKind;
 }
 
 void Atom::setString(const std::string & value) {
-	if (m_type == StringKind) {
-	}
 
-	m_type = StringKind;
+	reset();
 
 	// copy construct in place
 	new (&stringValue) std::string(value);
+	m_type = StringKind;
 }
 
 void Atom::setError(const std::string & value) {
-	if (m_type == ErrorKind) {
-	}
 
-	m_type =ErrorKind;
+	reset();
 
 	// copy construct in place
 	new (&errorValue) std::string(value);
+	m_type = ErrorKind;
+}
+
+void Atom::setParameter(const ParameterValue & value){
+
+  reset();
+  m_type = ParameterKind;
+  parameterValue = value;
 }
 
 double Atom::asNumber() const noexcept{
@@ -254,12 +400,27 @@ std::string Atom::asSymbol() const noexcept{
   std::string result;
 
   if(m_type == SymbolKind){
-    result = stringValue;
+    result = SymbolTable::instance().name(symbolValue);
   }
 
   return result;
 }
 
+SymbolId Atom::asSymbolId() const noexcept{
+
+  return (m_type == SymbolKind) ? symbolValue : NoSymbol;
+}
+
+SymbolId Atom::asParameterSymbol() const noexcept{
+
+  return (m_type == ParameterKind) ? parameterValue.symbol : NoSymbol;
+}
+
+std::uint32_t Atom::asParameterSlot() const noexcept{
+
+  return (m_type == ParameterKind) ? parameterValue.slot : 0;
+}
+
 std::complex<double> Atom::asComplex() const noexcept {
 	std::complex<double> emptyComplex(0.0, 0.0);
 	return (m_type == ComplexKind) ? complexValue : emptyComplex;
@@ -283,12 +444,20 @@ std::string Atom::asLambda() const noexcept {
 	std::string result;
 
 	if (m_type ==LambdaKind) {
-		result = stringValue;
+		result = "lambda";
 	}
 
 	return result;
 }
 
+const Closure * Atom::asClosure() const noexcept {
+	return (m_type == LambdaKind) ? closureValue.get() : nullptr;
+}
+
+long Atom::closureUseCount() const noexcept {
+	return (m_type == LambdaKind) ? closureValue.use_count() : 0;
+}
+
 std::string Atom::asString() const noexcept {
 
 	std::string result;
@@ -333,7 +502,7 @@ bool Atom::operator==(const Atom & right) const noexcept{
     {
       if(right.m_type != SymbolKind) return false;
 
-      return stringValue == right.stringValue;
+      return symbolValue == right.symbolValue;
     }
 	break;
   case ComplexKind:
@@ -372,6 +541,9 @@ bool Atom::operator==(const Atom & right) const noexcept{
 	  return errorValue == right.errorValue;
   }
   break;
+  case ParameterKind:
+    return (parameterValue.symbol == right.parameterValue.symbol) &&
+      (parameterValue.slot == right.parameterValue.slot);
   default:
     return false;
   }
@@ -407,5 +579,8 @@ std::ostream & operator<<(std::ostream & out, const Atom & a){
   if (a.isError()) {
 	  out << a.asError();
   }
+  if (a.isParameter()) {
+	  out << SymbolTable::instance().name(a.asParameterSymbol());
+  }
   return out;
 }
@@ -5,10 +5,13 @@ Defines the Atom type and associated functions.
 #define ATOM_HPP
 
 #include "token.hpp"
+#include "symbol_table.hpp"
 #include <complex>
 #include <list>
+#include <memory>
 
 class Expression;
+class Closure;
 /*! \class Atom
 \brief A variant type that may be a Number or Symbol or the default type None.
 
@@ -35,12 +38,30 @@ public:
   /// Construct an Atom directly from a Token
   Atom(const Token & token);
 
+  /// Construct an Atom from the source text [text, text+length), as Atom(const Token &)
+  Atom(const char * text, std::size_t length);
+
+  /// Construct an Atom of type Symbol from an already interned id
+  static Atom fromSymbolId(SymbolId id);
+
+  /// Construct an Atom of type Parameter, a reference to parameter slot of a lambda named id
+  static Atom fromParameter(SymbolId id, std::uint32_t slot);
+
+  /// Construct an Atom of type Lambda holding the closure of a lambda value
+  static Atom fromClosure(std::shared_ptr<const Closure> closure);
+
   /// Copy-construct an Atom
   Atom(const Atom & x);
 
+  /// Move-construct an Atom, stealing any string value
+  Atom(Atom && x) noexcept;
+
   /// Assign an Atom
   Atom & operator=(const Atom & x);
 
+  /// Move-assign an Atom, stealing any string value
+  Atom & operator=(Atom && x) noexcept;
+
   /// Atom destructor
   ~Atom();
 
@@ -68,12 +89,24 @@ public:
   /// predicate to determine if an Atom is of type Lambda
   bool isError() const noexcept;
 
+  /// predicate to determine if an Atom is of type Parameter
+  bool isParameter() const noexcept;
+
   /// value of Atom as a number, return 0 if not a Number
   double asNumber() const noexcept;
 
   /// value of Atom as a number, returns empty-string if not a Symbol
   std::string asSymbol() const noexcept;
 
+  /// interned id of a Symbol, returns NoSymbol if not a Symbol
+  SymbolId asSymbolId() const noexcept;
+
+  /// interned id of a Parameter's name, returns NoSymbol if not a Parameter
+  SymbolId asParameterSymbol() const noexcept;
+
+  /// slot of a Parameter, returns 0 if not a Parameter
+  std::uint32_t asParameterSlot() const noexcept;
+
   /// value of Atom as a complex, returns 0 if not a Complex
   std::complex<double> asComplex() const noexcept;
 
@@ -83,6 +116,12 @@ public:
   /// value of Atom as a lambda, returns empty-string if not a Lambda
   std::string asLambda() const noexcept;
 
+  /// closure of a Lambda, returns nullptr if not a Lambda made by fromClosure
+  const Closure * asClosure() const noexcept;
+
+  /// number of owners sharing the closure of a Lambda, returns 0 if it has none
+  long closureUseCount() const noexcept;
+
   /// value of Atom as a number, returns empty-string if not a string
   std::string asString() const noexcept;
 
@@ -95,7 +134,13 @@ public:
 private:
 
   // internal enum of known types
-  enum Type {NoneKind, NumberKind, SymbolKind, ComplexKind, ListKind, LambdaKind, StringKind, ErrorKind};
+  enum Type {NoneKind, NumberKind, SymbolKind, ComplexKind, ListKind, LambdaKind, StringKind, ErrorKind, ParameterKind};
+
+  // the value of a Parameter
+  struct ParameterValue {
+    SymbolId symbol;
+    std::uint32_t slot;
+  };
 
   // track the type
   Type m_type;
@@ -104,19 +149,36 @@ private:
   // when setting non POD values (see setSymbol)
   union {
     double numberValue;
+	SymbolId symbolValue;
 	std::string stringValue;
 	std::complex<double> complexValue;
 	bool listValue;
-	std::string lambdaValue;
+	std::shared_ptr<const Closure> closureValue;
 	std::string errorValue;
+	ParameterValue parameterValue;
   };
 
+  // helper to set the type and value from the text of a token
+  void setFromText(const char * text, std::size_t length);
+
+  // helper to release any string value and return to type None
+  void reset() noexcept;
+
+  // helper to copy the type and value of another Atom into a None Atom
+  void copy(const Atom & x);
+
+  // helper to move the type and value of another Atom into a None Atom
+  void move(Atom && x) noexcept;
+
   // helper to set type and value of Number
   void setNumber(double value);
 
   // helper to set type and value of Symbol
   void setSymbol(const std::string & value);
 
+  // helper to set type and value of Symbol from an interned id
+  void setSymbol(SymbolId value);
+
   // helper to set type and value of Complex
   void setComplex(const std::complex<double> & value);
 
@@ -124,7 +186,7 @@ private:
   void setList(const bool & value);
 
   // helper to set type and value of Lambda
-  void setLambda(const std::string & value);
+  void setLambda(std::shared_ptr<const Closure> value);
 
   // helper to set type and value of string
   void setString(const std::string & value);
@@ -132,6 +194,9 @@ private:
   // helper to set type and value of error
   void setError(const std::string & value);
 
+  // helper to set type and value of Parameter
+  void setParameter(const ParameterValue & value);
+
 };
 
 /// inequality comparison for Atom
@@ -2,6 +2,12 @@
 
 #include "atom.hpp"
 
+#include <cmath>
+#include <sstream>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
 TEST_CASE( "Test constructors", "[atom]" ) {
 
   {
@@ -749,3 +755,149 @@ TEST_CASE( "test comparison", "[atom]" ) {
 
 
 
+
+TEST_CASE( "Test symbol interning", "[atom]" ) {
+
+  {
+    INFO("same name gives same id");
+    Atom a(std::string("interned"));
+    Atom b(std::string("interned"));
+    Atom c(std::string("other"));
+    REQUIRE(a.asSymbolId() == b.asSymbolId());
+    REQUIRE(a.asSymbolId() != c.asSymbolId());
+    REQUIRE(a.asSymbol() == "interned");
+  }
+
+  {
+    INFO("builtin symbols have fixed ids");
+    REQUIRE(Atom(std::string("begin")).asSymbolId() == BeginSymbol);
+    REQUIRE(Atom(std::string("define")).asSymbolId() == DefineSymbol);
+    REQUIRE(Atom(std::string("list")).asSymbolId() == ListSymbol);
+    REQUIRE(Atom::fromSymbolId(MapSymbol).asSymbol() == "map");
+    REQUIRE(Atom::fromSymbolId(MapSymbol) == Atom(std::string("map")));
+  }
+
+  {
+    INFO("non-symbols have no id");
+    REQUIRE(Atom(1.0).asSymbolId() == NoSymbol);
+    REQUIRE(Atom(std::string("\"str\"")).asSymbolId() == NoSymbol);
+    REQUIRE(SymbolTable::instance().name(NoSymbol) == "");
+  }
+
+  {
+    INFO("concurrent interning agrees on ids");
+    std::vector<std::vector<SymbolId>> seen(4);
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < seen.size(); ++t) {
+      threads.emplace_back([t, &seen]() {
+        for (int i = 0; i < 200; ++i) {
+          seen[t].push_back(intern("concurrent" + std::to_string(i)));
+        }
+      });
+    }
+    for (auto & th : threads) {
+      th.join();
+    }
+    for (unsigned t = 1; t < seen.size(); ++t) {
+      REQUIRE(seen[t] == seen[0]);
+    }
+    REQUIRE(SymbolTable::instance().name(seen[0][7]) == "concurrent7");
+  }
+}
+
+TEST_CASE( "Test parameter atoms", "[atom]" ) {
+
+  Atom x = Atom::fromParameter(intern("x"), 1);
+  REQUIRE(x.isParameter());
+  REQUIRE(!x.isSymbol());
+  REQUIRE(x.asSymbolId() == NoSymbol);
+  REQUIRE(x.asParameterSymbol() == intern("x"));
+  REQUIRE(x.asParameterSlot() == 1);
+  REQUIRE(Atom(std::string("x")).asParameterSymbol() == NoSymbol);
+
+  Atom copy(x);
+  REQUIRE(copy == x);
+  REQUIRE(copy != Atom::fromParameter(intern("x"), 0));
+  REQUIRE(copy != Atom::fromParameter(intern("y"), 1));
+  REQUIRE(copy != Atom(std::string("x")));
+
+  std::ostringstream out;
+  out << x;
+  REQUIRE(out.str() == "x");
+}
+
+TEST_CASE( "Test move construction and assignment", "[atom]" ) {
+
+  static_assert(std::is_nothrow_move_constructible<Atom>::value, "Atom move must be noexcept");
+  static_assert(std::is_nothrow_move_assignable<Atom>::value, "Atom move assign must be noexcept");
+
+  {
+    INFO("move string");
+    Atom a(std::string("\"a long string value that will not fit in sso\""));
+    Atom b(std::move(a));
+    REQUIRE(b.isString());
+    REQUIRE(b.asString() == "\"a long string value that will not fit in sso\"");
+  }
+
+  {
+    INFO("move assign over string");
+    Atom a(std::string("\"first\""));
+    Atom b(std::string("error..."));
+    a = std::move(b);
+    REQUIRE(a.isError());
+    REQUIRE(a.asError() == "...");
+    a = Atom(2.0);
+    REQUIRE(a.isNumber());
+    REQUIRE(a.asNumber() == 2.0);
+  }
+
+  {
+    INFO("move symbol and number");
+    Atom a(std::string("sym"));
+    Atom b(std::move(a));
+    REQUIRE(b.isSymbol());
+    REQUIRE(b.asSymbol() == "sym");
+    Atom c;
+    c = Atom(1.5);
+    REQUIRE(c.asNumber() == 1.5);
+  }
+}
+
+TEST_CASE( "Test atoms from source text", "[atom]" ) {
+
+  // numbers must read exactly as from a stream
+  std::vector<std::string> numbers = {"0", "-0", "+7", "1.", ".5", "-.25", "3.14159", "0.1", "0.3",
+				      "1e3", "1E-3", "2.5e+10", "123456789012345", "1234567890123456789",
+				      "9007199254740993", "1e22", "1e23", "4.9e-324", "1.7976931348623157e308",
+				      "0.000001", "0e999", "6.02214076e23"};
+  for(auto & text : numbers){
+    std::istringstream iss(text);
+    double expected;
+    iss >> expected;
+    Atom a(text.data(), text.size());
+    INFO(text);
+    REQUIRE(a.isNumber());
+    REQUIRE(a.asNumber() == expected);
+    REQUIRE(std::signbit(a.asNumber()) == std::signbit(expected));
+  }
+
+  // malformed numbers are invalid
+  for(std::string text : {"1.2abc", "1e", "1e+", "2..3", "3-4", "1e400"}){
+    INFO(text);
+    REQUIRE(Atom(text.data(), text.size()).isNone());
+  }
+
+  // everything else is a symbol or a string
+  for(std::string text : {"+", "-", "-abc", ".", "e5", "pi", "a\"b\""}){
+    Atom a(text.data(), text.size());
+    INFO(text);
+    REQUIRE(a.isSymbol());
+    REQUIRE(a.asSymbol() == text);
+  }
+  std::string text = "\"a string\"";
+  REQUIRE(Atom(text.data(), text.size()).isString());
+
+  // the same rules as a token
+  REQUIRE(Atom(Token("2.5")) == Atom(2.5));
+  REQUIRE(Atom(Token("\"s\"")) == Atom(std::string("\"s\"")));
+}
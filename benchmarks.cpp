@@ -0,0 +1,448 @@
+/*
+Micro-benchmarks for the interpreter.
+
+Run without arguments to run every benchmark, or with the names of the
+benchmarks to run. Build with CMAKE_BUILD_TYPE=Release for meaningful
+numbers; the benchmarks are not part of the unit tests.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "ast_cache.hpp"
+#include "interpreter.hpp"
+#include "parse.hpp"
+#include "semantic_error.hpp"
+#include "token.hpp"
+#include "startup_config.hpp"
+#include "vector_kernels.hpp"
+
+/***********************************************************************
+Helper Functions
+**********************************************************************/
+
+// parse and evaluate program in interp, exiting on failure
+static Expression run(Interpreter & interp, const std::string & program) {
+  std::istringstream iss(program);
+  if (!interp.parseStream(iss)) {
+    std::cerr << "Failed to parse: " << program << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  try {
+    return interp.evaluate();
+  }
+  catch (const SemanticError & ex) {
+    std::cerr << ex.what() << " in: " << program << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+}
+
+// average seconds per evaluation of program, parsed once
+static double timeEvaluate(Interpreter & interp, const std::string & program, int repeat) {
+  std::istringstream iss(program);
+  if (!interp.parseStream(iss)) {
+    std::cerr << "Failed to parse: " << program << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < repeat; ++i) {
+    interp.evaluate();
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / repeat;
+}
+
+// average seconds per call of fn
+template <typename Function>
+static double timeCall(Function fn, int repeat) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < repeat; ++i) {
+    fn();
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / repeat;
+}
+
+// a data script of about megabytes MB: a list of numbers and strings with comments
+static std::string dataScript(std::size_t megabytes) {
+  std::string script = "(begin\n";
+  std::size_t line = 0;
+  while (script.size() < megabytes * 1000000) {
+    script += "  (define point" + std::to_string(line % 100) + " (list " + std::to_string(line * 0.25) +
+              " -" + std::to_string(line % 977) + " 3.5e-2 \"label " + std::to_string(line) +
+              "\")) ; point " + std::to_string(line) + "\n";
+    ++line;
+  }
+  script += ")\n";
+  return script;
+}
+
+// print one result line, with a throughput when elements is not zero
+static void report(const std::string & label, double seconds, double elements) {
+  std::cout << "  " << std::left << std::setw(44) << label << std::right
+            << std::setw(12) << std::fixed << std::setprecision(3) << seconds * 1e3 << " ms";
+  if (elements > 0) {
+    std::cout << std::setw(14) << std::setprecision(1) << elements / seconds / 1e6 << " M elements/s";
+  }
+  std::cout << std::endl;
+}
+
+/***********************************************************************
+Benchmarks
+**********************************************************************/
+
+// element-wise arithmetic on lists: vector kernels against map
+static void benchmarkArithmetic() {
+  const int n = 1000000;
+  const int mapN = 100000;
+  Interpreter interp;
+  run(interp, "(begin (define a (range 1 " + std::to_string(n) + " 1)) (define b (range 2 " +
+              std::to_string(n + 1) + " 1)) (define small (range 1 " + std::to_string(mapN) + " 1)))");
+
+  VectorIsa original = vectorIsa();
+  for (int isa = ScalarIsa; isa <= vectorIsaSupported(); ++isa) {
+    setVectorIsa(static_cast<VectorIsa>(isa));
+    std::string name = vectorIsaName(static_cast<VectorIsa>(isa));
+    report("(+ a b) " + name, timeEvaluate(interp, "(+ a b)", 20), n);
+    report("(+ a 2.5) " + name, timeEvaluate(interp, "(+ a 2.5)", 20), n);
+    report("(* a b) " + name, timeEvaluate(interp, "(* a b)", 20), n);
+    report("(/ a b) " + name, timeEvaluate(interp, "(/ a b)", 20), n);
+  }
+  setVectorIsa(original);
+
+  report("(map (lambda (x) (+ x 2.5)) small)", timeEvaluate(interp, "(map (lambda (x) (+ x 2.5)) small)", 1), mapN);
+}
+
+// sin, ln and sqrt over lists: vector kernels against map
+static void benchmarkTranscendental() {
+  const int n = 1000000;
+  const int mapN = 100000;
+  Interpreter interp;
+  run(interp, "(begin (define a (range 1 " + std::to_string(n) + " 1)) (define small (range 1 " +
+              std::to_string(mapN) + " 1)))");
+
+  VectorIsa original = vectorIsa();
+  for (int isa = ScalarIsa; isa <= vectorIsaSupported(); ++isa) {
+    setVectorIsa(static_cast<VectorIsa>(isa));
+    std::string name = vectorIsaName(static_cast<VectorIsa>(isa));
+    report("(sin a) " + name, timeEvaluate(interp, "(sin a)", 10), n);
+    report("(tan a) " + name, timeEvaluate(interp, "(tan a)", 10), n);
+    report("(ln a) " + name, timeEvaluate(interp, "(ln a)", 10), n);
+    report("(sqrt a) " + name, timeEvaluate(interp, "(sqrt a)", 10), n);
+  }
+  setVectorIsa(original);
+
+  report("(map sin small)", timeEvaluate(interp, "(map sin small)", 1), mapN);
+  report("(map (lambda (x) (sin x)) small)", timeEvaluate(interp, "(map (lambda (x) (sin x)) small)", 1), mapN);
+}
+
+// splitting and parsing a 10MB script, throughput in characters
+static void benchmarkTokenize() {
+  const std::string script = dataScript(10);
+  const double characters = script.size();
+  std::size_t count = 0;
+
+  report("tokenize(istream)", timeCall([&] {
+    std::istringstream iss(script);
+    count += tokenize(iss).size();
+  }, 5), characters);
+  report("tokenize(buffer)", timeCall([&] {
+    count += tokenize(script.data(), script.size()).size();
+  }, 5), characters);
+  report("TokenScanner", timeCall([&] {
+    TokenScanner scanner(script.data(), script.size());
+    TokenSpan span;
+    while (scanner.next(span)) {
+      ++count;
+    }
+  }, 5), characters);
+  report("parseStream", timeCall([&] {
+    Interpreter interp;
+    std::istringstream iss(script);
+    count += interp.parseStream(iss);
+  }, 1), characters);
+
+  if (count == 0) {
+    std::cerr << "No tokens" << std::endl;
+  }
+}
+
+// parsing a 10MB literal-heavy script: token sequence against the fused parser
+static void benchmarkParse() {
+  const std::string script = dataScript(10);
+  const double characters = script.size();
+  bool ok = true;
+
+  report("tokenize and parse(tokens)", timeCall([&] {
+    std::istringstream iss(script);
+    ok = ok && (parse(tokenize(iss)) != Expression());
+  }, 3), characters);
+  report("parse(buffer)", timeCall([&] {
+    ok = ok && (parse(script.data(), script.size()) != Expression());
+  }, 3), characters);
+
+  if (!ok) {
+    std::cerr << "Failed to parse the script" << std::endl;
+  }
+}
+
+// startup, which parses startup.pls directly, and script loading without
+// and with the AST cache
+static void benchmarkStartup() {
+  const std::string startup = STARTUP_FILE;
+
+  report("startup parseStream", timeCall([&] {
+    Interpreter interp;
+    std::ifstream ifs(startup);
+    interp.parseStream(ifs);
+    interp.evaluate();
+  }, 200), 0);
+
+  // a 10MB script of many forms, throughput in characters
+  const std::string script = "benchmark_script.pls";
+  const std::string scriptCache = astCachePath(script);
+  std::string text = dataScript(10);
+  {
+    std::ofstream out(script, std::ios::binary);
+    out << text;
+  }
+  std::size_t forms = 0;
+  report("10MB script without cache", timeCall([&] {
+    std::ifstream in(script, std::ios::binary);
+    FormReader reader(in);
+    std::string form;
+    while (reader.next(form)) {
+      forms += (parse(form.data(), form.size()) != Expression());
+    }
+  }, 3), text.size());
+  report("10MB script cold", timeCall([&] {
+    std::remove(scriptCache.c_str());
+    ScriptReader reader(script);
+    Expression form;
+    while (reader.next(form)) {
+      ++forms;
+    }
+  }, 3), text.size());
+  report("10MB script warm", timeCall([&] {
+    ScriptReader reader(script);
+    Expression form;
+    while (reader.next(form)) {
+      ++forms;
+    }
+  }, 3), text.size());
+  std::remove(script.c_str());
+  std::remove(scriptCache.c_str());
+
+  if (forms == 0) {
+    std::cerr << "No forms read" << std::endl;
+  }
+}
+
+// the tree walker against the bytecode engine on call-, map- and arithmetic-heavy scripts
+static void benchmarkEngines() {
+  // f0 doubles its argument and each fi calls fi-1 twice: 2^14 lambda calls
+  std::string recursion = "(begin (define f0 (lambda (x) (* 2 x)))";
+  for (int i = 1; i <= 14; ++i) {
+    recursion += " (define f" + std::to_string(i) + " (lambda (x) (+ (f" + std::to_string(i - 1) +
+                 " x) (f" + std::to_string(i - 1) + " 1))))";
+  }
+  recursion += " (f14 1))";
+
+  const std::string map = "(begin (define small (range 1 20000 1)) "
+                          "(map (lambda (x) (+ (* x x) (/ x 2) 1)) small))";
+
+  std::string arithmetic = "(begin (define x 1)";
+  for (int i = 0; i < 5000; ++i) {
+    arithmetic += " (define x (+ (* x 0.5) (- 3 2) (/ 4 2) (^ 2 2)))";
+  }
+  arithmetic += " x)";
+
+  struct Script {
+    const char * name;
+    const std::string & program;
+    int repeat;
+  };
+  const Script scripts[] = {{"recursion", recursion, 10}, {"map", map, 10}, {"arithmetic", arithmetic, 20}};
+
+  for (auto & script : scripts) {
+    for (auto engine : {Interpreter::TreeWalkEngine, Interpreter::BytecodeEngine}) {
+      Interpreter interp;
+      interp.setEngine(engine);
+      run(interp, script.program);
+      std::string name = (engine == Interpreter::TreeWalkEngine) ? "tree walker" : "bytecode";
+      report(std::string(script.name) + " " + name, timeEvaluate(interp, script.program, script.repeat), 0);
+    }
+  }
+}
+
+// tight numeric lambdas through map and continuous-plot, with parameters
+// resolved to slots against the same lambda looking them up by name
+static void benchmarkLambdas() {
+  const int n = 20000;
+  Interpreter interp;
+  run(interp, "(begin (define small (range 1 " + std::to_string(n) + " 1)) "
+              "(define resolved (lambda (x) (+ (* x x) (/ x 2) 1))))");
+
+  // the lambda value built without the resolver
+  Expression body = parse(std::string("(+ (* x x) (/ x 2) 1)").data(), 21);
+  Expression parameters(std::list<Expression>{Expression(Atom(std::string("x")))});
+  Environment env = interp.getEnv();
+  env.add_exp(Atom(std::string("byname")), Expression(std::vector<Expression>{parameters, body}));
+  interp.setEnv(env);
+
+  for (const char * f : {"byname", "resolved"}) {
+    std::string name(f);
+    report("map " + name, timeEvaluate(interp, "(map " + name + " small)", 20), n);
+    report("continuous-plot " + name,
+           timeEvaluate(interp, "(continuous-plot " + name + " (list -10 10))", 200), 0);
+  }
+}
+
+// map over a million elements with a builtin, a lambda value and an inline lambda
+static void benchmarkMap() {
+  const int n = 1000000;
+  Interpreter interp;
+  run(interp, "(begin (define big (range 1 " + std::to_string(n) + " 1)) "
+              "(define f (lambda (x) (+ x 1))))");
+
+  report("(map sin big)", timeEvaluate(interp, "(map sin big)", 5), n);
+  report("(map f big)", timeEvaluate(interp, "(map f big)", 5), n);
+  report("(map (lambda (x) (+ x 1)) big)", timeEvaluate(interp, "(map (lambda (x) (+ x 1)) big)", 5), n);
+}
+
+// a registered special-form giving its operand unevaluated
+static Expression quote(const Expression & form, Environment &) {
+  return form.getValueInTail(0);
+}
+
+// the cost of dispatching a form: calls of a cheap builtin, a built-in
+// special-form and a registered one, in a begin of n forms
+static void benchmarkDispatch() {
+  const int n = 100000;
+  Interpreter interp;
+  Expression::registerSpecialForm("quote", quote);
+
+  struct Form {
+    const char * label;
+    const char * form;
+  };
+  const Form forms[] = {{"procedure (- 1)", " (- 1)"}, {"special-form (begin 1)", " (begin 1)"},
+                        {"registered (quote 1)", " (quote 1)"}};
+
+  for (auto & f : forms) {
+    std::string program = "(begin";
+    for (int i = 0; i < n; ++i) {
+      program += f.form;
+    }
+    program += ")";
+    report(f.label, timeEvaluate(interp, program, 20), n);
+  }
+}
+
+// map over a lambda whose body has constant subexpressions, with constant
+// folding on and off
+static void benchmarkFolding() {
+  const int n = 100000;
+  for (bool folding : {true, false}) {
+    Interpreter interp;
+    interp.setConstantFolding(folding);
+    run(interp, "(begin (define big (range 1 " + std::to_string(n) + " 1)) "
+                "(define f (lambda (x) (* x (* 2 pi) (/ 1 3)))) "
+                "(define g (lambda (x) (+ x (length (range 0 99 1))))))");
+
+    std::string suffix = folding ? " folded" : " unfolded";
+    report("(map f big)" + suffix, timeEvaluate(interp, "(map f big)", 5), n);
+    report("(map g big)" + suffix, timeEvaluate(interp, "(map g big)", 5), n);
+  }
+}
+
+// map over a pure lambda calling a lambda: with the memo cache, whose
+// entries are hit from the second repeat on, and without it
+static void benchmarkMemoization() {
+  const int n = 2000;
+  for (std::size_t capacity : {MemoCache::DefaultCapacity, std::size_t(0)}) {
+    Interpreter interp;
+    interp.setMemoCapacity(capacity);
+    run(interp, "(begin (define small (range 1 " + std::to_string(n) + " 1)) "
+                "(define sq (lambda (x) (* x x))) "
+                "(define f (lambda (x) (+ (sq x) (sq (+ x 1))))))");
+
+    std::string label = capacity ? "(map f small) memoized" : "(map f small) uncached";
+    report(label, timeEvaluate(interp, "(map f small)", 20), n);
+  }
+}
+
+static void benchmarkParallel() {
+  const int n = 20000;
+  // 1, 2, 4, ... threads, up to the number of hardware threads
+  std::size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::size_t> sizes;
+  for (std::size_t threads = 1; threads < hardware; threads *= 2) {
+    sizes.push_back(threads);
+  }
+  sizes.push_back(hardware);
+
+  for (std::size_t threads : sizes) {
+    Interpreter interp;
+    interp.setThreads(threads);
+    run(interp, "(begin (define big (range 1 " + std::to_string(n) + " 1)) "
+                "(define f (lambda (x) (+ (sin x) (cos x) (sqrt x) (* x x)))))");
+
+    std::string suffix = " on " + std::to_string(threads) + " threads";
+    report("(pmap f big)" + suffix, timeEvaluate(interp, "(pmap f big)", 20), n);
+    report("(preduce + 0 (pmap f big))" + suffix, timeEvaluate(interp, "(preduce + 0 (pmap f big))", 20), n);
+  }
+}
+
+// a discrete plot of a million points, its items built from packed pairs,
+// and then made Expressions by inspecting one
+static void benchmarkPlotting() {
+  const int n = 1000000;
+  Interpreter interp;
+  run(interp, "(define data (map (lambda (x) (list x (sin x))) (range 1 " + std::to_string(n) + " 1)))");
+
+  report("(discrete-plot data (list))", timeEvaluate(interp, "(discrete-plot data (list))", 3), n);
+  report("(first (discrete-plot data (list)))", timeEvaluate(interp, "(first (discrete-plot data (list)))", 3), n);
+}
+
+struct Benchmark {
+  const char * name;
+  void (*run)();
+};
+
+static const Benchmark benchmarks[] = {
+  {"arithmetic", benchmarkArithmetic},
+  {"transcendental", benchmarkTranscendental},
+  {"tokenize", benchmarkTokenize},
+  {"parse", benchmarkParse},
+  {"startup", benchmarkStartup},
+  {"engines", benchmarkEngines},
+  {"lambdas", benchmarkLambdas},
+  {"map", benchmarkMap},
+  {"dispatch", benchmarkDispatch},
+  {"folding", benchmarkFolding},
+  {"memoization", benchmarkMemoization},
+  {"parallel", benchmarkParallel},
+  {"plotting", benchmarkPlotting},
+};
+
+int main(int argc, char * argv[]) {
+  for (auto & b : benchmarks) {
+    bool selected = (argc == 1);
+    for (int i = 1; i < argc; ++i) {
+      selected = selected || (std::strcmp(argv[i], b.name) == 0);
+    }
+    if (selected) {
+      std::cout << b.name << std::endl;
+      b.run();
+    }
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,282 @@
+#include "bytecode.hpp"
+
+#include "closure.hpp"
+#include "memoization.hpp"
+#include "semantic_error.hpp"
+
+// return the procedures every environment starts with
+static const Environment & builtins(){
+  static const Environment env;
+  return env;
+}
+
+// Emits the instructions of one expression into a chunk.
+class Compiler {
+public:
+
+  explicit Compiler(Chunk & chunk): m_chunk(chunk) {}
+
+  void compile(const Expression & node);
+
+private:
+
+  void emit(OpCode op, std::uint32_t a = 0, std::uint32_t b = 0){
+    m_chunk.code.push_back(Instruction{op, a, b});
+  }
+
+  std::uint32_t constant(const Expression & value){
+    m_chunk.constants.push_back(value);
+    return static_cast<std::uint32_t>(m_chunk.constants.size() - 1);
+  }
+
+  // return the index of symbol, adding it and its builtin the first time
+  std::uint32_t symbol(const Atom & symbol){
+    auto found = m_symbols.find(symbol.asSymbolId());
+    if(symbol.isSymbol() && found != m_symbols.end()){
+      return found->second;
+    }
+    std::uint32_t index = static_cast<std::uint32_t>(m_chunk.symbols.size());
+    m_chunk.symbols.push_back(symbol);
+    m_chunk.procedures.push_back(builtins().is_proc(symbol) ? builtins().get_proc(symbol) : nullptr);
+    if(symbol.isSymbol()){
+      m_symbols.emplace(symbol.asSymbolId(), index);
+    }
+    return index;
+  }
+
+  // the node is left to Expression::eval
+  void evaluate(const Expression & node){
+    emit(Evaluate, constant(node));
+  }
+
+  void compileDefine(const Expression & node);
+  void compileLambda(const Expression & node);
+
+  Chunk & m_chunk;
+  std::unordered_map<SymbolId, std::uint32_t> m_symbols;
+};
+
+void Compiler::compile(const Expression & node){
+  const Atom & head = node.head();
+  std::uint32_t length = node.getTailLength();
+
+  // List values, as folding leaves in lambda bodies
+  if(head.isList()){
+    emit(PushConstant, constant(node));
+    return;
+  }
+
+  // terminal expressions, as in Expression::handle_lookup
+  if(length == 0 && head.asSymbolId() != ListSymbol){
+    if(head.isSymbol()){
+      emit(LookupSymbol, symbol(head));
+    }
+    else if(head.isParameter()){
+      emit(LoadParameter, symbol(head));
+    }
+    else if(head.isNumber() || head.isComplex() || head.isString()){
+      emit(PushConstant, constant(Expression(head)));
+    }
+    else{
+      evaluate(node);
+    }
+    return;
+  }
+
+  switch(head.asSymbolId()){
+  case BeginSymbol:{
+    bool first = true;
+    for(auto it = node.tailConstBegin(); it != node.tailConstEnd(); ++it){
+      if(!first){
+	emit(Pop);
+      }
+      compile(*it);
+      first = false;
+    }
+    return;
+  }
+  case DefineSymbol:
+    compileDefine(node);
+    return;
+  case LambdaSymbol:
+    compileLambda(node);
+    return;
+  default:
+    if(Expression::isSpecialForm(head.asSymbolId())){
+      evaluate(node);
+      return;
+    }
+    break;
+  }
+
+  // a procedure or lambda call, arguments are evaluated first
+  for(auto it = node.tailConstBegin(); it != node.tailConstEnd(); ++it){
+    compile(*it);
+  }
+  emit(CallProcedure, symbol(head), length);
+}
+
+void Compiler::compileDefine(const Expression & node){
+  // malformed definitions raise their errors from Expression::eval
+  if(node.getTailLength() != 2 || !node.getValueInTail(0).isHeadSymbol()){
+    evaluate(node);
+    return;
+  }
+  SymbolId s = node.getValueInTail(0).head().asSymbolId();
+  if((s == DefineSymbol) || (s == BeginSymbol) || (s == LambdaSymbol) || (s == MapSymbol) || (s == ApplySymbol)){
+    evaluate(node);
+    return;
+  }
+
+  compile(node.getValueInTail(1));
+  emit(Define, symbol(node.getValueInTail(0).head()));
+}
+
+void Compiler::compileLambda(const Expression & node){
+  if(node.getTailLength() != 2 || !node.getValueInTail(0).isHeadSymbol()){
+    evaluate(node);
+    return;
+  }
+  Expression parameters = node.getValueInTail(0);
+  SymbolId s = parameters.head().asSymbolId();
+  if((s == DefineSymbol) || (s == BeginSymbol)){
+    evaluate(node);
+    return;
+  }
+
+  emit(MakeLambda, constant(Expression::makeLambda(parameters, node.getValueInTail(1))));
+}
+
+Chunk compile(const Expression & program){
+  Chunk chunk;
+  Compiler compiler(chunk);
+  compiler.compile(program);
+  return chunk;
+}
+
+// raise the errors the tree walker raises for a special form whose name is bound
+static void checkSpecialForm(SymbolId form, const Environment & env){
+  Atom symbol = Atom::fromSymbolId(form);
+  if(env.is_proc(symbol)){
+    throw SemanticError("Error during evaluation: attempt to redefine a built-in procedure");
+  }
+  if(env.is_exp(symbol)){
+    throw SemanticError("Error during evaluation: attempt to redefine a previously defined symbol");
+  }
+}
+
+Expression VirtualMachine::run(const Chunk & chunk, Environment & env){
+  std::vector<Expression> stack;
+  std::vector<Expression> args;
+
+  for(const Instruction & instruction : chunk.code){
+    if(env.checkEnvInterrupt()){
+      throw SemanticError("Error: interpreter kernel interrupted");
+    }
+
+    switch(instruction.op){
+    case PushConstant:
+      stack.push_back(chunk.constants[instruction.a]);
+      break;
+    case LookupSymbol:{
+      const Atom & symbol = chunk.symbols[instruction.a];
+      if(!env.is_exp(symbol)){
+	throw SemanticError("Error during evaluation: unknown symbol");
+      }
+      stack.push_back(env.get_exp(symbol));
+      break;
+    }
+    case LoadParameter:{
+      const Expression * value = env.find_parameter(chunk.symbols[instruction.a]);
+      if(value != nullptr){
+	stack.push_back(*value);
+	break;
+      }
+      Atom symbol = Atom::fromSymbolId(chunk.symbols[instruction.a].asParameterSymbol());
+      if(!env.is_exp(symbol)){
+	throw SemanticError("Error during evaluation: unknown symbol");
+      }
+      stack.push_back(env.get_exp(symbol));
+      break;
+    }
+    case CallProcedure:{
+      const Atom & head = chunk.symbols[instruction.a];
+      Expression value;
+      if(chunk.procedures[instruction.a] &&
+	 env.apply_numeric(head, stack.data() + stack.size() - instruction.b, instruction.b, value)){
+	stack.resize(stack.size() - instruction.b);
+	stack.push_back(std::move(value));
+	break;
+      }
+
+      args.clear();
+      args.reserve(instruction.b);
+      for(auto it = stack.end() - instruction.b; it != stack.end(); ++it){
+	args.push_back(std::move(*it));
+      }
+      stack.resize(stack.size() - instruction.b);
+
+      // a bound symbol is a lambda call, as in Expression::eval
+      bool bound = env.is_exp(head);
+      if(bound && instruction.b > 0){
+	std::vector<Expression> lambdaArgs(std::move(args));
+	stack.push_back(callLambda(head, lambdaArgs, env));
+      }
+      else if(!bound && chunk.procedures[instruction.a]){
+	stack.push_back(chunk.procedures[instruction.a](args));
+      }
+      else if(!head.isSymbol()){
+	throw SemanticError("Error during evaluation: procedure name not symbol");
+      }
+      else if(!env.is_proc(head)){
+	throw SemanticError("Error during evaluation: symbol does not name a procedure");
+      }
+      else{
+	stack.push_back(env.get_proc(head)(args));
+      }
+      break;
+    }
+    case Define:
+      checkSpecialForm(DefineSymbol, env);
+      env.add_exp(chunk.symbols[instruction.a], stack.back());
+      break;
+    case MakeLambda:
+      checkSpecialForm(LambdaSymbol, env);
+      stack.push_back(chunk.constants[instruction.a].closedOver(env));
+      break;
+    case Pop:
+      stack.pop_back();
+      break;
+    case Evaluate:
+      stack.push_back(chunk.constants[instruction.a].eval(env));
+      break;
+    }
+  }
+
+  return std::move(stack.back());
+}
+
+Expression VirtualMachine::callLambda(const Atom & head, std::vector<Expression> & args, Environment & env){
+  Expression lambda = env.get_exp(head);
+  MemoizedCall memo(lambda, args, env);
+  Expression result;
+  if(memo.find(result)){
+    return result;
+  }
+  result = runLambda(lambda, args, env);
+  memo.store(result);
+  return result;
+}
+
+Expression VirtualMachine::runLambda(const Expression & lambda, std::vector<Expression> & args, Environment & env){
+  Expression body;
+  Environment lambdaEnv = Expression::bindLambda(lambda, args, env, body);
+
+  // terminal bodies are cheaper to evaluate than to compile
+  if(body.getTailLength() == 0){
+    return body.eval(lambdaEnv);
+  }
+
+  // the closure stays alive, lambda holds it for the call
+  return run(lambda.head().asClosure()->compiledBody(env), lambdaEnv);
+}
@@ -0,0 +1,94 @@
+/*! \file bytecode.hpp
+Defines the bytecode compiler and the virtual machine that executes it.
+
+The compiler turns a parsed Expression into a flat sequence of
+instructions. Constants, lambda values and builtin procedures are resolved
+once at compile time, so executing a program does not re-inspect the tree.
+The virtual machine gives the same results and raises the same
+SemanticErrors as Expression::eval.
+ */
+#ifndef BYTECODE_HPP
+#define BYTECODE_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "environment.hpp"
+#include "expression.hpp"
+
+/*! \enum OpCode
+\brief The instructions of the virtual machine.
+*/
+enum OpCode : std::uint8_t {
+  PushConstant,  //< push constants[a]
+  LookupSymbol,  //< push the value of symbols[a]
+  LoadParameter, //< push the value of the Parameter symbols[a], by slot when possible
+  CallProcedure, //< call symbols[a] with the top b values, procedures[a] if it is a builtin
+  Define,        //< bind symbols[a] to the top value, leaving it on the stack
+  MakeLambda,    //< push the lambda constants[a]
+  Pop,           //< discard the top value
+  Evaluate       //< push constants[a] evaluated by Expression::eval
+};
+
+/*! \class Instruction
+\brief One instruction, an opcode and up to two operands.
+*/
+struct Instruction {
+  OpCode op;
+  std::uint32_t a;
+  std::uint32_t b;
+};
+
+/*! \class Chunk
+\brief A compiled program: its instructions and the tables they index.
+
+Plotscript has no conditional special form, so a chunk runs straight
+through from its first instruction to its last and needs no jumps. Forms
+the compiler does not translate (apply, map, the property and plot forms,
+and malformed forms) are kept as constants and evaluated by the tree
+walker, which also raises their errors.
+*/
+struct Chunk {
+  std::vector<Instruction> code;
+  std::vector<Expression> constants;
+  std::vector<Atom> symbols;
+
+  // the builtin each symbol named when compiled, or nullptr
+  std::vector<Procedure> procedures;
+};
+
+/*! Compile an expression.
+  \param program the abstract syntax tree
+  \return the compiled program
+*/
+Chunk compile(const Expression & program);
+
+/*! \class VirtualMachine
+\brief Executes compiled chunks.
+
+Lambda bodies are compiled the first time they are called and kept on
+their Closure, so they are released with the lambda.
+A VirtualMachine is used by one thread at a time.
+*/
+class VirtualMachine {
+public:
+
+  /*! Execute a chunk in an environment.
+    \param chunk the compiled program
+    \param env the environment, updated by any definitions
+    \return the value of the program
+    \throws SemanticError when a semantic error is encountered
+  */
+  Expression run(const Chunk & chunk, Environment & env);
+
+private:
+
+  // call the lambda bound to head with the evaluated arguments, through
+  // the memo cache when it is memoized
+  Expression callLambda(const Atom & head, std::vector<Expression> & args, Environment & env);
+
+  // run the compiled body of a call of lambda
+  Expression runLambda(const Expression & lambda, std::vector<Expression> & args, Environment & env);
+};
+
+#endif
@@ -0,0 +1,44 @@
+#include "catch.hpp"
+
+#include <string>
+#include <sstream>
+#include <vector>
+
+#include "interpreter.hpp"
+#include "bytecode.hpp"
+
+TEST_CASE( "Test the bytecode engine keeps definitions", "[bytecode]" ) {
+
+  Interpreter interp;
+  interp.setEngine(Interpreter::BytecodeEngine);
+  REQUIRE(interp.engine() == Interpreter::BytecodeEngine);
+
+  std::istringstream define("(define f (lambda (x) (* x 3)))");
+  REQUIRE(interp.parseStream(define));
+  REQUIRE_NOTHROW(interp.evaluate());
+
+  // each evaluation runs the newly parsed program
+  for(int i = 1; i < 4; ++i){
+    std::istringstream call("(f " + std::to_string(i) + ")");
+    REQUIRE(interp.parseStream(call));
+    REQUIRE(interp.evaluate() == Expression(3.0 * i));
+  }
+
+  // a redefined lambda is called, not the body compiled for the old one
+  std::istringstream redefine("(begin (define f (lambda (x) (- x 3))) (f 1))");
+  REQUIRE(interp.parseStream(redefine));
+  REQUIRE(interp.evaluate() == Expression(-2.0));
+}
+
+TEST_CASE( "Test compiling expressions", "[bytecode]" ) {
+
+  Expression program(Atom(std::string("+")), std::vector<Expression>{Expression(Atom(1.0)), Expression(Atom(std::string("a")))});
+  Chunk chunk = compile(program);
+  REQUIRE(chunk.code.size() == 3);
+  REQUIRE(chunk.code[0].op == PushConstant);
+  REQUIRE(chunk.code[1].op == LookupSymbol);
+  REQUIRE(chunk.code[2].op == CallProcedure);
+  REQUIRE(chunk.code[2].b == 2);
+  REQUIRE(chunk.procedures[chunk.code[2].a] != nullptr);
+  REQUIRE(chunk.procedures[chunk.code[1].a] == nullptr);
+}
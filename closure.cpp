@@ -0,0 +1,98 @@
+#include "closure.hpp"
+
+#include <algorithm>
+
+#include "bytecode.hpp"
+#include "constant_folding.hpp"
+#include "memoization.hpp"
+#include "semantic_error.hpp"
+
+// the next closure id
+static std::atomic<std::uint64_t> nextId(1);
+
+Closure::Closure(const Expression & parameters, const Expression & body,
+                 std::shared_ptr<const Environment> captured, bool memoize):
+  m_body(body), m_captured(std::move(captured)), m_id(nextId++),
+  m_memoize(memoize), m_analysis(0){
+
+  m_parameters.reserve(parameters.getTailLength());
+  for(auto it = parameters.tailConstBegin(); it != parameters.tailConstEnd(); ++it){
+    m_parameters.push_back(it->head());
+  }
+}
+
+Closure::~Closure(){}
+
+std::size_t Closure::arity() const noexcept{
+  return m_parameters.size();
+}
+
+const std::vector<Atom> & Closure::parameters() const noexcept{
+  return m_parameters;
+}
+
+std::uint64_t Closure::id() const noexcept{
+  return m_id;
+}
+
+bool Closure::memoized(const Environment & env) const{
+  if(m_memoize){
+    return true;
+  }
+
+  // definitions change the epoch and may change the analysis
+  std::uint64_t epoch = this->epoch(env);
+  std::uint64_t analysis = m_analysis.load(std::memory_order_relaxed);
+  if((analysis >> 1) != epoch){
+    Effects effects = analyzeEffects(*this, env);
+    analysis = (epoch << 1) | ((effects.pure && effects.callsLambda) ? 1 : 0);
+    m_analysis.store(analysis, std::memory_order_relaxed);
+  }
+  return (analysis & 1) != 0;
+}
+
+std::uint64_t Closure::epoch(const Environment & env) const{
+  std::uint64_t epoch = env.epoch();
+  return m_captured ? std::max(epoch, m_captured->epoch()) : epoch;
+}
+
+const Expression & Closure::body() const noexcept{
+  return m_body;
+}
+
+const Expression & Closure::body(const Environment & env) const{
+  if(!env.foldedBodies() || (m_captured && !m_captured->foldedBodies())){
+    return m_body;
+  }
+  std::call_once(m_foldOnce, [this](){
+    m_folded = foldConstants(m_body, m_parameters, m_captured.get());
+  });
+  return m_folded;
+}
+
+const Chunk & Closure::compiledBody(const Environment & env) const{
+  const Expression & source = body(env);
+  std::size_t slot = (&source == &m_folded) ? 1 : 0;
+  std::call_once(m_compileOnce[slot], [this, slot, &source](){
+    m_compiled[slot].reset(new Chunk(compile(source)));
+  });
+  return *m_compiled[slot];
+}
+
+const std::shared_ptr<const Environment> & Closure::captured() const noexcept{
+  return m_captured;
+}
+
+Environment Closure::bind(std::vector<Expression> & args, const Environment & env) const{
+
+  // the message Expression::eval has always given
+  if(args.size() != m_parameters.size()){
+    throw SemanticError("Error during evaluation: attempt to redefine a previously defined symbol");
+  }
+
+  Environment frame = env.closureFrame(m_captured);
+  for(std::size_t i = 0; i < m_parameters.size(); ++i){
+    frame.add_parameter(m_parameters[i], std::move(args[i]));
+  }
+  return frame;
+}
@@ -0,0 +1,135 @@
+/*! \file closure.hpp
+Defines the Closure type, the procedure a lambda evaluates to.
+
+A lambda value is an Expression whose head is a Lambda Atom holding its
+Closure and whose tail is the parameter list and the body, for display and
+comparison. The Closure keeps what a call needs: the parameter symbols, the
+body, shared with the tail, and the bindings of the call frames the lambda
+was made in, shared with those frames. A call binds the arguments in a frame chained to the global
+environment through those bindings, so the body resolves free symbols where
+the lambda was defined rather than where it is called.
+
+The first call through body(env) folds the constant subexpressions of the
+body, see constant_folding.hpp, and later calls reuse the folded body. The
+bytecode engine likewise compiles the body on its first call, see
+bytecode.hpp, and keeps the chunk here.
+Calls of a memoized closure go through the memo cache, see memoization.hpp.
+ */
+#ifndef CLOSURE_HPP
+#define CLOSURE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "atom.hpp"
+#include "environment.hpp"
+#include "expression.hpp"
+
+// forward declare Chunk, defined with the bytecode compiler
+struct Chunk;
+
+/*! \class Closure
+\brief The immutable procedure value of a lambda.
+
+Closures are shared between copies of a lambda value and never change,
+apart from the folded and compiled bodies, which are made once on first
+use, and the result of the effect analysis, kept for the last global epoch
+it was made in.
+*/
+class Closure {
+public:
+
+  /*! Construct a closure.
+    \param parameters the parameter list of the lambda
+    \param body the body of the lambda
+    \param captured the bindings of the call frames the lambda was made in,
+    or nullptr if it was made in the global environment
+    \param memoize true to memoize every call, as the memoize special-form does
+  */
+  Closure(const Expression & parameters, const Expression & body,
+          std::shared_ptr<const Environment> captured, bool memoize = false);
+
+  /// destroy the closure and its compiled bodies
+  ~Closure();
+
+  /// return the number of parameters
+  std::size_t arity() const noexcept;
+
+  /// return the parameter symbols in order
+  const std::vector<Atom> & parameters() const noexcept;
+
+  /// return an id no other closure of the process has
+  std::uint64_t id() const noexcept;
+
+  /*! Determine if calls in env go through the memo cache: the closure was
+    made by memoize, or its body is pure and calls a lambda.
+    \param env the calling environment
+  */
+  bool memoized(const Environment & env) const;
+
+  /*! Return the epoch calls in env are memoized and analyzed under: the
+    later of the epochs of the global environment and the captured
+    bindings, so it changes with a definition in either.
+    \param env the calling environment
+  */
+  std::uint64_t epoch(const Environment & env) const;
+
+  /// return the body
+  const Expression & body() const noexcept;
+
+  /*! Return the body to evaluate for a call.
+    \param env the calling environment
+    \return the folded body if env and the captured bindings allow folded
+    bodies, else the body
+  */
+  const Expression & body(const Environment & env) const;
+
+  /*! Return the body to run for a call, compiled on first use.
+    \param env the calling environment
+    \return the compiled body(env)
+  */
+  const Chunk & compiledBody(const Environment & env) const;
+
+  /// return the captured bindings, or nullptr
+  const std::shared_ptr<const Environment> & captured() const noexcept;
+
+  /*! Bind the parameters to the arguments of a call.
+    \param args the evaluated arguments, moved into the frame
+    \param env the calling environment, whose global environment the frame
+    chains to
+    \return the frame to evaluate the body in
+    \throws SemanticError if the number of arguments is wrong
+  */
+  Environment bind(std::vector<Expression> & args, const Environment & env) const;
+
+private:
+
+  // the parameter symbols in order
+  std::vector<Atom> m_parameters;
+
+  Expression m_body;
+
+  std::shared_ptr<const Environment> m_captured;
+
+  std::uint64_t m_id;
+
+  bool m_memoize;
+
+  // the epoch of the last effect analysis shifted left by one, its result
+  // in the low bit, or 0 before the first
+  mutable std::atomic<std::uint64_t> m_analysis;
+
+  // the body with its constant subexpressions folded, once m_foldOnce ran
+  mutable std::once_flag m_foldOnce;
+  mutable Expression m_folded;
+
+  // the compiled body and folded body, once their m_compileOnce ran
+  mutable std::once_flag m_compileOnce[2];
+  mutable std::unique_ptr<const Chunk> m_compiled[2];
+};
+
+#endif
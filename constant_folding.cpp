@@ -0,0 +1,162 @@
+#include "constant_folding.hpp"
+
+#include <unordered_set>
+
+#include "semantic_error.hpp"
+
+// return the built-ins every environment starts with
+static const Environment & builtins(){
+  static const Environment env;
+  return env;
+}
+
+// Folds one lambda body, knowing the names it must leave alone.
+class Folder {
+public:
+
+  Folder(const std::vector<Atom> & parameters, const Environment * captured):
+    m_captured(captured){
+    for(const Atom & parameter : parameters){
+      m_shadowed.insert(parameter.asSymbolId());
+    }
+  }
+
+  // add the names defined anywhere in node, which its frames may bind
+  void collectDefinitions(const Expression & node);
+
+  // fold node into folded, returning false if it is unchanged
+  bool fold(const Expression & node, Expression & folded) const;
+
+private:
+
+  // determine if symbol names a pure built-in in the body
+  bool pure(const Atom & symbol) const{
+    return symbol.isSymbol()
+      && (m_shadowed.find(symbol.asSymbolId()) == m_shadowed.end())
+      && !(m_captured && m_captured->is_known(symbol))
+      && builtins().is_pure(symbol);
+  }
+
+  // fold the operands of node from first, returning false if none changed
+  bool foldOperands(const Expression & node, std::size_t first,
+                    std::vector<Expression> & operands) const;
+
+  std::unordered_set<SymbolId> m_shadowed;
+  const Environment * m_captured;
+};
+
+// a value the evaluator returns unchanged
+static bool isConstant(const Expression & node){
+  if(node.isHeadList()){
+    return true;
+  }
+  return (node.getTailLength() == 0)
+    && (node.isHeadNumber() || node.isHeadComplex() || node.isHeadString());
+}
+
+void Folder::collectDefinitions(const Expression & node){
+  if(node.head().asSymbolId() == DefineSymbol && node.getTailLength() > 0){
+    const Expression & name = *node.tailConstBegin();
+    if(name.isHeadSymbol()){
+      m_shadowed.insert(name.head().asSymbolId());
+    }
+  }
+  if(node.isPacked()){
+    return;
+  }
+  for(auto it = node.tailConstBegin(); it != node.tailConstEnd(); ++it){
+    collectDefinitions(*it);
+  }
+}
+
+bool Folder::foldOperands(const Expression & node, std::size_t first,
+                          std::vector<Expression> & operands) const{
+  operands.assign(node.tailConstBegin(), node.tailConstEnd());
+  bool changed = false;
+  for(std::size_t i = first; i < operands.size(); ++i){
+    Expression folded;
+    if(fold(operands[i], folded)){
+      operands[i] = std::move(folded);
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+bool Folder::fold(const Expression & node, Expression & folded) const{
+  const Atom & head = node.head();
+
+  // values, and references to the built-in constants
+  if(node.isHeadList()){
+    return false;
+  }
+  if(node.getTailLength() == 0 && head.asSymbolId() != ListSymbol){
+    if(pure(head) && builtins().is_exp(head)){
+      folded = builtins().get_exp(head);
+      return true;
+    }
+    return false;
+  }
+
+  // only the operands that are evaluated in the body's frame are folded:
+  // not the names given to define, map and apply, nor nested lambdas,
+  // whose bodies are folded when they are made, nor the operands of the
+  // property, plot and registered special-forms
+  std::size_t first = 0;
+  switch(head.asSymbolId()){
+  case DefineSymbol:
+  case MapSymbol:
+  case ApplySymbol:
+  case PmapSymbol:
+  case PreduceSymbol:
+    first = 1;
+    break;
+  case BeginSymbol:
+    break;
+  default:
+    if(Expression::isSpecialForm(head.asSymbolId())){
+      return false;
+    }
+    break;
+  }
+
+  std::vector<Expression> operands;
+  bool changed = foldOperands(node, first, operands);
+
+  // a call of a pure built-in on constants is replaced by its value
+  if(first == 0 && head.asSymbolId() != BeginSymbol && pure(head) && builtins().is_proc(head)){
+    bool constant = true;
+    for(const Expression & operand : operands){
+      constant = constant && isConstant(operand);
+    }
+    if(constant){
+      try{
+	Expression value = builtins().get_proc(head)(operands);
+	if(isConstant(value)){
+	  folded = std::move(value);
+	  return true;
+	}
+      }
+      catch(const SemanticError &){
+	// raised again by the call when the body is evaluated
+      }
+    }
+  }
+
+  if(changed){
+    folded = Expression(head, std::move(operands));
+  }
+  return changed;
+}
+
+Expression foldConstants(const Expression & body, const std::vector<Atom> & parameters,
+                         const Environment * captured){
+  Folder folder(parameters, captured);
+  folder.collectDefinitions(body);
+
+  Expression folded;
+  if(folder.fold(body, folded)){
+    return folded;
+  }
+  return body;
+}
@@ -0,0 +1,38 @@
+/*! \file constant_folding.hpp
+Defines the constant folding pass over the body of a lambda.
+
+A lambda body is evaluated on every call, often millions of times under
+map, and subexpressions such as (* 2 pi) or (range 0 100 1) give the same
+value each time. The pass replaces each subexpression made only of literals,
+the pure built-in constants and calls of pure built-in procedures by its
+value, computed once.
+
+A name is only folded when nothing the body runs in can bind it: not the
+parameters, not the bindings the lambda captured, and not a name defined
+anywhere in the body. The built-ins are those of the default environment,
+so a folded body is only valid while the global environment it is called
+in still binds them; see Environment::foldedBodies.
+ */
+#ifndef CONSTANT_FOLDING_HPP
+#define CONSTANT_FOLDING_HPP
+
+#include <vector>
+
+#include "atom.hpp"
+#include "environment.hpp"
+#include "expression.hpp"
+
+/*! Fold the constant subexpressions of a lambda body.
+  \param body the body, its parameters resolved to Parameter atoms
+  \param parameters the parameter symbols of the lambda
+  \param captured the bindings the lambda captured, or nullptr
+  \return the folded body, sharing the subexpressions that did not change
+  with body
+
+  A call that raises a SemanticError is left unfolded, so the error is
+  raised when, and only if, the body evaluates it.
+*/
+Expression foldConstants(const Expression & body, const std::vector<Atom> & parameters,
+                         const Environment * captured);
+
+#endif
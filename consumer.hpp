@@ -97,10 +97,10 @@ public:
 			else {
 				try {
 					exp = interp->evaluate();
-					expressionQueue->push(exp);
+					expressionQueue->push(std::move(exp));
 				}
 				catch (const SemanticError & ex) {
-					interp->setEnv(tempEnv);
+					interp->setEnv(std::move(tempEnv));
 					std::string error("error");
 					std::string stringErrorMessage(ex.what());
 					error.append(stringErrorMessage);
@@ -1,11 +1,16 @@
 #include "environment.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <complex>
 #include <iostream>
+#include "closure.hpp"
 #include "environment.hpp"
+#include "memoization.hpp"
 #include "semantic_error.hpp"
+#include "vector_kernels.hpp"
 
 /*********************************************************************** 
 Helper Functions
@@ -16,6 +21,80 @@ bool nargs_equal(const std::vector<Expression> & args, unsigned nargs){
   return args.size() == nargs;
 }
 
+// predicate, at least one of the args is a list
+bool any_list(const std::vector<Expression> & args){
+  for (auto & a : args) {
+    if (a.isHeadList()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+Apply proc element-wise over the list arguments, broadcasting the other
+arguments to every element. All lists must have the same length. When every
+list is packed and every other argument is a number the result is computed
+by folding op over the arguments with the vector kernels; unary subtraction
+and division are treated as (0 - x) and (1 / x). Otherwise proc is called
+once per element, so complex and nested values keep their usual meaning.
+ */
+Expression broadcast(const std::vector<Expression> & args, Procedure proc, VectorOp op, const std::string & name){
+
+  std::size_t length = 0;
+  bool haveLength = false;
+  bool packed = true;
+  for (auto & a : args) {
+    if (a.isHeadList()) {
+      if (haveLength && a.getTailLength() != length) {
+        throw SemanticError("Error in call to " + name + ": list arguments differ in length.");
+      }
+      length = a.getTailLength();
+      haveLength = true;
+      packed = packed && (a.isPacked() || length == 0);
+    }
+    else {
+      packed = packed && a.isPlainNumber();
+    }
+  }
+
+  if (packed) {
+    std::vector<double> result(length);
+    std::size_t first = 0;
+    if (nargs_equal(args, 1) && (op == VectorSubtract || op == VectorDivide)) {
+      std::fill(result.begin(), result.end(), (op == VectorDivide) ? 1.0 : 0.0);
+    }
+    else if (args[0].isHeadList()) {
+      std::copy(args[0].packedValues().begin(), args[0].packedValues().end(), result.begin());
+      first = 1;
+    }
+    else {
+      std::fill(result.begin(), result.end(), args[0].head().asNumber());
+      first = 1;
+    }
+    for (std::size_t i = first; i < args.size(); i++) {
+      if (args[i].isHeadList()) {
+        vectorBinary(op, result.data(), false, args[i].packedValues().data(), false, result.data(), length);
+      }
+      else {
+        double value = args[i].head().asNumber();
+        vectorBinary(op, result.data(), false, &value, true, result.data(), length);
+      }
+    }
+    return Expression(std::move(result));
+  }
+
+  std::list<Expression> result;
+  std::vector<Expression> elementArgs(args.size());
+  for (std::size_t i = 0; i < length; i++) {
+    for (std::size_t j = 0; j < args.size(); j++) {
+      elementArgs[j] = args[j].isHeadList() ? args[j].getValueInTail(i) : args[j];
+    }
+    result.push_back(proc(elementArgs));
+  }
+  return Expression(std::move(result));
+}
+
 /*********************************************************************** 
 Each of the functions below have the signature that corresponds to the
 typedef'd Procedure function pointer.
@@ -27,31 +106,85 @@ Expression default_proc(const std::vector<Expression> & args){
   return Expression();
 };
 
+/*
+Apply proc to every element of a list. A packed list is computed by the
+vector kernel f in a single call, unless vectorize is false; any other list
+calls proc per element.
+ */
+Expression broadcastUnary(const Expression & list, Procedure proc, VectorFunction f, bool vectorize = true){
+
+  if (list.isPacked() && vectorize) {
+    const std::vector<double> & values = list.packedValues();
+    std::vector<double> result(values.size());
+    vectorUnary(f, values.data(), result.data(), values.size());
+    return Expression(std::move(result));
+  }
+
+  std::list<Expression> result;
+  std::vector<Expression> elementArgs(1);
+  for (auto e = list.tailConstBegin(); e != list.tailConstEnd(); ++e) {
+    elementArgs[0] = *e;
+    result.push_back(proc(elementArgs));
+  }
+  return Expression(std::move(result));
+}
+
+// evaluate the vector kernel f for a single number
+double unaryKernel(VectorFunction f, double x){
+  double result;
+  vectorUnary(f, &x, &result, 1);
+  return result;
+}
+
 Expression add(const std::vector<Expression> & args){
 
-  // check all aruments are numbers or complex, while adding
+  if (any_list(args)) {
+    return broadcast(args, add, VectorAdd, "add");
+  }
+
+  // check all aruments are numbers or complex, while adding; the sum stays
+  // real until the first complex argument
+  double sum = 0.0;
   std::complex<double> result (0.0, 0.0);
+  bool complex = false;
   for( auto & a :args){
     if(a.isHeadNumber()){
-		result= result + a.head().asNumber();
+      if (complex) {
+        result = result + a.head().asNumber();
+      }
+      else {
+        sum = sum + a.head().asNumber();
+      }
     }
 	else if (a.isHeadComplex()) {
+		if (!complex) {
+			result = sum;
+			complex = true;
+		}
 		result = result + a.head().asComplex();
 	}
     else{
       throw SemanticError("Error in call to add, argument not a number");
     }
   }
-  for (auto & a : args) {
-	  if (a.isHeadComplex()) {
-		  return Expression(result);
-	  }
+  if (complex) {
+	  return Expression(result);
   }
-  return Expression(result.real());
+  return Expression(sum);
 };
 
-Expression mul(const std::vector<Expression> & args){
- 
+// the specialized entries of add, summing from zero as add does
+double addUnary(double x){
+  return 0.0 + x;
+}
+
+double addBinary(double x, double y){
+  return 0.0 + x + y;
+}
+
+// the product of numbers and complex numbers, as mul
+Expression mulComplex(const std::vector<Expression> & args){
+
   // check all aruments are numbers or complex, while multiplying
 	std::complex<double> result(1.0, 0.0);
   for( auto & a :args){
@@ -74,10 +207,41 @@ Expression mul(const std::vector<Expression> & args){
   return Expression(result.real());
 };
 
+Expression mul(const std::vector<Expression> & args){
+ 
+  if (any_list(args)) {
+    return broadcast(args, mul, VectorMultiply, "mul");
+  }
+
+  // a product of numbers is real; the signed zeros of a complex product
+  // depend on every factor, so one is computed from the start
+  double product = 1.0;
+  for (auto & a : args) {
+    if (!a.isHeadNumber()) {
+      return mulComplex(args);
+    }
+    product = product * a.head().asNumber();
+  }
+  return Expression(product);
+};
+
+// the specialized entries of mul
+double mulUnary(double x){
+  return x;
+}
+
+double mulBinary(double x, double y){
+  return x * y;
+}
+
 Expression subneg(const std::vector<Expression> & args){
 	// check all aruments are numbers or complex, while subtracting or negating
 	std::complex<double> result(0.0, 0.0);
 	
+  if ((nargs_equal(args, 1) || nargs_equal(args, 2)) && any_list(args)) {
+    return broadcast(args, subneg, VectorSubtract, "subtraction");
+  }
+
   // preconditions
   if(nargs_equal(args,1)){
     if(args[0].isHeadNumber()){
@@ -121,9 +285,21 @@ Expression subneg(const std::vector<Expression> & args){
 
 };
 
+// the specialized entries of subneg
+double negateUnary(double x){
+  return -x;
+}
+
+double subtractBinary(double x, double y){
+  return x - y;
+}
+
 Expression div(const std::vector<Expression> & args){
 	// check all aruments are numbers or complex, while dividing
 	std::complex<double> result(0.0, 0.0);
+	if ((nargs_equal(args, 1) || nargs_equal(args, 2)) && any_list(args)) {
+		return broadcast(args, div, VectorDivide, "division");
+	}
 	if (nargs_equal(args, 1)) {
 		if (args[0].isHeadNumber() || args[0].isHeadComplex()) {
 			if (args[0].isHeadNumber()) {
@@ -176,14 +352,31 @@ Expression div(const std::vector<Expression> & args){
   return Expression(result.real());
 };
 
+// the specialized entries of div
+double divideUnary(double x){
+  return 1 / x;
+}
+
+double divideBinary(double x, double y){
+  return x / y;
+}
+
 Expression sqrt(const std::vector<Expression> & args) {
 	// check all aruments are numbers or complex, while square rooting
 	std::complex<double> result (0.0, 0.0);
 
 	if (nargs_equal(args, 1)) {
+		if (args[0].isHeadList()) {
+			// negative numbers have complex roots, so they go element by element
+			bool negative = false;
+			for (double v : args[0].packedValues()) {
+				negative = negative || (v < 0);
+			}
+			return broadcastUnary(args[0], sqrt, VectorSqrt, !negative);
+		}
 		if (args[0].isHeadNumber()) {
 			if (args[0].head().asNumber() >= 0 ) {
-				result=pow(args[0].head().asNumber(), 0.5);
+				result = unaryKernel(VectorSqrt, args[0].head().asNumber());
 			}
 			else if (args[0].head().asNumber() < 0) {
 				result.imag(pow(-args[0].head().asNumber(), 0.5));
@@ -213,6 +406,9 @@ Expression sqrt(const std::vector<Expression> & args) {
 Expression power(const std::vector<Expression> & args) {
 	// check all aruments are numbers or complex, while computing power
 	std::complex<double> result (0.0, 0.0);
+	if (nargs_equal(args, 2) && any_list(args)) {
+		return broadcast(args, power, VectorPower, "pow");
+	}
 	if (nargs_equal(args, 2)) {
 		if (((args[0].isHeadNumber()) || (args[0].isHeadComplex())) && ((args[1].isHeadNumber()) || (args[1].isHeadComplex()))) {
 			if ((args[0].isHeadNumber())) {
@@ -247,14 +443,28 @@ Expression power(const std::vector<Expression> & args) {
 	return Expression(result.real());
 };
 
+// the specialized entry of power
+double powerBinary(double x, double y){
+  return std::pow(x, y);
+}
+
 Expression naturalLog(const std::vector<Expression> & args) {
 	// check all aruments are numbers, while taking natural log
 	double result = 0;
 
 	if (nargs_equal(args, 1)) {
+		if (args[0].isHeadList()) {
+			// NaN fails the check, as in the scalar case
+			for (double v : args[0].packedValues()) {
+				if (!(v >= 0)) {
+					throw SemanticError("Error in call to natural log: invalid argument.");
+				}
+			}
+			return broadcastUnary(args[0], naturalLog, VectorLog);
+		}
 		if (args[0].isHeadNumber()) {
 			if (args[0].head().asNumber() >= 0) {
-				result = log(args[0].head().asNumber());
+				result = unaryKernel(VectorLog, args[0].head().asNumber());
 			}
 			else {
 				throw SemanticError("Error in call to natural log: invalid argument.");
@@ -270,13 +480,24 @@ Expression naturalLog(const std::vector<Expression> & args) {
 	return Expression(result);
 };
 
+// the specialized entry of naturalLog
+double naturalLogUnary(double x){
+  if (!(x >= 0)) {
+    throw SemanticError("Error in call to natural log: invalid argument.");
+  }
+  return unaryKernel(VectorLog, x);
+}
+
 Expression sine(const std::vector<Expression> & args) {
 	// check all aruments are numbers, while taking sine
 	double result = 0;
 
 	if (nargs_equal(args, 1)) {
+		if (args[0].isHeadList()) {
+			return broadcastUnary(args[0], sine, VectorSin);
+		}
 		if (args[0].isHeadNumber()) {
-			result = sin(args[0].head().asNumber());
+			result = unaryKernel(VectorSin, args[0].head().asNumber());
 		}
 		else {
 			throw SemanticError("Error in call to sin: invalid argument.");
@@ -288,13 +509,21 @@ Expression sine(const std::vector<Expression> & args) {
 	return Expression(result);
 };
 
+// the specialized entry of sine
+double sineUnary(double x){
+  return unaryKernel(VectorSin, x);
+}
+
 Expression cosine(const std::vector<Expression> & args) {
 	// check all aruments are numbers, while taking cosine
 	double result = 0;
 
 	if (nargs_equal(args, 1)) {
+		if (args[0].isHeadList()) {
+			return broadcastUnary(args[0], cosine, VectorCos);
+		}
 		if (args[0].isHeadNumber()) {
-			result = cos(args[0].head().asNumber());
+			result = unaryKernel(VectorCos, args[0].head().asNumber());
 		}
 		else {
 			throw SemanticError("Error in call to cos: invalid argument.");
@@ -306,26 +535,21 @@ Expression cosine(const std::vector<Expression> & args) {
 	return Expression(result);
 };
 
+// the specialized entry of cosine
+double cosineUnary(double x){
+  return unaryKernel(VectorCos, x);
+}
+
 Expression tangent(const std::vector<Expression> & args) {
 	// check all aruments are numbers, while taking tangent
 	double result = 0;
-	double distance;
 	if (nargs_equal(args, 1)) {
+		if (args[0].isHeadList()) {
+			return broadcastUnary(args[0], tangent, VectorTan);
+		}
 		if (args[0].isHeadNumber()) {
-			distance = args[0].head().asNumber();
-			if (distance > 0) {
-				while (distance > (atan2(0, -1) / 2)) {
-					distance = distance - (atan2(0, -1) / 2);
-				}
-			}
-			else {
-				while (distance < (-atan2(0, -1) / 2)) {
-					distance = distance + (atan2(0, -1) / 2);
-				}
-			}
-			distance = args[0].head().asNumber();
-			result = tan(distance);
-
+			// the kernel reduces the argument in constant time
+			result = unaryKernel(VectorTan, args[0].head().asNumber());
 		}
 		else {
 			throw SemanticError("Error in call to tangent: invalid argument.");
@@ -337,6 +561,11 @@ Expression tangent(const std::vector<Expression> & args) {
 	return Expression(result);
 };
 
+// the specialized entry of tangent
+double tangentUnary(double x){
+  return unaryKernel(VectorTan, x);
+}
+
 Expression real(const std::vector<Expression> & args) {
 	// check all aruments are complex, while finding real value
 	double result = 0;
@@ -429,12 +658,11 @@ Expression list(const std::vector<Expression> & args) {
 	for (auto & a : args) {
 		result.push_back(a);
 	}
-	return Expression(result);
+	return Expression(std::move(result));
 };
 
 Expression firstElementList(const std::vector<Expression> & args) {
 	// check all aruments are lists, while finding first
-	Expression result;
 	if (nargs_equal(args, 1)) {
 		if (args[0].isHeadList()) {
 			auto e = args[0].tailConstBegin();
@@ -442,8 +670,7 @@ Expression firstElementList(const std::vector<Expression> & args) {
 				throw SemanticError("Error in call to first: list is empty.");
 			}
 			else {
-				result = *e;
-				return Expression(result);
+				return *e;
 			}
 		}
 		else {
@@ -465,13 +692,18 @@ Expression restList(const std::vector<Expression> & args) {
 			if (e == args[0].tailConstEnd()) {
 				throw SemanticError("Error in call to rest: list is empty.");
 			}
+			else if (args[0].isPacked()) {
+				// packed lists copy their numbers directly
+				const std::vector<double> & values = args[0].packedValues();
+				return Expression(std::vector<double>(values.begin() + 1, values.end()));
+			}
 			else {
 				e = e + 1;
 				while( e != args[0].tailConstEnd()){
 					result.push_back(*e);
 					++e;
 				}
-				return Expression(result);
+				return Expression(std::move(result));
 			}
 		}
 		else {
@@ -489,9 +721,7 @@ Expression lengthList(const std::vector<Expression> & args) {
 	double result=0;
 	if (nargs_equal(args, 1)) {
 		if (args[0].isHeadList()) {
-			for (auto e = args[0].tailConstBegin(); e != args[0].tailConstEnd(); ++e) {
-				result++;
-			}
+			result = args[0].getTailLength();
 			return Expression(result);
 		}
 		else {
@@ -509,11 +739,16 @@ Expression appendLists(const std::vector<Expression> & args) {
 	std::list<Expression> result;
 	if (nargs_equal(args, 2)) {
 		if (args[0].isHeadList()) {
+			if (args[0].isPacked() && args[1].isPlainNumber()) {
+				std::vector<double> values(args[0].packedValues());
+				values.push_back(args[1].head().asNumber());
+				return Expression(std::move(values));
+			}
 			for (auto e = args[0].tailConstBegin(); e != args[0].tailConstEnd(); ++e) {
 				result.push_back(*e);
 			}
 			result.push_back(args[1]);
-			return Expression(result);
+			return Expression(std::move(result));
 		}
 		else {
 			throw SemanticError("Error in call to append: first argument is not a list.");
@@ -530,13 +765,20 @@ Expression joinLists(const std::vector<Expression> & args) {
 	std::list<Expression> result;
 	if (nargs_equal(args, 2)) {
 		if (args[0].isHeadList() && args[1].isHeadList()) {
+			if (args[0].isPacked() && args[1].isPacked()) {
+				std::vector<double> values;
+				values.reserve(args[0].getTailLength() + args[1].getTailLength());
+				values.insert(values.end(), args[0].packedValues().begin(), args[0].packedValues().end());
+				values.insert(values.end(), args[1].packedValues().begin(), args[1].packedValues().end());
+				return Expression(std::move(values));
+			}
 			for (auto e = args[0].tailConstBegin(); e != args[0].tailConstEnd(); ++e) {
 				result.push_back(*e);
 			}
 			for (auto e = args[1].tailConstBegin(); e != args[1].tailConstEnd(); ++e) {
 				result.push_back(*e);
 			}
-			return Expression(result);
+			return Expression(std::move(result));
 		}
 		else {
 			throw SemanticError("Error in call to join: argument is not a list.");
@@ -554,13 +796,12 @@ Expression rangeLists(const std::vector<Expression> & args) {
 		if (args[0].isHeadNumber() && args[1].isHeadNumber() && args[2].isHeadNumber()) {
 			if (args[0].head().asNumber() <= args[1].head().asNumber()) {
 				if (args[2].head().asNumber() > 0) {
-					std::list<Expression> listResult;
+					std::vector<double> listResult;
 					for (double temp = args[0].head().asNumber(); temp <= args[1].head().asNumber(); temp = temp + args[2].head().asNumber()) {
-						listResult.push_back(Expression(temp));
+						listResult.push_back(temp);
 						
 					}
-					Expression result(listResult);
-					return Expression(result);
+					return Expression(std::move(listResult));
 				}
 				else {
 					throw SemanticError("Error in call to range: increment is negative or zero.");
@@ -584,51 +825,251 @@ Expression rangeLists(const std::vector<Expression> & args) {
 const double PI = std::atan2(0, -1);
 const double EXP = std::exp(1);
 const std::complex<double> I (0.0, 1.0);
-bool Environment::interruptThrown = false;
+std::atomic<bool> Environment::interruptThrown(false);
+
+// every built-in is pure: its value, or the result of calling it, depends
+// only on its arguments
+static const bool Pure = true;
+
+// return an epoch no global environment has had
+static std::uint64_t nextEpoch(){
+  static std::atomic<std::uint64_t> epochs(1);
+  return epochs++;
+}
 
-Environment::Environment(){
+// the chain mask bit of a symbol
+static std::uint64_t chainBit(SymbolId id){
+  return std::uint64_t(1) << (id % 64);
+}
+
+Environment::Environment(): m_parent(nullptr), m_root(nullptr), m_chainMask(0),
+  m_folding(true), m_epoch(0), m_memo(std::make_shared<MemoCache>()),
+  m_builtinsIntact(true){
   reset();
 }
 
+Environment::Environment(const Environment * parent):
+  m_parent(parent),
+  m_root(parent->m_parent ? parent->m_root : parent),
+  m_chainMask(parent->m_parent ? parent->m_chainMask : 0),
+  m_folding(true), m_epoch(0), m_builtinsIntact(true){}
+
+Environment Environment::frame() const{
+  return Environment(this);
+}
+
+Environment Environment::closureFrame(std::shared_ptr<const Environment> captured) const{
+  Environment frame(m_parent ? m_root : this);
+  if(captured){
+    // the captured bindings may have grown since the closure was made
+    for(const Environment * scope = captured.get(); scope != nullptr; scope = scope->m_captured.get()){
+      frame.m_chainMask |= scope->m_chainMask;
+    }
+    frame.m_captured = SharedBindings(std::move(captured));
+  }
+  return frame;
+}
+
+std::shared_ptr<const Environment> Environment::capture() const{
+  if(m_parent == nullptr){
+    return nullptr;
+  }
+
+  // moving the bindings does not change what the frame binds
+  Environment & frame = const_cast<Environment &>(*this);
+  if(!frame.m_shared.get()){
+    // only the bindings are searched, they are never a frame themselves
+    std::shared_ptr<Environment> shared(new Environment(this));
+    shared->m_parent = nullptr;
+    shared->m_root = nullptr;
+    shared->m_chainMask = 0;
+    shared->m_epoch = nextEpoch();
+    shared->m_parameters = std::move(frame.m_parameters);
+    shared->envmap = std::move(frame.envmap);
+    frame.m_parameters.clear();
+    frame.envmap.clear();
+    for(const Parameter & parameter : shared->m_parameters){
+      shared->m_chainMask |= chainBit(parameter.name);
+    }
+    for(auto & entry : shared->envmap){
+      shared->m_chainMask |= chainBit(entry.first);
+    }
+
+    // a closure's frame goes on to what the closure captured, a frame made
+    // by frame() to the frames it was made from
+    shared->m_captured = m_captured.get() ? m_captured : SharedBindings(m_parent->capture());
+    frame.m_shared = SharedBindings(std::move(shared));
+  }
+  return frame.m_shared.bindings;
+}
+
+Environment::SharedBindings & Environment::SharedBindings::operator=(SharedBindings other){
+  release(bindings);
+  bindings = std::move(other.bindings);
+  return *this;
+}
+
+Environment::SharedBindings::~SharedBindings(){
+  release(bindings);
+}
+
+void Environment::release(std::shared_ptr<const Environment> & captured) noexcept{
+  if(!captured){
+    return;
+  }
+
+  // each closure stored in the bindings that captured them holds them once
+  Environment & shared = const_cast<Environment &>(*captured);
+  long holders = captured.use_count() - 1;
+  if(holders == 0 || holders > static_cast<long>(shared.m_parameters.size() + shared.envmap.size())){
+    captured.reset();
+    return;
+  }
+
+  // the bindings can only be reached through themselves if those closures
+  // are all of their other holders and are stored once, with no other owner
+  long closures = 0;
+  auto held = [&shared, &closures](const EnvResult & value){
+    const Closure * closure = value.exp.head().asClosure();
+    if(closure == nullptr || closure->captured().get() != &shared){
+      return true;
+    }
+    ++closures;
+    return value.exp.head().closureUseCount() == 1;
+  };
+  bool cycle = true;
+  for(const Parameter & parameter : shared.m_parameters){
+    cycle = cycle && held(parameter.value);
+  }
+  for(auto & entry : shared.envmap){
+    cycle = cycle && held(entry.second);
+  }
+  if(cycle && closures == holders){
+    shared.m_parameters.clear();
+    shared.envmap.clear();
+  }
+  captured.reset();
+}
+
+// the last parameter of a name wins, as when binding them one after the other
+Environment::Parameter * Environment::find_parameter(SymbolId id){
+  for(auto it = m_parameters.rbegin(); it != m_parameters.rend(); ++it){
+    if(it->name == id){
+      return &*it;
+    }
+  }
+  return nullptr;
+}
+
+const Environment::Parameter * Environment::find_parameter(SymbolId id) const{
+  return const_cast<Environment *>(this)->find_parameter(id);
+}
+
+const Environment::EnvResult * Environment::find_binding(SymbolId id) const{
+  const Parameter * parameter = find_parameter(id);
+  if(parameter != nullptr && parameter->bound){
+    return &parameter->value;
+  }
+  auto result = envmap.find(id);
+  return (result != envmap.end()) ? &result->second : nullptr;
+}
+
+Environment & Environment::bindings(){
+  return m_shared.get() ? const_cast<Environment &>(*m_shared.get()) : *this;
+}
+
+const Environment & Environment::bindings() const{
+  return m_shared.get() ? *m_shared.get() : *this;
+}
+
+const Environment::EnvResult * Environment::find(const Atom & sym) const{
+  if(!sym.isSymbol()) return nullptr;
+
+  SymbolId id = sym.asSymbolId();
+  const Environment * frame = this;
+  while(frame->m_parent != nullptr){
+    if((frame->m_chainMask & chainBit(id)) == 0){
+      // bound by no frame of the chain
+      frame = frame->m_root;
+      break;
+    }
+    // the frame's bindings, then those its closure captured, innermost first
+    for(const Environment * scope = &frame->bindings(); scope != nullptr; scope = scope->m_captured.get()){
+      const EnvResult * result = scope->find_binding(id);
+      if(result != nullptr){
+	return result;
+      }
+    }
+    frame = frame->m_parent;
+  }
+
+  // the global environment, or captured bindings and those they chain to
+  for(; frame != nullptr; frame = frame->m_captured.get()){
+    const EnvResult * result = frame->find_binding(id);
+    if(result != nullptr){
+      return result;
+    }
+  }
+  return nullptr;
+}
+
 bool Environment::is_known(const Atom & sym) const{
-  if(!sym.isSymbol()) return false;
-  
-  return envmap.find(sym.asSymbol()) != envmap.end();
+  return find(sym) != nullptr;
 }
 
 bool Environment::is_exp(const Atom & sym) const{
-  if(!sym.isSymbol()) return false;
-  
-  auto result = envmap.find(sym.asSymbol());
-  return (result != envmap.end()) && (result->second.type == ExpressionType);
+  const EnvResult * result = find(sym);
+  return (result != nullptr) && (result->type == ExpressionType);
 }
 
 Expression Environment::get_exp(const Atom & sym) const{
 
   Expression exp;
-  
-  if(sym.isSymbol()){
-    auto result = envmap.find(sym.asSymbol());
-    if((result != envmap.end()) && (result->second.type == ExpressionType)){
-      exp = result->second.exp;
-    }
+
+  const EnvResult * result = find(sym);
+  if((result != nullptr) && (result->type == ExpressionType)){
+    exp = result->exp;
   }
 
   return exp;
 }
 
-void Environment::add_exp(const Atom & sym, const Expression & exp){
+void Environment::add_exp(const Atom & sym, Expression exp){
 
   if(!sym.isSymbol()){
     throw SemanticError("Attempt to add non-symbol to environment");
   }
     
-  // error if overwriting symbol map
-  if(envmap.find(sym.asSymbol()) != envmap.end()){
-	delete_exp(sym);
+  m_chainMask |= chainBit(sym.asSymbolId());
+
+  // a captured frame defines in its shared bindings, where shadowing a pure
+  // built-in keeps the closures made there from their folded bodies
+  Environment & own = bindings();
+  if(&own != this){
+    own.m_chainMask |= chainBit(sym.asSymbolId());
+    if(m_root->is_pure(sym)){
+      own.m_builtinsIntact = false;
+    }
   }
 
-  envmap.emplace(sym.asSymbol(), EnvResult(ExpressionType, exp)); 
+  // a parameter is redefined in its slot
+  Parameter * parameter = own.find_parameter(sym.asSymbolId());
+  if(parameter != nullptr){
+    parameter->bound = true;
+    parameter->value.exp = std::move(exp);
+  }
+  else{
+    // error if overwriting symbol map
+    if(own.envmap.find(sym.asSymbolId()) != own.envmap.end()){
+      delete_exp(sym);
+    }
+    own.envmap.emplace(sym.asSymbolId(), EnvResult(ExpressionType, std::move(exp)));
+  }
+
+  // calls memoized under the old global or captured bindings no longer match
+  if(own.m_parent == nullptr){
+    own.m_epoch = nextEpoch();
+  }
 }
 
 void Environment::delete_exp(const Atom &sym) {
@@ -636,32 +1077,157 @@ void Environment::delete_exp(const Atom &sym) {
 		throw SemanticError("Attempt to add non-symbol to environment");
 	}
 
-	if (envmap.find(sym.asSymbol()) != envmap.end()) {
-		envmap.erase(sym.asSymbol());
+	Environment & own = bindings();
+	bool deleted = false;
+
+	Parameter * parameter = own.find_parameter(sym.asSymbolId());
+	if (parameter != nullptr) {
+		parameter->bound = false;
+		parameter->value.exp = Expression();
+		deleted = true;
+	}
+
+	auto result = own.envmap.find(sym.asSymbolId());
+	if (result != own.envmap.end()) {
+		// lambdas folded while it was pure may no longer use their folded bodies
+		if (result->second.pure) {
+			own.m_builtinsIntact = false;
+		}
+		own.envmap.erase(result);
+		deleted = true;
+	}
+
+	if (deleted && own.m_parent == nullptr) {
+		own.m_epoch = nextEpoch();
 	}
 }
 
+void Environment::add_parameter(const Atom & sym, Expression exp){
+
+  if(!sym.isSymbol()){
+    throw SemanticError("Attempt to add non-symbol to environment");
+  }
+
+  Environment & own = bindings();
+  m_chainMask |= chainBit(sym.asSymbolId());
+  own.m_chainMask |= chainBit(sym.asSymbolId());
+  own.m_parameters.push_back(Parameter{sym.asSymbolId(), true, EnvResult(ExpressionType, std::move(exp))});
+}
+
+const Expression * Environment::find_parameter(const Atom & sym) const{
+  const std::vector<Parameter> & parameters = bindings().m_parameters;
+  std::uint32_t slot = sym.asParameterSlot();
+  if(!sym.isParameter() || slot >= parameters.size()){
+    return nullptr;
+  }
+
+  const Parameter & parameter = parameters[slot];
+  if(parameter.name != sym.asParameterSymbol() || !parameter.bound){
+    return nullptr;
+  }
+  return &parameter.value.exp;
+}
+
 bool Environment::is_proc(const Atom & sym) const{
-  if(!sym.isSymbol()) return false;
-  
-  auto result = envmap.find(sym.asSymbol());
-  return (result != envmap.end()) && (result->second.type == ProcedureType);
+  const EnvResult * result = find(sym);
+  return (result != nullptr) && (result->type == ProcedureType);
 }
 
 Procedure Environment::get_proc(const Atom & sym) const{
 
   //Procedure proc = default_proc;
 
-  if(sym.isSymbol()){
-    auto result = envmap.find(sym.asSymbol());
-    if((result != envmap.end()) && (result->second.type == ProcedureType)){
-      return result->second.proc;
-    }
+  const EnvResult * result = find(sym);
+  if((result != nullptr) && (result->type == ProcedureType)){
+    return result->proc;
   }
 
   return default_proc;
 }
 
+bool Environment::is_pure(const Atom & sym) const{
+  const EnvResult * result = find(sym);
+  return (result != nullptr) && result->pure;
+}
+
+void Environment::setConstantFolding(bool enabled){
+  m_folding = enabled;
+}
+
+bool Environment::constantFolding() const{
+  return (m_parent ? m_root : this)->m_folding;
+}
+
+std::uint64_t Environment::epoch() const{
+  if(m_parent != nullptr){
+    return m_root->m_epoch;
+  }
+  std::uint64_t epoch = m_epoch;
+  for(const Environment * scope = m_captured.get(); scope != nullptr; scope = scope->m_captured.get()){
+    epoch = std::max(epoch, scope->m_epoch);
+  }
+  return epoch;
+}
+
+MemoCache & Environment::memoCache() const{
+  return *(m_parent ? m_root : this)->m_memo;
+}
+
+void Environment::setExecutor(std::shared_ptr<Executor> executor){
+  m_executor = executor;
+}
+
+Executor * Environment::executor() const{
+  return (m_parent ? m_root : this)->m_executor.get();
+}
+
+bool Environment::foldedBodies() const{
+  const Environment * root = m_parent ? m_root : this;
+  if(!root->m_folding){
+    return false;
+  }
+  for(const Environment * scope = root; scope != nullptr; scope = scope->m_captured.get()){
+    if(!scope->m_builtinsIntact){
+      return false;
+    }
+  }
+  return true;
+}
+
+NumericProcedure Environment::get_numeric(const Atom & sym) const{
+
+  const EnvResult * result = find(sym);
+  if((result != nullptr) && (result->type == ProcedureType)){
+    return result->numeric;
+  }
+
+  return NumericProcedure{nullptr, nullptr};
+}
+
+bool Environment::apply_numeric(const Atom & sym, const Expression * args, std::size_t nargs,
+				Expression & result) const{
+
+  if(nargs == 0 || nargs > 2){
+    return false;
+  }
+  for(std::size_t i = 0; i < nargs; ++i){
+    if(!args[i].isPlainNumber()){
+      return false;
+    }
+  }
+
+  NumericProcedure numeric = get_numeric(sym);
+  if(nargs == 1 && numeric.unary != nullptr){
+    result = Expression(numeric.unary(args[0].head().asNumber()));
+    return true;
+  }
+  if(nargs == 2 && numeric.binary != nullptr){
+    result = Expression(numeric.binary(args[0].head().asNumber(), args[1].head().asNumber()));
+    return true;
+  }
+  return false;
+}
+
 
 
 /*
@@ -671,81 +1237,89 @@ then re-add the default ones.
 void Environment::reset(){
 
   envmap.clear();
+  m_parameters.clear();
+  m_parent = nullptr;
+  m_root = nullptr;
+  m_captured = SharedBindings();
+  m_shared = SharedBindings();
+  m_chainMask = 0;
+  m_epoch = nextEpoch();
+  m_builtinsIntact = true;
   
   // Built-In value of pi
-  envmap.emplace("pi", EnvResult(ExpressionType, Expression(PI)));
+  envmap.emplace(intern("pi"), EnvResult(ExpressionType, Expression(PI), Pure));
 
   // Procedure: add;
-  envmap.emplace("+", EnvResult(ProcedureType, add)); 
+  envmap.emplace(intern("+"), EnvResult(ProcedureType, add, Pure, NumericProcedure{addUnary, addBinary})); 
 
   // Procedure: subneg;
-  envmap.emplace("-", EnvResult(ProcedureType, subneg)); 
+  envmap.emplace(intern("-"), EnvResult(ProcedureType, subneg, Pure, NumericProcedure{negateUnary, subtractBinary})); 
 
   // Procedure: mul;
-  envmap.emplace("*", EnvResult(ProcedureType, mul)); 
+  envmap.emplace(intern("*"), EnvResult(ProcedureType, mul, Pure, NumericProcedure{mulUnary, mulBinary})); 
 
   // Procedure: div;
-  envmap.emplace("/", EnvResult(ProcedureType, div)); 
+  envmap.emplace(intern("/"), EnvResult(ProcedureType, div, Pure, NumericProcedure{divideUnary, divideBinary})); 
 
   // Built-In value of e;
-  envmap.emplace("e", EnvResult(ExpressionType, Expression(EXP)));
+  envmap.emplace(intern("e"), EnvResult(ExpressionType, Expression(EXP), Pure));
 
   // Procedure: sqrt;
-  envmap.emplace("sqrt", EnvResult(ProcedureType, sqrt));
+  envmap.emplace(intern("sqrt"), EnvResult(ProcedureType, sqrt, Pure));
 
   // Procedure: power;
-  envmap.emplace("^", EnvResult(ProcedureType, power));
+  envmap.emplace(intern("^"), EnvResult(ProcedureType, power, Pure, NumericProcedure{nullptr, powerBinary}));
 
   // Procedure: natural log;
-  envmap.emplace("ln", EnvResult(ProcedureType, naturalLog));
+  envmap.emplace(intern("ln"), EnvResult(ProcedureType, naturalLog, Pure, NumericProcedure{naturalLogUnary, nullptr}));
 
   // Procedure: sine;
-  envmap.emplace("sin", EnvResult(ProcedureType, sine));
+  envmap.emplace(intern("sin"), EnvResult(ProcedureType, sine, Pure, NumericProcedure{sineUnary, nullptr}));
 
   // Procedure: cosine;
-  envmap.emplace("cos", EnvResult(ProcedureType, cosine));
+  envmap.emplace(intern("cos"), EnvResult(ProcedureType, cosine, Pure, NumericProcedure{cosineUnary, nullptr}));
 
   // Procedure: tangent;
-  envmap.emplace("tan", EnvResult(ProcedureType, tangent));
+  envmap.emplace(intern("tan"), EnvResult(ProcedureType, tangent, Pure, NumericProcedure{tangentUnary, nullptr}));
 
   // Built-In value of i;
-  envmap.emplace("I", EnvResult(ExpressionType, Expression(I)));
+  envmap.emplace(intern("I"), EnvResult(ExpressionType, Expression(I), Pure));
 
   // Procedure: real value;
-  envmap.emplace("real", EnvResult(ProcedureType, real));
+  envmap.emplace(intern("real"), EnvResult(ProcedureType, real, Pure));
 
   // Procedure: imaginary value;
-  envmap.emplace("imag", EnvResult(ProcedureType, imaginary));
+  envmap.emplace(intern("imag"), EnvResult(ProcedureType, imaginary, Pure));
 
   // Procedure: magnitude;
-  envmap.emplace("mag", EnvResult(ProcedureType, magnitude));
+  envmap.emplace(intern("mag"), EnvResult(ProcedureType, magnitude, Pure));
 
   // Procedure: argument;
-  envmap.emplace("arg", EnvResult(ProcedureType, argument));
+  envmap.emplace(intern("arg"), EnvResult(ProcedureType, argument, Pure));
 
   // Procedure: conjugate;
-  envmap.emplace("conj", EnvResult(ProcedureType, conjugate));
+  envmap.emplace(intern("conj"), EnvResult(ProcedureType, conjugate, Pure));
 
   // Procedure: conjugate;
-  envmap.emplace("list", EnvResult(ProcedureType, list));
+  envmap.emplace(ListSymbol, EnvResult(ProcedureType, list, Pure));
 
   // Procedure: conjugate;
-  envmap.emplace("first", EnvResult(ProcedureType, firstElementList));
+  envmap.emplace(intern("first"), EnvResult(ProcedureType, firstElementList, Pure));
 
   // Procedure: conjugate;
-  envmap.emplace("rest", EnvResult(ProcedureType, restList));
+  envmap.emplace(intern("rest"), EnvResult(ProcedureType, restList, Pure));
 
   // Procedure: conjugate;
-  envmap.emplace("length", EnvResult(ProcedureType, lengthList));
+  envmap.emplace(intern("length"), EnvResult(ProcedureType, lengthList, Pure));
 
   // Procedure: conjugate;
-  envmap.emplace("append", EnvResult(ProcedureType, appendLists));
+  envmap.emplace(intern("append"), EnvResult(ProcedureType, appendLists, Pure));
 
   // Procedure: conjugate;
-  envmap.emplace("join", EnvResult(ProcedureType, joinLists));
+  envmap.emplace(intern("join"), EnvResult(ProcedureType, joinLists, Pure));
 
   // Procedure: conjugate;
-  envmap.emplace("range", EnvResult(ProcedureType, rangeLists));
+  envmap.emplace(intern("range"), EnvResult(ProcedureType, rangeLists, Pure));
 
 }
 
@@ -11,19 +11,39 @@ needed.
 #define ENVIRONMENT_HPP
 
 // system includes
-#include <map>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
 
 
 // module includes
 #include "atom.hpp"
 #include "expression.hpp"
 
+class Executor;
+class MemoCache;
+
 /*! \typedef Procedure
 \brief A Procedure is a C++ function pointer taking a vector of 
        Expressions as arguments and returning an Expression.
 */
 typedef Expression (*Procedure)(const std::vector<Expression> & args);
 
+/*! \struct NumericProcedure
+\brief The specialized entry points of a built-in procedure, for calls
+       whose arguments are all plain numbers.
+
+An entry is nullptr when the procedure has none for that number of
+arguments. An entry gives the value the Procedure would, as a double, and
+raises the same SemanticErrors.
+*/
+struct NumericProcedure {
+  double (*unary)(double x);
+  double (*binary)(double x, double y);
+};
+
 /*! \class Environment
 \brief A class representing the interpreter environment.
 
@@ -37,6 +57,20 @@ return you can obtain
 the mapped-to value using get_exp or get_proc.
 
 To add an symbol to expression mapping use the add_exp member function.
+
+A call frame, made by frame(), starts empty and resolves any symbol it does
+not bind itself in the environment it was made from. Definitions and
+deletions in a frame only affect the frame. The parameters of a lambda call
+are bound with add_parameter and can also be found by position with
+find_parameter. The call frame of a closure, made by closureFrame(), resolves
+the symbols it does not bind in the bindings the closure captured and then
+in the global environment.
+
+Capturing a call frame, by capture(), moves its bindings to the heap, where
+the frame and the closures made in it share them: a definition made in the
+frame after a closure was made is seen when the closure is called, so local
+procedures may call themselves and each other. A closure stored in the
+bindings it captured holds them in a cycle, see release().
  */
 class Environment {
 public:
@@ -65,9 +99,9 @@ public:
 
   /*! Add a mapping from sym argument to the exp argument within the environment.
     \param sym the symbol to add
-    \param exp the expression the symbol should map to
+    \param exp the expression the symbol should map to, moved into the environment
    */
-  void add_exp(const Atom &sym, const Expression &exp);
+  void add_exp(const Atom &sym, Expression exp);
 
   /*! delete a mapping from sym argument to the exp argument within the environment.
   \param sym the symbol to delete
@@ -89,6 +123,110 @@ public:
   */
   Procedure get_proc(const Atom &sym) const;
 
+  /*! Get the specialized entry points of the procedure sym maps to.
+    \param sym the symbol to lookup
+    \return the entry points, both nullptr if sym does not map to a
+    procedure that has them
+   */
+  NumericProcedure get_numeric(const Atom &sym) const;
+
+  /*! Call the procedure sym maps to through its specialized entry point,
+    when it has one for the arguments given.
+    \param sym the symbol naming the procedure
+    \param args the evaluated arguments, a span of nargs Expressions
+    \param nargs the number of arguments
+    \param result set to the value of the call
+    \return true if the call was made, false if it needs the Procedure
+   */
+  bool apply_numeric(const Atom &sym, const Expression * args, std::size_t nargs,
+                     Expression & result) const;
+
+  /*! Determine if a symbol maps to a pure built-in: a constant, or a
+    procedure whose result depends only on its arguments.
+    \param sym the symbol to lookup
+    \return true if sym is bound to a built-in marked pure and has not
+    been redefined
+   */
+  bool is_pure(const Atom &sym) const;
+
+  /*! Enable or disable the use of folded lambda bodies, on by default.
+    Only the global environment holds the setting, call frames use the
+    setting of the global environment they chain to.
+    \param enabled true to call lambdas through their folded bodies
+   */
+  void setConstantFolding(bool enabled);
+
+  /// return true if folded lambda bodies are enabled
+  bool constantFolding() const;
+
+  /*! Determine if a lambda called in this environment may use its folded
+    body: folding is enabled and no pure built-in has been redefined or
+    deleted in the global environment. Called on captured bindings,
+    determine if no pure built-in has been shadowed in them since they were
+    captured.
+   */
+  bool foldedBodies() const;
+
+  /*! Return the epoch of the global environment: a number that changes
+    whenever a symbol is defined or deleted there, and that no global
+    environment with other bindings has. Called on captured bindings,
+    return the latest epoch of them and the bindings they chain to, which
+    changes whenever a symbol is defined or deleted in any of them. Epochs
+    only grow.
+   */
+  std::uint64_t epoch() const;
+
+  /// return the memo cache of the global environment, shared by its copies
+  MemoCache & memoCache() const;
+
+  /*! Set the thread pool pmap and preduce run on in the global
+    environment, shared by its copies.
+    \param executor the pool, nullptr to evaluate them sequentially
+   */
+  void setExecutor(std::shared_ptr<Executor> executor);
+
+  /// return the thread pool of the global environment, or nullptr
+  Executor * executor() const;
+
+  /*! Make an empty call frame chained to this environment, which must
+    outlive it and not change while it is in use.
+    \return the frame
+   */
+  Environment frame() const;
+
+  /*! Bind the next parameter of a call frame.
+    \param sym the parameter's symbol
+    \param exp the argument, moved into the frame
+   */
+  void add_parameter(const Atom &sym, Expression exp);
+
+  /*! Find a parameter of this frame by position.
+    \param sym a Parameter Atom, resolved against the last parameter of its name
+    \return the value of the parameter, or nullptr if this frame does not
+    bind the parameter's symbol at its slot
+   */
+  const Expression * find_parameter(const Atom &sym) const;
+
+  /*! Make an empty call frame for a closure, chained to the global
+    environment at the end of this one's chain, which must outlive it.
+    \param captured the bindings the closure captured, or nullptr
+    \return the frame
+   */
+  Environment closureFrame(std::shared_ptr<const Environment> captured) const;
+
+  /*! Capture the bindings of the call frames this environment chains
+    through, shared with them so later definitions are seen.
+    \return the bindings, or nullptr for the global environment
+   */
+  std::shared_ptr<const Environment> capture() const;
+
+  /*! Drop a reference to captured bindings. A closure stored in the
+    bindings it captured holds them in a cycle, broken here if nothing else
+    holds the bindings or the closures stored in them.
+    \param captured the bindings, reset on return
+   */
+  static void release(std::shared_ptr<const Environment> & captured) noexcept;
+
   /*! Reset the environment to its default state. */
   void reset();
 
@@ -110,18 +248,99 @@ private:
     EnvResultType type;
     Expression exp; // used when type is ExpressionType
     Procedure proc; // used when type is ProcedureType
+    NumericProcedure numeric = {nullptr, nullptr}; // entry points of proc
+    bool pure = false; // a built-in constant folding may evaluate early
 
     // constructors for use in container emplace
     EnvResult(){};
-    EnvResult(EnvResultType t, Expression e) : type(t), exp(e){};
+    EnvResult(EnvResultType t, Expression e) : type(t), exp(std::move(e)){};
+    EnvResult(EnvResultType t, Expression e, bool isPure) : type(t), exp(std::move(e)), pure(isPure){};
     EnvResult(EnvResultType t, Procedure p) : type(t), proc(p){};
+    EnvResult(EnvResultType t, Procedure p, bool isPure) : type(t), proc(p), pure(isPure){};
+    EnvResult(EnvResultType t, Procedure p, bool isPure, NumericProcedure n) : type(t), proc(p), numeric(n), pure(isPure){};
   };
 
-  // the environment map
-  std::map<std::string, EnvResult> envmap;
+  // construct an empty frame chained to parent
+  explicit Environment(const Environment * parent);
+
+  // a parameter of a call frame; unbound once deleted, until added again
+  struct Parameter {
+    SymbolId name;
+    bool bound;
+    EnvResult value;
+  };
+
+  // return the parameter of this frame named id, or nullptr
+  Parameter * find_parameter(SymbolId id);
+  const Parameter * find_parameter(SymbolId id) const;
+
+  // return the binding of sym in this frame or its parents, or nullptr
+  const EnvResult * find(const Atom & sym) const;
+
+  // return the binding of id made in this environment itself, or nullptr
+  const EnvResult * find_binding(SymbolId id) const;
+
+  // return the environment holding the bindings of this one: itself, or the
+  // shared bindings capture() moved them to
+  Environment & bindings();
+  const Environment & bindings() const;
+
+  // a reference to captured bindings, released when dropped
+  struct SharedBindings {
+    std::shared_ptr<const Environment> bindings;
+
+    SharedBindings() = default;
+    SharedBindings(std::shared_ptr<const Environment> shared): bindings(std::move(shared)) {}
+    SharedBindings(const SharedBindings &) = default;
+    SharedBindings(SharedBindings &&) = default;
+    SharedBindings & operator=(SharedBindings other);
+    ~SharedBindings();
+
+    const Environment * get() const { return bindings.get(); }
+  };
+
+  // the parameters of a call frame in order
+  std::vector<Parameter> m_parameters;
+
+  // the environment map, keyed by interned symbol id
+  std::unordered_map<SymbolId, EnvResult> envmap;
+
+  // the environment unbound symbols resolve in, nullptr for the global one
+  const Environment * m_parent;
+
+  // the global environment at the end of a call frame's chain
+  const Environment * m_root;
+
+  // the bindings captured by the closure of a call frame, searched after
+  // the frame's own; in captured bindings, those they chain to
+  SharedBindings m_captured;
+
+  // the bindings of a call frame once captured, empty until then
+  SharedBindings m_shared;
+
+  // a bit for each symbol bound in this call frame or the frames it chains
+  // to, by id modulo 64; a symbol without its bit is found in m_root, so
+  // deep chains are not walked for global names. Captured bindings keep
+  // the bits of their own symbols only.
+  std::uint64_t m_chainMask;
+
+  // set by setConstantFolding, used in the global environment only
+  bool m_folding;
+
+  // the epoch, used in the global environment and captured bindings, and
+  // the memo cache, used in the global environment only
+  std::uint64_t m_epoch;
+  std::shared_ptr<MemoCache> m_memo;
+
+  // the thread pool, used in the global environment only
+  std::shared_ptr<Executor> m_executor;
+
+  // false once a pure built-in is redefined or deleted in the global
+  // environment, until reset, or shadowed in captured bindings
+  bool m_builtinsIntact;
 
   //bool to stop eval in expression
-  static bool interruptThrown;
+  static std::atomic<bool> interruptThrown;
 };
 
 #endif
@@ -1,9 +1,11 @@
 #include "catch.hpp"
 
+#include "closure.hpp"
 #include "environment.hpp"
 #include "semantic_error.hpp"
 #include <iostream>
 #include <cmath>
+#include <sstream>
 
 TEST_CASE( "Test default constructor", "[environment]" ) {
 
@@ -460,6 +462,81 @@ TEST_CASE("Test get built-in procedure", "[environment]") {
 	REQUIRE_THROWS_AS(prange(args), SemanticError);
 }
 
+TEST_CASE("Test arithmetic procedures broadcast over lists", "[environment]") {
+	Environment env;
+	Procedure padd = env.get_proc(Atom(std::string("+")));
+	Procedure pmul = env.get_proc(Atom(std::string("*")));
+	Procedure psub = env.get_proc(Atom(std::string("-")));
+	Procedure pdiv = env.get_proc(Atom(std::string("/")));
+	Procedure ppow = env.get_proc(Atom(std::string("^")));
+
+	Expression x(std::vector<double>({1, 2, 3, 4, 5}));
+	Expression y(std::vector<double>({2, 4, 8, 16, 32}));
+
+	INFO("list-list and list-scalar on packed lists")
+	REQUIRE(padd({x, y}) == Expression(std::vector<double>({3, 6, 11, 20, 37})));
+	REQUIRE(padd({Expression(1.0), x, y}) == Expression(std::vector<double>({4, 7, 12, 21, 38})));
+	REQUIRE(pmul({x, Expression(2.0)}) == Expression(std::vector<double>({2, 4, 6, 8, 10})));
+	REQUIRE(psub({y, x}) == Expression(std::vector<double>({1, 2, 5, 12, 27})));
+	REQUIRE(psub({x}) == Expression(std::vector<double>({-1, -2, -3, -4, -5})));
+	REQUIRE(pdiv({y, x}) == Expression(std::vector<double>({2, 2, 8.0 / 3, 4, 32.0 / 5})));
+	REQUIRE(pdiv({Expression(std::vector<double>({1, 2, 4}))}) == Expression(std::vector<double>({1, 0.5, 0.25})));
+	REQUIRE(ppow({x, Expression(2.0)}) == Expression(std::vector<double>({1, 4, 9, 16, 25})));
+	REQUIRE(ppow({Expression(2.0), x}) == Expression(std::vector<double>({2, 4, 8, 16, 32})));
+	REQUIRE(padd({x, y}).isPacked());
+
+	INFO("complex values fall back to element-wise calls")
+	std::complex<double> i(0, 1);
+	Expression sum = padd({x, Expression(i)});
+	REQUIRE(sum.getTailLength() == 5);
+	REQUIRE(sum.getValueInTail(0) == Expression(std::complex<double>(1, 1)));
+	Expression product = pmul({Expression(std::list<Expression>({Expression(1.0), Expression(i)})), Expression(2.0)});
+	REQUIRE(product.getValueInTail(1) == Expression(std::complex<double>(0, 2)));
+
+	INFO("errors")
+	REQUIRE_THROWS_AS(padd({x, Expression(std::vector<double>({1, 2}))}), SemanticError);
+	REQUIRE_THROWS_AS(padd({x, Expression(Atom(std::string("\"a\"")))}), SemanticError);
+	REQUIRE_THROWS_AS(psub({x, x, x}), SemanticError);
+	REQUIRE_THROWS_AS(ppow({x}), SemanticError);
+}
+
+TEST_CASE("Test transcendental procedures on lists", "[environment]") {
+	Environment env;
+	Procedure psin = env.get_proc(Atom(std::string("sin")));
+	Procedure pcos = env.get_proc(Atom(std::string("cos")));
+	Procedure ptan = env.get_proc(Atom(std::string("tan")));
+	Procedure pln = env.get_proc(Atom(std::string("ln")));
+	Procedure psqrt = env.get_proc(Atom(std::string("sqrt")));
+
+	std::vector<double> values = {0.25, 0.5, 1.0, 2.0, 4.0};
+	Expression x{std::vector<double>(values)};
+
+	INFO("list results match the scalar procedures element by element")
+	Procedure procedures[] = {psin, pcos, ptan, pln, psqrt};
+	for (Procedure p : procedures) {
+		Expression result = p({x});
+		REQUIRE(result.isPacked());
+		REQUIRE(result.getTailLength() == values.size());
+		for (std::size_t i = 0; i < values.size(); ++i) {
+			REQUIRE(result.getValueInTail(i) == p({Expression(values[i])}));
+		}
+	}
+
+	INFO("square roots of negative numbers are complex")
+	Expression roots = psqrt({Expression(std::vector<double>({4.0, -4.0}))});
+	REQUIRE(roots.getValueInTail(0) == Expression(2.0));
+	REQUIRE(roots.getValueInTail(1) == Expression(std::complex<double>(0.0, 2.0)));
+
+	INFO("large tangent arguments are reduced in constant time")
+	REQUIRE(ptan({Expression(1e9)}) == Expression(std::tan(1e9)));
+	REQUIRE(ptan({Expression(1e300)}) == Expression(std::tan(1e300)));
+
+	INFO("errors")
+	REQUIRE_THROWS_AS(pln({Expression(std::vector<double>({1.0, -1.0}))}), SemanticError);
+	REQUIRE_THROWS_AS(pln({Expression(std::vector<double>({1.0, std::nan("")}))}), SemanticError);
+	REQUIRE_THROWS_AS(psin({Expression(std::list<Expression>({Expression(Atom(std::string("\"a\"")))}))}), SemanticError);
+}
+
 TEST_CASE( "Test reset", "[environment]" ) {
   Environment env;
 
@@ -477,6 +554,205 @@ TEST_CASE( "Test reset", "[environment]" ) {
   REQUIRE(env.get_exp(Atom(std::string("hi"))) == Expression());
 }
 
+TEST_CASE( "Test call frames", "[environment]" ) {
+  Environment env;
+  Atom one(std::string("one"));
+  Atom two(std::string("two"));
+  Atom sin(std::string("sin"));
+  env.add_exp(one, Expression(1.0));
+
+  Environment frame = env.frame();
+  REQUIRE(frame.is_exp(one));
+  REQUIRE(frame.get_exp(one) == Expression(1.0));
+  REQUIRE(frame.is_proc(sin));
+  REQUIRE(frame.get_proc(sin) == env.get_proc(sin));
+
+  // bindings in the frame shadow the parent and are not seen by it
+  frame.add_exp(one, Expression(-1.0));
+  frame.add_exp(two, Expression(2.0));
+  frame.add_exp(sin, Expression(3.0));
+  REQUIRE(frame.get_exp(one) == Expression(-1.0));
+  REQUIRE(frame.is_exp(sin));
+  REQUIRE(!frame.is_proc(sin));
+  REQUIRE(env.get_exp(one) == Expression(1.0));
+  REQUIRE(!env.is_known(two));
+  REQUIRE(env.is_proc(sin));
+
+  // frames chain through their parents
+  Environment inner = frame.frame();
+  REQUIRE(inner.get_exp(two) == Expression(2.0));
+  REQUIRE(inner.is_exp(Atom(std::string("pi"))));
+
+  frame.delete_exp(one);
+  REQUIRE(frame.get_exp(one) == Expression(1.0));
+}
+
+TEST_CASE( "Test closure frames", "[environment]" ) {
+  Environment env;
+  Atom one(std::string("one"));
+  Atom two(std::string("two"));
+  env.add_exp(one, Expression(1.0));
+  REQUIRE(env.capture() == nullptr);
+
+  Environment frame = env.frame();
+  frame.add_parameter(two, Expression(2.0));
+  frame.add_exp(one, Expression(-1.0));
+  std::shared_ptr<const Environment> captured = frame.capture();
+  REQUIRE(captured != nullptr);
+
+  // a closure frame sees what was captured, then the global environment,
+  // but not the frame it was made from
+  Environment inner = frame.frame();
+  inner.add_exp(Atom(std::string("three")), Expression(3.0));
+  Environment closure = inner.closureFrame(captured);
+  REQUIRE(closure.get_exp(one) == Expression(-1.0));
+  REQUIRE(closure.get_exp(two) == Expression(2.0));
+  REQUIRE(!closure.is_known(Atom(std::string("three"))));
+  REQUIRE(closure.is_proc(Atom(std::string("sin"))));
+
+  // captured bindings are shared with the frame, later definitions are seen
+  frame.add_exp(two, Expression(-2.0));
+  frame.add_exp(Atom(std::string("four")), Expression(4.0));
+  REQUIRE(closure.get_exp(two) == Expression(-2.0));
+  REQUIRE(frame.capture() == captured);
+  REQUIRE(env.closureFrame(captured).get_exp(Atom(std::string("four"))) == Expression(4.0));
+  REQUIRE(frame.get_exp(two) == Expression(-2.0));
+
+  Environment global = env.closureFrame(nullptr);
+  REQUIRE(global.get_exp(one) == Expression(1.0));
+}
+
+TEST_CASE( "Test releasing captured bindings", "[environment]" ) {
+  Environment env;
+  Atom self(std::string("self"));
+  std::weak_ptr<const Environment> weak;
+  Expression escaped;
+
+  // a closure stored in the bindings it captured does not keep them alive
+  // once its frame ends
+  {
+    Environment frame = env.frame();
+    std::shared_ptr<const Environment> captured = frame.capture();
+    weak = captured;
+    Expression lambda(Atom::fromClosure(std::make_shared<const Closure>(Expression(), Expression(), captured)));
+    captured.reset();
+    frame.add_exp(self, lambda);
+  }
+  REQUIRE(weak.expired());
+
+  // unless it is held elsewhere, until it is dropped there
+  {
+    Environment frame = env.frame();
+    std::shared_ptr<const Environment> captured = frame.capture();
+    weak = captured;
+    escaped = Expression(Atom::fromClosure(std::make_shared<const Closure>(Expression(), Expression(), captured)));
+    captured.reset();
+    frame.add_exp(self, escaped);
+  }
+  REQUIRE(!weak.expired());
+  REQUIRE(env.closureFrame(weak.lock()).get_exp(self) == escaped);
+  escaped = Expression();
+  REQUIRE(weak.expired());
+}
+
+TEST_CASE( "Test specialized procedure entries", "[environment]" ) {
+  Environment env;
+  const double values[] = {-2.5, -1, -0.0, 0, 0.5, 3};
+
+  // each entry gives what the procedure gives
+  for (const char * name : {"+", "-", "*", "/", "^", "ln", "sin", "cos", "tan", "sqrt"}) {
+    Atom symbol{std::string(name)};
+    Procedure proc = env.get_proc(symbol);
+    for (double x : values) {
+      for (double y : values) {
+	for (std::size_t nargs = 1; nargs <= 2; ++nargs) {
+	  INFO(name << " " << x << " " << y << " " << nargs);
+	  std::vector<Expression> args = {Expression(x), Expression(y)};
+	  args.resize(nargs);
+
+	  std::string expected;
+	  try {
+	    std::ostringstream out;
+	    out << proc(args);
+	    expected = out.str();
+	  }
+	  catch (const SemanticError & ex) {
+	    expected = ex.what();
+	  }
+
+	  std::string actual;
+	  try {
+	    Expression result;
+	    if (!env.apply_numeric(symbol, args.data(), nargs, result)) {
+	      continue;
+	    }
+	    std::ostringstream out;
+	    out << result;
+	    actual = out.str();
+	  }
+	  catch (const SemanticError & ex) {
+	    actual = ex.what();
+	  }
+	  REQUIRE(actual == expected);
+	}
+      }
+    }
+  }
+
+  Atom add(std::string("+"));
+  REQUIRE(env.get_numeric(add).binary != nullptr);
+  REQUIRE(env.get_numeric(Atom(std::string("sin"))).binary == nullptr);
+  REQUIRE(env.get_numeric(Atom(std::string("list"))).unary == nullptr);
+
+  // the generic procedure is needed for other arguments
+  Expression result;
+  std::vector<Expression> args = {Expression(1.0), Expression(std::complex<double>(0, 1)), Expression(1.0)};
+  REQUIRE(!env.apply_numeric(add, args.data(), 2, result));
+  REQUIRE(!env.apply_numeric(add, args.data(), 0, result));
+  args[1] = Expression(2.0);
+  REQUIRE(!env.apply_numeric(add, args.data(), 3, result));
+  REQUIRE(env.apply_numeric(add, args.data(), 2, result));
+  REQUIRE(result == Expression(3.0));
+
+  // a name bound in a frame shadows the builtin
+  Environment frame = env.frame();
+  frame.add_exp(add, Expression(1.0));
+  REQUIRE(frame.get_numeric(add).unary == nullptr);
+  REQUIRE(!frame.apply_numeric(add, args.data(), 2, result));
+}
+
+TEST_CASE( "Test pure built-ins", "[environment]" ) {
+
+  Environment env;
+
+  for (auto name : {"pi", "e", "I", "+", "*", "sqrt", "sin", "range", "list"}) {
+    INFO(name);
+    REQUIRE(env.is_pure(Atom(std::string(name))));
+  }
+  REQUIRE(!env.is_pure(Atom(std::string("undefined"))));
+  REQUIRE(env.foldedBodies());
+
+  // a definition is not pure, and a call frame's does not affect folding
+  Environment frame = env.frame();
+  frame.add_exp(Atom(std::string("pi")), Expression(3.));
+  REQUIRE(!frame.is_pure(Atom(std::string("pi"))));
+  REQUIRE(frame.foldedBodies());
+
+  // redefining a built-in in the global environment stops folding until reset
+  env.add_exp(Atom(std::string("x")), Expression(1.));
+  REQUIRE(env.foldedBodies());
+  env.add_exp(Atom(std::string("sin")), Expression(1.));
+  REQUIRE(!env.is_pure(Atom(std::string("sin"))));
+  REQUIRE(!env.foldedBodies());
+  env.reset();
+  REQUIRE(env.foldedBodies());
+
+  env.setConstantFolding(false);
+  REQUIRE(!env.constantFolding());
+  REQUIRE(!env.foldedBodies());
+  REQUIRE(!env.frame().foldedBodies());
+}
+
 TEST_CASE( "Test semeantic errors", "[environment]" ) {
 
   Environment env;
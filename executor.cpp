@@ -0,0 +1,186 @@
+#include "executor.hpp"
+
+#include <cstdlib>
+#include <string>
+
+// the size set by setDefaultSize, 0 if unset
+static std::atomic<std::size_t> defaultSizeSet(0);
+
+// the executor and queue of the calling worker thread, if it is one
+static thread_local const Executor * currentExecutor = nullptr;
+static thread_local std::size_t currentQueue = 0;
+
+std::size_t Executor::defaultSize(){
+  std::size_t size = defaultSizeSet.load();
+  if(size > 0){
+    return size;
+  }
+
+  const char * variable = std::getenv("PLOTSCRIPT_THREADS");
+  if(variable != nullptr){
+    try{
+      long threads = std::stol(variable);
+      if(threads > 0){
+	return static_cast<std::size_t>(threads);
+      }
+    }
+    catch(const std::exception &){
+      // an invalid value is ignored
+    }
+  }
+
+  unsigned hardware = std::thread::hardware_concurrency();
+  return (hardware > 0) ? hardware : 1;
+}
+
+void Executor::setDefaultSize(std::size_t size) noexcept{
+  defaultSizeSet = size;
+}
+
+Executor::Executor(std::size_t size):
+  m_size(size > 0 ? size : 1), m_queued(0), m_stopping(false){
+
+  // a queue for each worker thread and one for the threads outside the pool
+  for(std::size_t i = 0; i < m_size; ++i){
+    m_queues.emplace_back(new Queue);
+  }
+}
+
+Executor::~Executor(){
+  {
+    std::lock_guard<std::mutex> lock(m_sleepMutex);
+    m_stopping = true;
+  }
+  m_wake.notify_all();
+  for(std::thread & thread : m_threads){
+    thread.join();
+  }
+}
+
+std::size_t Executor::size() const noexcept{
+  return m_size;
+}
+
+void Executor::start(){
+  std::call_once(m_started, [this](){
+    for(std::size_t i = 0; i + 1 < m_size; ++i){
+      m_threads.emplace_back(&Executor::work, this, i);
+    }
+  });
+}
+
+std::size_t Executor::home() const noexcept{
+  return (currentExecutor == this) ? currentQueue : m_queues.size() - 1;
+}
+
+void Executor::run(std::size_t count, const std::function<void(std::size_t)> & task){
+
+  // nothing to share, the tasks run in order on this thread
+  if(m_size == 1 || count <= 1){
+    for(std::size_t i = 0; i < count; ++i){
+      task(i);
+    }
+    return;
+  }
+  start();
+
+  Job job;
+  job.task = &task;
+  job.remaining = count;
+  job.errors.resize(count);
+
+  // the work is dealt over the queues, starting with this thread's own
+  std::size_t queue = home();
+  {
+    std::lock_guard<std::mutex> lock(m_sleepMutex);
+    m_queued += count;
+  }
+  for(std::size_t i = 0; i < count; ++i){
+    Queue & target = *m_queues[(queue + i) % m_queues.size()];
+    std::lock_guard<std::mutex> lock(target.mutex);
+    target.work.push_back(Work{&job, i});
+  }
+  m_wake.notify_all();
+
+  // work on the job, or any other, until every task of the job finished
+  while(true){
+    {
+      std::unique_lock<std::mutex> lock(job.mutex);
+      if(job.remaining == 0){
+	break;
+      }
+    }
+    Work work;
+    if(take(queue, work)){
+      execute(work);
+      continue;
+    }
+    // the rest of the job is running on other threads
+    std::unique_lock<std::mutex> lock(job.mutex);
+    job.done.wait(lock, [&job](){ return job.remaining == 0; });
+  }
+
+  for(std::exception_ptr & error : job.errors){
+    if(error){
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+bool Executor::take(std::size_t home, Work & work){
+  {
+    Queue & own = *m_queues[home];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if(!own.work.empty()){
+      work = own.work.back();
+      own.work.pop_back();
+      --m_queued;
+      return true;
+    }
+  }
+  for(std::size_t i = 1; i < m_queues.size(); ++i){
+    Queue & other = *m_queues[(home + i) % m_queues.size()];
+    std::lock_guard<std::mutex> lock(other.mutex);
+    if(!other.work.empty()){
+      work = other.work.front();
+      other.work.pop_front();
+      --m_queued;
+      return true;
+    }
+  }
+  return false;
+}
+
+void Executor::execute(const Work & work){
+  Job & job = *work.job;
+  try{
+    (*job.task)(work.index);
+  }
+  catch(...){
+    job.errors[work.index] = std::current_exception();
+  }
+
+  // the job may end as soon as the mutex is released
+  std::lock_guard<std::mutex> lock(job.mutex);
+  if(--job.remaining == 0){
+    job.done.notify_all();
+  }
+}
+
+void Executor::work(std::size_t index){
+  currentExecutor = this;
+  currentQueue = index;
+
+  while(true){
+    Work work;
+    if(take(index, work)){
+      execute(work);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(m_sleepMutex);
+    m_wake.wait(lock, [this](){ return m_stopping || m_queued > 0; });
+    if(m_stopping && m_queued == 0){
+      return;
+    }
+  }
+}
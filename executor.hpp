@@ -0,0 +1,117 @@
+/*! \file executor.hpp
+Defines the work-stealing thread pool that evaluates pmap and preduce.
+
+Each worker thread has a queue of work. A thread takes new work from the
+back of its own queue and, when that is empty, steals from the front of the
+others', so chunks of uneven cost spread over the threads. The thread that
+starts a job works on it too rather than blocking, so a job started by a
+worker, as by a pmap nested in a pmap, cannot deadlock the pool.
+ */
+#ifndef EXECUTOR_HPP
+#define EXECUTOR_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*! \class Executor
+\brief A work-stealing thread pool.
+
+The worker threads are started by the first job that needs them and are
+joined when the Executor is destroyed.
+*/
+class Executor {
+public:
+
+  /*! Return the size of a new Executor: the size set by setDefaultSize, or
+    else the value of the PLOTSCRIPT_THREADS environment variable, or else
+    the number of hardware threads.
+  */
+  static std::size_t defaultSize();
+
+  /// set the size of new Executors, 0 to use PLOTSCRIPT_THREADS again
+  static void setDefaultSize(std::size_t size) noexcept;
+
+  /*! Construct an Executor.
+    \param size the most threads working at once, the thread starting a
+    job included; 0 is taken as 1
+  */
+  explicit Executor(std::size_t size = defaultSize());
+
+  /// stop and join the worker threads
+  ~Executor();
+
+  Executor(const Executor &) = delete;
+  Executor & operator=(const Executor &) = delete;
+
+  /// return the most threads working at once
+  std::size_t size() const noexcept;
+
+  /*! Run task(0) to task(count - 1), in parallel, returning once all have
+    finished.
+    \param count the number of tasks
+    \param task the task, called once for each index, from any thread
+    \throws the exception of the lowest index whose task threw
+  */
+  void run(std::size_t count, const std::function<void(std::size_t)> & task);
+
+private:
+
+  // a job started by run, on the stack of the thread running it
+  struct Job {
+    const std::function<void(std::size_t)> * task;
+    std::size_t remaining;
+    std::vector<std::exception_ptr> errors;
+    std::mutex mutex;
+    std::condition_variable done;
+  };
+
+  // one task of a job
+  struct Work {
+    Job * job;
+    std::size_t index;
+  };
+
+  // a worker's queue, the last one is shared by threads outside the pool
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Work> work;
+  };
+
+  // start the worker threads, once
+  void start();
+
+  // the loop of worker thread index
+  void work(std::size_t index);
+
+  // take work from queue home, or steal it from another queue
+  bool take(std::size_t home, Work & work);
+
+  // run one task, recording its exception and completion
+  static void execute(const Work & work);
+
+  // the queue of the calling thread
+  std::size_t home() const noexcept;
+
+  std::size_t m_size;
+
+  std::vector<std::unique_ptr<Queue> > m_queues;
+  std::vector<std::thread> m_threads;
+  std::once_flag m_started;
+
+  // work queued and not yet taken, and the signal to stop, guarded by
+  // m_sleepMutex when a worker may be waiting for them
+  std::atomic<std::size_t> m_queued;
+  bool m_stopping;
+  std::mutex m_sleepMutex;
+  std::condition_variable m_wake;
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include "catch.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "executor.hpp"
+
+TEST_CASE( "Test executor runs every task once", "[executor]" ) {
+
+  for (std::size_t size : {1, 2, 4}) {
+    INFO(size);
+    Executor executor(size);
+    REQUIRE(executor.size() == size);
+
+    for (std::size_t count : {0, 1, 7, 1000}) {
+      std::vector<std::atomic<int> > runs(count);
+      for (auto & run : runs) {
+        run = 0;
+      }
+      executor.run(count, [&](std::size_t i) { ++runs[i]; });
+      for (auto & run : runs) {
+        REQUIRE(run == 1);
+      }
+    }
+  }
+
+  REQUIRE(Executor(0).size() == 1);
+}
+
+TEST_CASE( "Test executor on one thread runs tasks in order", "[executor]" ) {
+
+  Executor executor(1);
+  std::thread::id caller = std::this_thread::get_id();
+  std::vector<std::size_t> order;
+  executor.run(5, [&](std::size_t i) {
+    REQUIRE(std::this_thread::get_id() == caller);
+    order.push_back(i);
+  });
+  REQUIRE(order == std::vector<std::size_t>({0, 1, 2, 3, 4}));
+}
+
+TEST_CASE( "Test executor raises the error of the lowest task", "[executor]" ) {
+
+  Executor executor(4);
+  std::atomic<int> runs(0);
+  try {
+    executor.run(100, [&](std::size_t i) {
+      ++runs;
+      if (i % 10 == 3) {
+        throw std::runtime_error(std::to_string(i));
+      }
+    });
+    FAIL("no error raised");
+  }
+  catch (const std::runtime_error & error) {
+    REQUIRE(std::string(error.what()) == "3");
+  }
+  // the other tasks still ran
+  REQUIRE(runs == 100);
+}
+
+TEST_CASE( "Test executor runs nested jobs", "[executor]" ) {
+
+  Executor executor(3);
+  std::atomic<int> total(0);
+  executor.run(8, [&](std::size_t i) {
+    executor.run(8, [&](std::size_t j) { total += static_cast<int>(i * 8 + j); });
+  });
+  REQUIRE(total == 63 * 64 / 2);
+}
+
+TEST_CASE( "Test executor default size", "[executor]" ) {
+
+  Executor::setDefaultSize(3);
+  REQUIRE(Executor::defaultSize() == 3);
+  REQUIRE(Executor().size() == 3);
+
+  Executor::setDefaultSize(0);
+  setenv("PLOTSCRIPT_THREADS", "5", 1);
+  REQUIRE(Executor::defaultSize() == 5);
+
+  // an invalid value is ignored
+  setenv("PLOTSCRIPT_THREADS", "none", 1);
+  REQUIRE(Executor::defaultSize() >= 1);
+  unsetenv("PLOTSCRIPT_THREADS");
+  REQUIRE(Executor::defaultSize() >= 1);
+}
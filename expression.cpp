@@ -1,13 +1,39 @@
 #include "expression.hpp"
 
 #include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <exception>
 #include <iomanip>
 #include <list>
 #include <iostream>
+#include <unordered_map>
 
+#include "adaptive_sampling.hpp"
+#include "closure.hpp"
 #include "environment.hpp"
+#include "executor.hpp"
+#include "memoization.hpp"
+#include "plot_buffer.hpp"
+#include "plot_primitives.hpp"
 #include "semantic_error.hpp"
 
+std::atomic<std::size_t> Expression::nodeCopies(0);
+
+// true if every element can be stored in a packed List
+template <typename Container>
+static bool packable(const Container & elements) noexcept {
+	for (auto & e : elements) {
+		if (!e.isPlainNumber()) {
+			return false;
+		}
+	}
+	return true;
+}
+
 Expression::Expression(){
 
 }
@@ -19,44 +45,163 @@ Expression::Expression(const Atom & a){
 
 Expression::Expression(const std::list<Expression> & a) {
 	m_head = true;
+	if (a.empty()) {
+		return;
+	}
+	if (packable(a)) {
+		std::vector<double> & values = m_packed.write();
+		values.reserve(a.size());
+		for (auto & args : a) {
+			values.push_back(args.m_head.asNumber());
+		}
+		return;
+	}
+	std::vector<Expression> & tail = m_tail.write();
+	tail.reserve(a.size());
 	for (auto & args : a) {
-		m_tail.push_back(args);
+		tail.push_back(args);
 	}
 	
 }
 
-Expression::Expression(const std::vector<Expression> & a) {
-	m_head = std::string("lambda");
+Expression::Expression(std::list<Expression> && a) {
+	m_head = true;
+	if (a.empty()) {
+		return;
+	}
+	if (packable(a)) {
+		std::vector<double> & values = m_packed.write();
+		values.reserve(a.size());
+		for (auto & args : a) {
+			values.push_back(args.m_head.asNumber());
+		}
+		a.clear();
+		return;
+	}
+	std::vector<Expression> & tail = m_tail.write();
+	tail.reserve(a.size());
 	for (auto & args : a) {
-		m_tail.push_back(args);
+		tail.push_back(std::move(args));
 	}
+	a.clear();
+}
+
+Expression::Expression(std::vector<double> && values) {
+	m_head = true;
+	if (!values.empty()) {
+		m_packed.write() = std::move(values);
+	}
+}
+
+Expression::Expression(std::shared_ptr<const PlotPrimitives> items) {
+	m_head = true;
+	if (items && items->size() > 0) {
+		m_primitives = std::move(items);
+	}
+}
+
+// the head of a lambda value with the given tail
+static Atom lambdaHead(const std::vector<Expression> & a) {
+	if (a.size() != 2) {
+		return Atom(std::string("lambda"));
+	}
+	return Atom::fromClosure(std::make_shared<const Closure>(a[0], a[1], nullptr));
+}
 
+Expression::Expression(const std::vector<Expression> & a) {
+	m_head = lambdaHead(a);
+	m_tail.write() = a;
+}
+
+Expression::Expression(std::vector<Expression> && a) {
+	m_head = lambdaHead(a);
+	m_tail.write() = std::move(a);
 }
 
-// recursive copy
-Expression::Expression(const Expression & a){
-  m_head = a.m_head;
-  for(auto e : a.m_tail){
-    m_tail.push_back(e);
+Expression::Expression(const Atom & head, std::vector<Expression> && tail): m_head(head) {
+  if(!tail.empty()){
+    m_tail.write() = std::move(tail);
   }
-  propertymap = a.propertymap;
+}
+
+// shallow copy, the tail and properties are shared until written
+Expression::Expression(const Expression & a):
+  m_head(a.m_head), m_tail(a.m_tail), propertymap(a.propertymap),
+  m_packed(a.m_packed), m_primitives(a.m_primitives){
+#ifndef NDEBUG
+  nodeCopies.fetch_add(1, std::memory_order_relaxed);
+#endif
 }
 
 Expression & Expression::operator=(const Expression & a){
   // prevent self-assignment
   if(this != &a){
+#ifndef NDEBUG
+    nodeCopies.fetch_add(1, std::memory_order_relaxed);
+#endif
     m_head = a.m_head;
-    m_tail.clear();
-    for(auto e : a.m_tail){
-      m_tail.push_back(e);
-    } 
-	propertymap.clear();
-	propertymap = a.propertymap;
+    m_tail = a.m_tail;
+    propertymap = a.propertymap;
+    m_packed = a.m_packed;
+    m_primitives = a.m_primitives;
   }
   
   return *this;
 }
 
+Expression::Expression(Expression && a) noexcept:
+  m_head(std::move(a.m_head)), m_tail(std::move(a.m_tail)),
+  propertymap(std::move(a.propertymap)), m_packed(std::move(a.m_packed)),
+  m_primitives(std::move(a.m_primitives)){
+}
+
+Expression & Expression::operator=(Expression && a) noexcept{
+  if(this != &a){
+    m_head = std::move(a.m_head);
+    m_tail = std::move(a.m_tail);
+    propertymap = std::move(a.propertymap);
+    m_packed = std::move(a.m_packed);
+    m_primitives = std::move(a.m_primitives);
+  }
+  return *this;
+}
+
+Expression::~Expression(){
+
+  // only a tail owned here with owned tails below it can nest deeply
+  if(!m_tail.unique()){
+    return;
+  }
+  bool nested = false;
+  for(auto & e : m_tail.get()){
+    nested = nested || e.m_tail.unique();
+  }
+  if(!nested){
+    return;
+  }
+
+  // flatten the tree, each node is then destroyed with an empty tail
+  std::vector<Expression> pending = m_tail.take();
+  while(!pending.empty()){
+    Expression node = std::move(pending.back());
+    pending.pop_back();
+    if(node.m_tail.unique()){
+      for(auto & child : node.m_tail.write()){
+	pending.push_back(std::move(child));
+      }
+      node.m_tail.clear();
+    }
+  }
+}
+
+std::size_t Expression::copyCount() noexcept{
+  return nodeCopies.load(std::memory_order_relaxed);
+}
+
+void Expression::resetCopyCount() noexcept{
+  nodeCopies.store(0, std::memory_order_relaxed);
+}
+
 Atom & Expression::head(){
   return m_head;
 }
@@ -89,26 +234,215 @@ bool Expression::isHeadString() const noexcept {
 	return m_head.isString();
 }
 
+bool Expression::isPlainNumber() const noexcept {
+	return m_head.isNumber() && m_tail.empty() && m_packed.empty() && propertymap.empty();
+}
+
+bool Expression::isPacked() const noexcept {
+	return !m_packed.empty();
+}
+
+const std::vector<double> & Expression::packedValues() const noexcept {
+	return m_packed.get();
+}
+
+const PlotPrimitives * Expression::plotPrimitives() const noexcept {
+	return m_primitives.get();
+}
+
+const std::vector<Expression> & Expression::boxedTail() const {
+	if (!m_primitives) {
+		return m_tail.get();
+	}
+	const PlotPrimitives & items = *m_primitives;
+	std::call_once(items.m_expanded, [&items]() { items.m_expressions = expandPlot(items); });
+	return items.m_expressions;
+}
+
+bool Expression::sameTail(const Expression & exp) const noexcept {
+	return m_tail.sameStorage(exp.m_tail) && m_packed.sameStorage(exp.m_packed)
+		&& m_primitives == exp.m_primitives;
+}
+
+std::vector<Expression> Expression::takeElements() {
+	if (m_primitives) {
+		std::vector<Expression> elements(boxedTail());
+		m_primitives.reset();
+		return elements;
+	}
+	if (m_packed.empty()) {
+		return m_tail.take();
+	}
+	std::vector<Expression> elements;
+	elements.reserve(m_packed.size());
+	for (double value : m_packed) {
+		elements.emplace_back(Atom(value));
+	}
+	m_packed.clear();
+	return elements;
+}
+
+void Expression::unpack() {
+	if (!m_packed.empty() || m_primitives) {
+		std::vector<Expression> elements = takeElements();
+		m_tail.write() = std::move(elements);
+	}
+}
+
 void Expression::append(const Atom & a){
-  m_tail.emplace_back(a);
+  if(m_primitives){
+    unpack();
+  }
+  if(!m_packed.empty()){
+    if(a.isNumber()){
+      m_packed.write().push_back(a.asNumber());
+      return;
+    }
+    unpack();
+  }
+  m_tail.write().emplace_back(a);
+}
+
+void Expression::append(Atom && a){
+  if(m_primitives){
+    unpack();
+  }
+  if(!m_packed.empty()){
+    if(a.isNumber()){
+      m_packed.write().push_back(a.asNumber());
+      return;
+    }
+    unpack();
+  }
+  m_tail.write().emplace_back(std::move(a));
 }
 
 Expression * Expression::tail(){
   Expression * ptr = nullptr;
+  unpack();
   
   if(m_tail.size() > 0){
-    ptr = &m_tail.back();
+    ptr = &m_tail.write().back();
   }
 
   return ptr;
 }
 
-Expression::ConstIteratorType Expression::tailConstBegin() const noexcept{
-  return m_tail.cbegin();
+Expression::ConstIteratorType Expression::tailConstBegin() const{
+  if(!m_packed.empty()){
+    return ConstIteratorType(m_packed.get().data());
+  }
+  return ConstIteratorType(boxedTail().data());
+}
+
+Expression::ConstIteratorType Expression::tailConstEnd() const{
+  if(!m_packed.empty()){
+    return ConstIteratorType(m_packed.get().data() + m_packed.size());
+  }
+  const std::vector<Expression> & tail = boxedTail();
+  return ConstIteratorType(tail.data() + tail.size());
+}
+
+Expression::ConstIteratorType::ConstIteratorType() noexcept:
+  m_boxed(nullptr), m_packed(nullptr){
+}
+
+Expression::ConstIteratorType::ConstIteratorType(const Expression * boxed) noexcept:
+  m_boxed(boxed), m_packed(nullptr){
+}
+
+Expression::ConstIteratorType::ConstIteratorType(const double * packed) noexcept:
+  m_boxed(nullptr), m_packed(packed){
+}
+
+// the materialized element is not copied, it is rebuilt on dereference
+Expression::ConstIteratorType::ConstIteratorType(const ConstIteratorType & other) noexcept:
+  m_boxed(other.m_boxed), m_packed(other.m_packed){
+}
+
+Expression::ConstIteratorType & Expression::ConstIteratorType::operator=(const ConstIteratorType & other) noexcept{
+  m_boxed = other.m_boxed;
+  m_packed = other.m_packed;
+  return *this;
+}
+
+const Expression & Expression::ConstIteratorType::operator*() const{
+  if(m_packed){
+    m_value.m_head = Atom(*m_packed);
+    return m_value;
+  }
+  return *m_boxed;
+}
+
+const Expression * Expression::ConstIteratorType::operator->() const{
+  return &(**this);
+}
+
+Expression Expression::ConstIteratorType::operator[](difference_type n) const{
+  return *(*this + n);
+}
+
+Expression::ConstIteratorType & Expression::ConstIteratorType::operator++() noexcept{
+  return *this += 1;
+}
+
+Expression::ConstIteratorType Expression::ConstIteratorType::operator++(int) noexcept{
+  ConstIteratorType result(*this);
+  *this += 1;
+  return result;
+}
+
+Expression::ConstIteratorType & Expression::ConstIteratorType::operator--() noexcept{
+  return *this -= 1;
+}
+
+Expression::ConstIteratorType Expression::ConstIteratorType::operator--(int) noexcept{
+  ConstIteratorType result(*this);
+  *this -= 1;
+  return result;
+}
+
+Expression::ConstIteratorType & Expression::ConstIteratorType::operator+=(difference_type n) noexcept{
+  if(m_packed){
+    m_packed += n;
+  }
+  else{
+    m_boxed += n;
+  }
+  return *this;
+}
+
+Expression::ConstIteratorType & Expression::ConstIteratorType::operator-=(difference_type n) noexcept{
+  return *this += -n;
+}
+
+Expression::ConstIteratorType Expression::ConstIteratorType::operator+(difference_type n) const noexcept{
+  ConstIteratorType result(*this);
+  return result += n;
+}
+
+Expression::ConstIteratorType Expression::ConstIteratorType::operator-(difference_type n) const noexcept{
+  ConstIteratorType result(*this);
+  return result -= n;
+}
+
+Expression::ConstIteratorType::difference_type Expression::ConstIteratorType::operator-(const ConstIteratorType & other) const noexcept{
+  if(m_packed){
+    return m_packed - other.m_packed;
+  }
+  return m_boxed - other.m_boxed;
+}
+
+bool Expression::ConstIteratorType::operator==(const ConstIteratorType & other) const noexcept{
+  return (m_boxed == other.m_boxed) && (m_packed == other.m_packed);
 }
 
-Expression::ConstIteratorType Expression::tailConstEnd() const noexcept{
-  return m_tail.cend();
+bool Expression::ConstIteratorType::operator!=(const ConstIteratorType & other) const noexcept{
+  return !(*this == other);
+}
+
+bool Expression::ConstIteratorType::operator<(const ConstIteratorType & other) const noexcept{
+  return (*this - other) < 0;
 }
 
 Expression apply(const Atom & op, const std::vector<Expression> & args, const Environment & env){
@@ -131,7 +465,14 @@ Expression apply(const Atom & op, const std::vector<Expression> & args, const En
   return proc(args);
 }
 
-Expression Expression::handle_lookup(const Atom & head, const Environment & env){
+Expression Expression::handle_lookup(const Atom & head, const Environment & env) const {
+    if(head.isParameter()){ // a parameter is found by slot, or else by name
+      const Expression * value = env.find_parameter(head);
+      if(value != nullptr){
+	return *value;
+      }
+      return handle_lookup(Atom::fromSymbolId(head.asParameterSymbol()), env);
+    }
     if(head.isSymbol()){ // if symbol is in env return value
       if(env.is_exp(head)){
 	return env.get_exp(head);
@@ -154,7 +495,7 @@ Expression Expression::handle_lookup(const Atom & head, const Environment & env)
     }
 }
 
-Expression Expression::handle_begin(Environment & env){
+Expression Expression::handle_begin(Environment & env) const {
   
   if(m_tail.size() == 0){
     throw SemanticError("Error during evaluation: zero arguments to begin");
@@ -162,14 +503,14 @@ Expression Expression::handle_begin(Environment & env){
 
   // evaluate each arg from tail, return the last
   Expression result;
-  for(Expression::IteratorType it = m_tail.begin(); it != m_tail.end(); ++it){
+  for(auto it = m_tail.begin(); it != m_tail.end(); ++it){
     result = it->eval(env);
   }
   
   return result;
 }
 
-Expression Expression::handle_define(Environment & env){
+Expression Expression::handle_define(Environment & env) const {
 
   // tail must have size 3 or error
   if(m_tail.size() != 2){
@@ -182,8 +523,8 @@ Expression Expression::handle_define(Environment & env){
   }
 
   // but tail[0] must not be a special-form or procedure
-  std::string s = m_tail[0].head().asSymbol();
-  if((s == "define") || (s == "begin") || (s == "lambda") || (s == "map") || (s == "apply")){
+  SymbolId s = m_tail[0].head().asSymbolId();
+  if((s == DefineSymbol) || (s == BeginSymbol) || (s == LambdaSymbol) || (s == MapSymbol) || (s == ApplySymbol)){
     throw SemanticError("Error during evaluation: attempt to redefine a special-form");
   }
   
@@ -195,15 +536,14 @@ Expression Expression::handle_define(Environment & env){
   }
 
   
-  Expression result;
-	  result = m_tail[1].eval(env);
+  Expression result = m_tail[1].eval(env);
   //and add to env
   env.add_exp(m_tail[0].head(), result);
   
   return result;
 }
 
-Expression Expression::handle_lambda(Environment & env) {
+Expression Expression::handle_lambda(Environment & env) const {
 
 	// tail must have size 2 or error
 	if (m_tail.size() != 2) {
@@ -216,8 +556,8 @@ Expression Expression::handle_lambda(Environment & env) {
 	}
 
 	// but tail[0] must not be a special-form or procedure
-	std::string s = m_tail[0].head().asSymbol();
-	if ((s == "define") || (s == "begin")) {
+	SymbolId s = m_tail[0].head().asSymbolId();
+	if ((s == DefineSymbol) || (s == BeginSymbol)) {
 		throw SemanticError("Error during evaluation: attempt to redefine a special-form");
 	}
 
@@ -227,27 +567,91 @@ Expression Expression::handle_lambda(Environment & env) {
 	if (env.is_exp(m_head)) {
 		throw SemanticError("Error during evaluation: attempt to redefine a previously defined symbol");
 	}
-	Expression result;
+	return makeLambda(m_tail[0], m_tail[1]).closedOver(env);
+}
+
+Expression Expression::makeLambda(const Expression & parameters, const Expression & body) {
 	std::vector<Expression> lambdaVector;
 	std::list<Expression> variableList;
+	std::unordered_map<SymbolId, std::uint32_t> slots;
 
 	//store variables in one expression in first argument
-	variableList.push_back(m_tail[0].head());
-	for (auto e =m_tail[0].tailConstBegin(); e != m_tail[0].tailConstEnd(); ++e) {
+	variableList.push_back(parameters.head());
+	slots[parameters.head().asSymbolId()] = 0;
+	for (auto e = parameters.tailConstBegin(); e != parameters.tailConstEnd(); ++e) {
+		slots[e->head().asSymbolId()] = static_cast<std::uint32_t>(variableList.size());
 		variableList.push_back(Expression(*e));
 	}
-	Expression variables = variableList;
-	lambdaVector.push_back(variables);
+	slots.erase(NoSymbol);
+	lambdaVector.reserve(2);
+	lambdaVector.emplace_back(std::move(variableList));
 
-	//store equation in one expression in second argument
-	lambdaVector.push_back(m_tail[1]);
-	result = lambdaVector;
+	//store equation in one expression in second argument, its parameters resolved
+	lambdaVector.push_back(body);
+	resolveParameters(lambdaVector.back(), slots);
 
+	return Expression(std::move(lambdaVector));
+}
 
-	return result;
+Expression Expression::closedOver(const Environment & env) const {
+	std::shared_ptr<const Environment> captured = env.capture();
+	if (!captured || m_tail.size() != 2) {
+		return *this;
+	}
+	Expression lambda(*this);
+	lambda.m_head = Atom::fromClosure(std::make_shared<const Closure>(m_tail[0], m_tail[1], std::move(captured)));
+	return lambda;
 }
 
-Expression Expression::handle_apply(Environment & env) {
+bool Expression::resolveParameters(Expression & node, const std::unordered_map<SymbolId, std::uint32_t> & slots) {
+
+	// a terminal symbol is a reference, unless it names a list
+	if (node.m_tail.empty()) {
+		if (!node.m_head.isSymbol() || !node.m_packed.empty() || node.m_head.asSymbolId() == ListSymbol) {
+			return false;
+		}
+		auto slot = slots.find(node.m_head.asSymbolId());
+		if (slot == slots.end()) {
+			return false;
+		}
+		node.m_head = Atom::fromParameter(slot->first, slot->second);
+		return true;
+	}
+
+	// only the operands that are evaluated in the frame are references: not
+	// the names given to define, map and apply, nor nested lambdas, whose
+	// bodies run in frames of their own, nor the operands of the property,
+	// plot and registered special-forms
+	std::size_t first = 0;
+	switch (node.m_head.asSymbolId()) {
+	case DefineSymbol:
+	case MapSymbol:
+	case ApplySymbol:
+	case PmapSymbol:
+	case PreduceSymbol:
+		first = 1;
+		break;
+	case BeginSymbol:
+		break;
+	default:
+		if (isSpecialForm(node.m_head.asSymbolId())) {
+			return false;
+		}
+		break;
+	}
+
+	bool changed = false;
+	for (std::size_t i = first; i < node.m_tail.size(); ++i) {
+		Expression operand = node.m_tail[i];
+		if (resolveParameters(operand, slots)) {
+			node.m_tail.write()[i] = std::move(operand);
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+Expression Expression::handle_apply(Environment & env) const {
 
 	// tail must have size 2 or error
 	if (m_tail.size() != 2) {
@@ -260,8 +664,8 @@ Expression Expression::handle_apply(Environment & env) {
 	}
 
 	// but tail[0] must not be a special-form or procedure
-	std::string s = m_tail[0].head().asSymbol();
-	if ((s == "define") || (s == "begin")) {
+	SymbolId s = m_tail[0].head().asSymbolId();
+	if ((s == DefineSymbol) || (s == BeginSymbol)) {
 		throw SemanticError("Error during evaluation: attempt to redefine a special-form");
 	}
 
@@ -271,72 +675,34 @@ Expression Expression::handle_apply(Environment & env) {
 	if (env.is_exp(m_head)) {
 		throw SemanticError("Error during evaluation: attempt to redefine a previously defined symbol");
 	}
-	bool definedLambda = false;
-	//check if first argument is defined lambda procedure
-	if (env.is_exp(m_tail[0].head())) {
-		if (env.get_exp(m_tail[0].head()).head().isLambda()) {
-			definedLambda = true;
-		}
-	}
-	bool isLambda = false;
-	//check if first argument is undefined lambda procedure
-	if (m_tail[0].head().asSymbol() == "lambda") {
-		isLambda = true;
-	}
-	bool firstArgProcedure = false;
-	//check if first argument is defined procedure
-	if (env.is_proc(m_tail[0].head()) || definedLambda || isLambda) {
-		if (env.is_proc(m_tail[0].head())) {
-			if (m_tail[0].m_tail.size() != 0) {
-				throw SemanticError("Error during apply: first argument is not a procedure");
-			}
-		}
-		firstArgProcedure = true;
+	//the first argument names a builtin or a lambda, or is a lambda
+	Procedure proc = nullptr;
+	Expression lambda;
+	bool firstArgProcedure = procedureArgument(env, proc, lambda);
+	if (proc != nullptr && m_tail[0].m_tail.size() != 0) {
+		throw SemanticError("Error during apply: first argument is not a procedure");
 	}
 
 	//check if second argument is list
 	bool secondArgList = false;
-	if (m_tail[1].head().asSymbol() == "list" || m_tail[1].isHeadList()) {
+	if (m_tail[1].head().asSymbolId() == ListSymbol || m_tail[1].isHeadList()) {
 		secondArgList = true;
 	}
 
-
 	//check if arguments are correct type
 	if (firstArgProcedure && secondArgList) {
-		Expression result = m_tail[1].eval(env);
-		Expression Answer;
-		std::vector<Expression> arguments;
-		for (auto e = result.tailConstBegin(); e != result.tailConstEnd(); e++) {
-			arguments.emplace_back(*e);
+		std::vector<Expression> arguments = m_tail[1].eval(env).takeElements();
+		if (m_tail[0].head().asSymbolId() == LambdaSymbol) {
+			lambda = m_tail[0].eval(env);
 		}
-		result.m_tail = arguments;
-		//must define lambda expression
-		if (isLambda) {			
-			Expression myLambda;
-			myLambda.m_head = std::string("define");
-			myLambda.m_tail.emplace_back(Expression(std::string("temporaryLambda")));
-			myLambda.m_tail.emplace_back(Expression(m_tail[0]));
-			bool expressionExists = env.is_exp(std::string("temporaryLambda"));
-			Expression expressionHolder;
-			//name is used sovalue must be stored in a temporary value
-			if (expressionExists) {
-				expressionHolder = env.get_exp(std::string("temporaryLambda"));
-				env.delete_exp(Atom(std::string("temporaryLambda")));
-			}
-			myLambda.eval(env);
-			result.m_head = Atom(std::string("temporaryLambda"));
-			Answer = result.eval(env);
-			env.delete_exp(Atom(std::string("temporaryLambda")));
-			//repopulate with temporary value if needed
-			if (expressionExists) {
-				env.add_exp(Atom(std::string("temporaryLambda")), expressionHolder);
+		//without arguments the call is a lookup of the procedure's name
+		if (arguments.empty()) {
+			if (proc != nullptr) {
+				throw SemanticError("Error during evaluation: unknown symbol");
 			}
+			return lambda;
 		}
-		else {
-			result.m_head = Atom(m_tail[0].head());
-			Answer = result.eval(env);
-		}
-		return Answer;
+		return callProcedure(proc, lambda, arguments, env);
 	}
 	else {
 		throw SemanticError("Error during apply: argument is wrong type: First should be procedure, Second should be list");
@@ -344,7 +710,7 @@ Expression Expression::handle_apply(Environment & env) {
 
 }
 
-Expression Expression::handle_map(Environment & env) {
+Expression Expression::handle_map(Environment & env) const {
 
 	// tail must have size 2 or error
 	if (m_tail.size() != 2) {
@@ -357,8 +723,8 @@ Expression Expression::handle_map(Environment & env) {
 	}
 
 	// but tail[0] must not be a special-form or procedure
-	std::string s = m_tail[0].head().asSymbol();
-	if ((s == "define") || (s == "begin")) {
+	SymbolId s = m_tail[0].head().asSymbolId();
+	if ((s == DefineSymbol) || (s == BeginSymbol)) {
 		throw SemanticError("Error during evaluation: attempt to redefine a special-form");
 	}
 
@@ -368,82 +734,331 @@ Expression Expression::handle_map(Environment & env) {
 	if (env.is_exp(m_head)) {
 		throw SemanticError("Error during evaluation: attempt to redefine a previously defined symbol");
 	}
-	bool definedLambda = false;
-	//check if first argument is defined lambda procedure
-	if (env.is_exp(m_tail[0].head())) {
-		if (env.get_exp(m_tail[0].head()).head().isLambda()) {
-			definedLambda = true;
-		}
+	//the first argument names a builtin or a lambda, or is a lambda
+	Procedure proc = nullptr;
+	Expression lambda;
+	bool firstArgProcedure = procedureArgument(env, proc, lambda);
+
+	//the second argument is evaluated once
+	Expression list = m_tail[1].eval(env);
+	if (!firstArgProcedure || !list.isHeadList()) {
+		throw SemanticError("Error during map: argument is wrong type: First should be procedure, Second should be list");
 	}
-	bool isLambda = false;
-	//check if first argument is undefined lambda procedure
-	if (m_tail[0].head().asSymbol() == "lambda") {
-		isLambda = true;
+	if (m_tail[0].head().asSymbolId() == LambdaSymbol) {
+		lambda = m_tail[0].eval(env);
 	}
-	bool firstArgProcedure = false;
-	//check if first argument is defined procedure
-	if (env.is_proc(m_tail[0].head()) || definedLambda || isLambda) {
-		firstArgProcedure = true;
+
+	//numbers are collected packed until a result is not a plain number
+	std::size_t size = list.getTailLength();
+	std::vector<double> numbers;
+	std::vector<Expression> results;
+	numbers.reserve(size);
+	std::vector<Expression> arguments(1);
+
+	//a builtin over packed numbers runs its specialized entry in a tight loop
+	double (*unary)(double) = (proc != nullptr) ? env.get_numeric(m_tail[0].head()).unary : nullptr;
+	if (unary != nullptr && list.isPacked()) {
+		for (double x : list.packedValues()) {
+			numbers.push_back(unary(x));
+		}
+		return Expression(std::move(numbers));
 	}
 
+	for (auto it = list.tailConstBegin(); it != list.tailConstEnd(); ++it) {
+		arguments[0] = *it;
+		Expression result = callProcedure(proc, lambda, arguments, env);
+		if (results.empty() && result.isPlainNumber()) {
+			numbers.push_back(result.head().asNumber());
+			continue;
+		}
+		if (results.empty()) {
+			results.reserve(size);
+			for (double value : numbers) {
+				results.emplace_back(Atom(value));
+			}
+		}
+		results.push_back(std::move(result));
+	}
 
-	bool secondArgList = false;
-	//check if second argument is list
+	if (results.empty()) {
+		return Expression(std::move(numbers));
+	}
+	return Expression(Atom(true), std::move(results));
+}
 
-	if (m_tail[1].eval(env).head().asSymbol() == "list" || m_tail[1].eval(env).isHeadList()) {
-		secondArgList = true;
+// the fewest elements a chunk of pmap or preduce is given, so scheduling a
+// chunk costs little beside evaluating it
+static const std::size_t MinimumChunk = 16;
+
+// the number of chunks pmap and preduce split size elements into, 1 to
+// evaluate them sequentially
+static std::size_t chunkCount(const Environment & env, std::size_t size) {
+	Executor * executor = env.executor();
+	if (executor == nullptr || executor->size() <= 1) {
+		return 1;
 	}
-	if (firstArgProcedure && secondArgList) {
-		Expression result = m_tail[1].eval(env);
-		std::list<Expression> Answer;
-		std::vector<Expression> arguments;
-		for (auto e = result.tailConstBegin(); e != result.tailConstEnd(); e++) {
-			arguments.emplace_back(*e);
-		}
-		result.m_tail.clear();
-		if (isLambda) {
-			Expression myLambda;
-			myLambda.m_head = std::string("define");
-			myLambda.m_tail.emplace_back(Expression(std::string("temporaryLambda")));
-			myLambda.m_tail.emplace_back(Expression(m_tail[0]));
-			bool expressionExists = env.is_exp(std::string("temporaryLambda"));
-			Expression expressionHolder;
-			//name already defined in exp. Must copy to temporary expression
-			if (expressionExists) {
-				expressionHolder = env.get_exp(std::string("temporaryLambda"));
-				env.delete_exp(Atom(std::string("temporaryLambda")));
+	// a few chunks for each thread, so threads finishing early steal the rest
+	return std::max<std::size_t>(1, std::min(executor->size() * 4, size / MinimumChunk));
+}
+
+// run task(chunk, begin, end) for each chunk of size elements, on the
+// executor of env when there is more than one chunk
+template <typename Task>
+static void forEachChunk(const Environment & env, std::size_t size, std::size_t chunks, Task task) {
+	if (chunks <= 1) {
+		task(0, 0, size);
+		return;
+	}
+	env.executor()->run(chunks, [&](std::size_t chunk) {
+		task(chunk, size * chunk / chunks, size * (chunk + 1) / chunks);
+	});
+}
+
+// The values of a plotted function at the points it is sampled at. Points
+// are sampled in parallel batches on the executor of the environment, each
+// task calling the function in a frame of its own, and an error is raised
+// when the value of its point is used, so the first error in point order is
+// the one raised.
+class FunctionSamples {
+public:
+
+	FunctionSamples(const Expression & function, Environment & env) : m_function(function), m_env(env) {}
+
+	// evaluate the function at each point not sampled yet
+	void sample(const std::vector<double> & points) {
+		std::vector<double> batch;
+		for (double x : points) {
+			if (m_samples.find(key(x)) == m_samples.end()) {
+				m_samples[key(x)];
+				batch.push_back(x);
 			}
-			myLambda.eval(env);
-			result.m_head = Atom(std::string("temporaryLambda"));
-			for (unsigned int i = 0; i < arguments.size(); i++) {
-				result.m_tail.emplace_back(arguments[i]);
-				Answer.push_back(result.eval(env));
-				result.m_tail.pop_back();
+		}
+
+		// a chunk for each point, plotted functions are few and costly
+		std::vector<Sample> results(batch.size());
+		Executor * executor = m_env.executor();
+		std::size_t chunks = (executor == nullptr) ? 1 : std::min(batch.size(), executor->size() * 4);
+		forEachChunk(m_env, batch.size(), chunks, [&](std::size_t, std::size_t begin, std::size_t end) {
+			Environment frame = m_env.frame();
+			std::vector<Expression> arguments(1);
+			for (std::size_t i = begin; i < end; ++i) {
+				arguments[0] = Expression(Atom(batch[i]));
+				try {
+					results[i].value = Expression::callLambda(m_function, arguments, frame);
+				}
+				catch (...) {
+					results[i].error = std::current_exception();
+				}
 			}
-			env.delete_exp(Atom(std::string("temporaryLambda")));
-			//if needed, place temporary value back in env
-			if (expressionExists) {
-				env.add_exp(Atom(std::string("temporaryLambda")), expressionHolder);
+		});
+
+		for (std::size_t i = 0; i < batch.size(); ++i) {
+			m_samples[key(batch[i])] = std::move(results[i]);
+		}
+	}
+
+	// return the value of the function at x, sampling it if it was not
+	const Expression & value(double x) {
+		sample(std::vector<double>(1, x));
+		const Sample & sample = m_samples[key(x)];
+		if (sample.error) {
+			std::rethrow_exception(sample.error);
+		}
+		return sample.value;
+	}
+
+private:
+
+	struct Sample {
+		Expression value;
+		std::exception_ptr error;
+	};
+
+	// points are told apart by their bits, so 0 and -0 are sampled apart
+	static std::uint64_t key(double x) {
+		std::uint64_t bits;
+		std::memcpy(&bits, &x, sizeof(bits));
+		return bits;
+	}
+
+	const Expression & m_function;
+	Environment & m_env;
+	std::unordered_map<std::uint64_t, Sample> m_samples;
+};
+
+bool Expression::runsInParallel(const Environment & env, std::size_t size) {
+	return chunkCount(env, size) > 1;
+}
+
+Expression Expression::handle_pmap(Environment & env) const {
+
+	// tail must have size 2 or error
+	if (m_tail.size() != 2) {
+		throw SemanticError("Error during evaluation: invalid number of arguments to pmap");
+	}
+
+	//the first argument names a builtin or a lambda, or is a lambda
+	Procedure proc = nullptr;
+	Expression lambda;
+	bool firstArgProcedure = m_tail[0].isHeadSymbol() && procedureArgument(env, proc, lambda);
+
+	//the second argument is evaluated once
+	Expression list = m_tail[1].eval(env);
+	if (!firstArgProcedure || !list.isHeadList()) {
+		throw SemanticError("Error during pmap: argument is wrong type: First should be procedure, Second should be list");
+	}
+	if (m_tail[0].head().asSymbolId() == LambdaSymbol) {
+		lambda = m_tail[0].eval(env);
+	}
+	return parallelMap(m_tail[0].head(), proc, lambda, list, env);
+}
+
+Expression Expression::parallelMap(const Atom & name, Procedure proc, const Expression & lambda,
+                                   const Expression & list, Environment & env) {
+
+	std::size_t size = list.getTailLength();
+	std::size_t chunks = chunkCount(env, size);
+
+	//a builtin over packed numbers runs its specialized entry on each chunk
+	double (*unary)(double) = (proc != nullptr) ? env.get_numeric(name).unary : nullptr;
+	if (unary != nullptr && list.isPacked()) {
+		const std::vector<double> & values = list.packedValues();
+		std::vector<double> numbers(size);
+		forEachChunk(env, size, chunks, [&](std::size_t, std::size_t begin, std::size_t end) {
+			for (std::size_t i = begin; i < end; ++i) {
+				numbers[i] = unary(values[i]);
 			}
+		});
+		return Expression(std::move(numbers));
+	}
+
+	//each chunk calls the procedure in a frame of its own, filling its
+	//slots of the results
+	std::vector<Expression> results(size);
+	forEachChunk(env, size, chunks, [&](std::size_t, std::size_t begin, std::size_t end) {
+		Environment frame = env.frame();
+		std::vector<Expression> arguments(1);
+		for (std::size_t i = begin; i < end; ++i) {
+			arguments[0] = *(list.tailConstBegin() + i);
+			results[i] = callProcedure(proc, lambda, arguments, frame);
 		}
-		else {
-			result.m_head = Atom(m_tail[0].head());
-			for (unsigned int i = 0; i < arguments.size(); i++) {
-				result.m_tail.emplace_back(arguments[i]);
-				Answer.push_back(result.eval(env));
-				result.m_tail.pop_back();
+	});
+
+	if (packable(results)) {
+		std::vector<double> numbers;
+		numbers.reserve(size);
+		for (const Expression & result : results) {
+			numbers.push_back(result.head().asNumber());
+		}
+		return Expression(std::move(numbers));
+	}
+	return Expression(Atom(true), std::move(results));
+}
+
+Expression Expression::handle_preduce(Environment & env) const {
+
+	// tail must have size 3 or error
+	if (m_tail.size() != 3) {
+		throw SemanticError("Error during evaluation: invalid number of arguments to preduce");
+	}
+
+	//the first argument names a builtin or a lambda, or is a lambda
+	Procedure proc = nullptr;
+	Expression lambda;
+	bool firstArgProcedure = m_tail[0].isHeadSymbol() && procedureArgument(env, proc, lambda);
+
+	//the initial value and the list are evaluated once
+	Expression initial = m_tail[1].eval(env);
+	Expression list = m_tail[2].eval(env);
+	if (!firstArgProcedure || !list.isHeadList()) {
+		throw SemanticError("Error during preduce: argument is wrong type: First should be procedure, Third should be list");
+	}
+	if (m_tail[0].head().asSymbolId() == LambdaSymbol) {
+		lambda = m_tail[0].eval(env);
+	}
+	return parallelReduce(m_tail[0].head(), proc, lambda, initial, list, env);
+}
+
+Expression Expression::parallelReduce(const Atom & name, Procedure proc, const Expression & lambda,
+                                      const Expression & initial, const Expression & list, Environment & env) {
+
+	std::size_t size = list.getTailLength();
+	std::size_t chunks = chunkCount(env, size);
+
+	//a builtin over packed numbers runs its specialized entry on each chunk
+	double (*binary)(double, double) = (proc != nullptr) ? env.get_numeric(name).binary : nullptr;
+	if (binary != nullptr && list.isPacked() && initial.isPlainNumber()) {
+		const std::vector<double> & values = list.packedValues();
+		std::vector<double> partials(chunks);
+		forEachChunk(env, size, chunks, [&](std::size_t chunk, std::size_t begin, std::size_t end) {
+			double partial = values[begin];
+			for (std::size_t i = begin + 1; i < end; ++i) {
+				partial = binary(partial, values[i]);
 			}
+			partials[chunk] = partial;
+		});
+		double result = initial.head().asNumber();
+		for (std::size_t i = 0; (i < chunks) && (size > 0); ++i) {
+			result = binary(result, partials[i]);
 		}
-		return Expression(Answer);
+		return Expression(Atom(result));
 	}
-	else {
-		throw SemanticError("Error during map: argument is wrong type: First should be procedure, Second should be list");
+
+	//each chunk folds its own elements in a frame of its own; the procedure
+	//is associative, so folding the partial results from the initial value
+	//gives the value of folding the whole list
+	std::vector<Expression> partials(chunks);
+	forEachChunk(env, size, chunks, [&](std::size_t chunk, std::size_t begin, std::size_t end) {
+		if (begin == end) {
+			return;
+		}
+		Environment frame = env.frame();
+		std::vector<Expression> arguments(2);
+		Expression partial = *(list.tailConstBegin() + begin);
+		for (std::size_t i = begin + 1; i < end; ++i) {
+			arguments[0] = std::move(partial);
+			arguments[1] = *(list.tailConstBegin() + i);
+			partial = callProcedure(proc, lambda, arguments, frame);
+		}
+		partials[chunk] = std::move(partial);
+	});
+
+	Expression result = initial;
+	std::vector<Expression> arguments(2);
+	for (std::size_t i = 0; (i < chunks) && (size > 0); ++i) {
+		arguments[0] = std::move(result);
+		arguments[1] = std::move(partials[i]);
+		result = callProcedure(proc, lambda, arguments, env);
 	}
+	return result;
+}
 
+bool Expression::procedureArgument(Environment & env, Procedure & proc, Expression & lambda) const {
+	const Atom & name = m_tail[0].head();
+	if (name.asSymbolId() == LambdaSymbol) {
+		// made by the caller once the arguments are checked
+		return true;
+	}
+	if (env.is_exp(name)) {
+		// a call of a lambda may return the procedure, as a closure
+		lambda = (m_tail[0].getTailLength() == 0) ? env.get_exp(name) : m_tail[0].eval(env);
+		return lambda.head().isLambda();
+	}
+	if (env.is_proc(name)) {
+		proc = env.get_proc(name);
+		return true;
+	}
+	return false;
+}
 
+Expression Expression::callProcedure(Procedure proc, const Expression & lambda, std::vector<Expression> & args, Environment & env) {
+	if (proc != nullptr) {
+		return proc(args);
+	}
+	return callLambda(lambda, args, env);
 }
 
-Expression Expression::handle_set_property(Environment & env) {
+Expression Expression::handle_set_property(Environment & env) const {
 	
 	// tail must have size 3 or error
 	if (m_tail.size() != 3) {
@@ -467,14 +1082,14 @@ Expression Expression::handle_set_property(Environment & env) {
 	Expression propertyValue = m_tail[1].eval(env);
 	Expression myExpression = m_tail[2].eval(env);
 	if (myExpression.checkProperty(m_tail[0].head())) {
-		myExpression.propertymap.erase(m_tail[0].head().asString());
+		myExpression.propertymap.write().erase(m_tail[0].head().asString());
 	}
-	myExpression.propertymap.emplace(m_tail[0].head().asString(), propertyValue);
+	myExpression.propertymap.write().emplace(m_tail[0].head().asString(), std::move(propertyValue));
 	return myExpression;
 
 }
 
-Expression Expression::handle_get_property(Environment & env) {
+Expression Expression::handle_get_property(Environment & env) const {
 
 	// tail must have size 3 or error
 	if (m_tail.size() != 2) {
@@ -494,71 +1109,75 @@ Expression Expression::handle_get_property(Environment & env) {
 	}
 	Expression answer = m_tail[1].eval(env);
 	Expression result;
-	if (answer.propertymap.find(m_tail[0].head().asString()) != answer.propertymap.end()) {
-		result = answer.propertymap.find(m_tail[0].head().asString())->second;
+	if (answer.propertymap.get().find(m_tail[0].head().asString()) != answer.propertymap.end()) {
+		result = answer.propertymap.get().find(m_tail[0].head().asString())->second;
 	}
 	return result;
 
 }
 
-Expression Expression::handle_discrete_plot(Environment & env) {
-	// tail must have size 3 or error
-	std::list<Expression> resultList;
-
+Expression Expression::handle_discrete_plot(Environment & env) const {
+	// tail must have size 2 or error
 	if (m_tail.size() != 2) {
 		throw SemanticError("Error: invalid number of arguments");
 	}
 
-	// tail[0] must be string
-	else if (!m_tail[0].eval(env).isHeadList()) {
+	// each argument is evaluated once, the points gathered into a buffer
+	Expression coordinates = m_tail[0].eval(env);
+	PlotBuffer plot;
+	if (!coordinates.isHeadList()) {
 		throw SemanticError("Error: first argument is not a list on coordinates");
 	}
-	else if (!m_tail[0].eval(env).checkValidCoordinates()) {
+	else if (!coordinates.coordinateBuffer(plot)) {
 		throw SemanticError("Error: one or more coordinates were invalid");
 	}
-	else if (!m_tail[1].eval(env).isHeadList()) {
-		throw SemanticError("Error: second argument is not a list ");
+	else if (plot.x.empty()) {
+		throw SemanticError("Error: first argument has no coordinates");
 	}
 
+	Expression options = m_tail[1].eval(env);
+	if (!options.isHeadList()) {
+		throw SemanticError("Error: second argument is not a list ");
+	}
 
-	double minX = m_tail[0].eval(env).getMinX();
-	double maxX = m_tail[0].eval(env).getMaxX();
-	double minY = m_tail[0].eval(env).getMinY();
-	double maxY = m_tail[0].eval(env).getMaxY();
+	plot.computeBounds();
 
 	double textScale=1;
 
-	for (unsigned int i = 0; i < m_tail[1].eval(env).getTailLength(); i++) {
-		if (!m_tail[1].eval(env).m_tail[i].isHeadList()) {
+	for (auto it = options.tailConstBegin(); it != options.tailConstEnd(); ++it) {
+		const Expression & option = *it;
+		if (!option.isHeadList()) {
 			throw SemanticError("Error: one or more options is not a list");
 		}
-		else if (m_tail[1].eval(env).m_tail[i].getTailLength() != 2) {
+		else if (option.getTailLength() != 2) {
 			throw SemanticError("Error: one or more options has incorrect amount of properties");
 		}
-		else if (!m_tail[1].eval(env).m_tail[i].m_tail[0].isHeadString()) {
+		else if (!option.getValueInTail(0).isHeadString()) {
 			throw SemanticError("Error: Option type is not a string");
 		}
 
-		if (m_tail[1].eval(env).m_tail[i].m_tail[0].head().asString() == "\"text-scale\"") {
-			if (!m_tail[1].eval(env).m_tail[i].m_tail[1].isHeadNumber()) {
+		if (option.getValueInTail(0).head().asString() == "\"text-scale\"") {
+			Expression value = option.getValueInTail(1);
+			if (!value.isHeadNumber()) {
 				throw SemanticError("Error: Text-scale not given a number property");
 			}
-			else if (m_tail[1].eval(env).m_tail[i].m_tail[1].head().asNumber() <= 0) {
+			else if (value.head().asNumber() <= 0) {
 				throw SemanticError("Error: Number value is not positive");
 			}
 			else {
-				textScale = m_tail[1].eval(env).m_tail[i].m_tail[1].head().asNumber();
+				textScale = value.head().asNumber();
 			}
 		}
 
 	}
 
-	resultList.splice(resultList.end(), m_tail[0].eval(env).handlePoints(minX, maxX, minY, maxY));
-	resultList.splice(resultList.end(), m_tail[0].eval(env).buildRect(minX, maxX, minY, maxY));
-	resultList.splice(resultList.end(), m_tail[0].eval(env).buildOrigin(minX, maxX, minY, maxY));
-	resultList.splice(resultList.end(), m_tail[0].eval(env).buildStems(minX, maxX, minY, maxY));
-	resultList.splice(resultList.end(), m_tail[0].eval(env).listAxis(minX, maxX, minY, maxY, textScale));
-	resultList.splice(resultList.end(), m_tail[1].eval(env).listLabels(minX, maxX, minY, maxY, textScale));
+	std::shared_ptr<PlotPrimitives> items = std::make_shared<PlotPrimitives>();
+	plot.addPoints(*items);
+	plot.addFrame(*items);
+	plot.addOrigin(*items);
+	plot.addStems(*items);
+	plot.addAxis(*items, textScale);
+	options.listLabels(plot, textScale, *items);
 
 	if (env.is_proc(m_head)) {
 		throw SemanticError("Error during evaluation: attempt to redefine a built-in procedure");
@@ -567,98 +1186,108 @@ Expression Expression::handle_discrete_plot(Environment & env) {
 		throw SemanticError("Error during evaluation: attempt to redefine a previously defined symbol");
 	}
 
-	Expression result(resultList);
-	return result;
+	return Expression(std::shared_ptr<const PlotPrimitives>(std::move(items)));
 }
 
-Expression Expression::handle_continuous_plot(Environment & env) {
-	// tail must have size 3 or error
-	std::list<Expression> resultList;
-	std::list<Expression> myCoordinates;
+Expression Expression::handle_continuous_plot(Environment & env) const {
+	// tail must have size 2 or 3 or error
 	if (!(m_tail.size() == 3 || m_tail.size() == 2)) {
 		throw SemanticError("Error: invalid number of arguments");
 	}
 
-	// tail[0] must be string
-	else if (!m_tail[0].eval(env).isHeadLambda()) {
+	// tail[0] must be a lambda, called directly for each point
+	Expression function = m_tail[0].eval(env);
+	if (!function.isHeadLambda()) {
 		throw SemanticError("Error: first argument is not a function");
 	}
-	else if (!m_tail[1].eval(env).isHeadList()) {
+	Expression bounds = m_tail[1].eval(env);
+	if (!bounds.isHeadList()) {
 		throw SemanticError("Error: second argument is not a list ");
 	}
-	else if (m_tail[1].eval(env).getTailLength()!=2) {
+	else if (bounds.getTailLength()!=2) {
 		throw SemanticError("Error: second argument does not have 2 bounds");
 	}
-	else if (!m_tail[1].eval(env).m_tail[0].isHeadNumber() && !m_tail[1].eval(env).m_tail[1].isHeadNumber()) {
+	else if (!bounds.getValueInTail(0).isHeadNumber() && !bounds.getValueInTail(1).isHeadNumber()) {
 		throw SemanticError("Error: One or more bounds is not a number");
 	}
-	else if (!(m_tail[1].eval(env).m_tail[0].head().asNumber() < m_tail[1].eval(env).m_tail[1].head().asNumber())) {
+	else if (!(bounds.getValueInTail(0).head().asNumber() < bounds.getValueInTail(1).head().asNumber())) {
 		throw SemanticError("Error:Lower bound is greater than upper bound");
 	}
-	Expression myList(Atom(std::string("list")));
-
-	double minX = m_tail[1].eval(env).m_tail[0].head().asNumber();
-	double maxX = m_tail[1].eval(env).m_tail[1].head().asNumber();
-	double xRange = maxX - minX;
-
-
-	for (int i = 0; i <= 50; i++) {
-		myList.m_tail.emplace_back(Expression(Atom(minX+((xRange/50)*i))));
-	}
-
-
-	Expression myMap(Atom(std::string("map")));
-	myMap.m_tail.emplace_back(m_tail[0]);
-	myMap.m_tail.emplace_back(myList);
-	Expression xPoints(myList);
-	Expression yPoints(myMap.eval(env));
-	std::list<Expression> aCoordinate;
-
-	for (unsigned int i = 0; i < yPoints.getTailLength(); i++) {
-		aCoordinate.emplace_back(xPoints.getValueInTail(i));
-		aCoordinate.emplace_back(yPoints.getValueInTail(i));
-		myCoordinates.emplace_back(Expression(aCoordinate));
-		aCoordinate.clear();
-	}
-	Expression coordinateList(myCoordinates);
-
-	coordinateList = coordinateList.fixAngles(0, m_tail[0], env);
-
-	double minY = coordinateList.getMinY();
-	double maxY = coordinateList.getMaxY();
+	double minX = bounds.getValueInTail(0).head().asNumber();
+	double maxX = bounds.getValueInTail(1).head().asNumber();
 
 	double textScale = 1;
+	SamplingOptions sampling;
+	Expression options;
 	if (m_tail.size() == 3) {
-		for (unsigned int i = 0; i < m_tail[2].eval(env).getTailLength(); i++) {
-			if (!m_tail[2].eval(env).m_tail[i].isHeadList()) {
+		options = m_tail[2].eval(env);
+		for (auto it = options.tailConstBegin(); it != options.tailConstEnd(); ++it) {
+			const Expression & item = *it;
+			if (!item.isHeadList()) {
 				throw SemanticError("Error: one or more options is not a list");
 			}
-			else if (m_tail[2].eval(env).m_tail[i].getTailLength() != 2) {
+			else if (item.getTailLength() != 2) {
 				throw SemanticError("Error: one or more options has incorrect amount of properties");
 			}
-			else if (!m_tail[2].eval(env).m_tail[i].m_tail[0].isHeadString()) {
+			else if (!item.getValueInTail(0).isHeadString()) {
 				throw SemanticError("Error: Option type is not a string");
 			}
 
-			if (m_tail[2].eval(env).m_tail[i].m_tail[0].head().asString() == "\"text-scale\"") {
-				if (!m_tail[2].eval(env).m_tail[i].m_tail[1].isHeadNumber()) {
+			std::string option = item.getValueInTail(0).head().asString();
+			Expression value = item.getValueInTail(1);
+			if (option == "\"text-scale\"") {
+				if (!value.isHeadNumber()) {
 					throw SemanticError("Error: Text-scale not given a number property");
 				}
-				else if (m_tail[2].eval(env).m_tail[i].m_tail[1].head().asNumber() <= 0) {
+				else if (value.head().asNumber() <= 0) {
 					throw SemanticError("Error: Number value is not positive");
 				}
 				else {
-					textScale = m_tail[2].eval(env).m_tail[i].m_tail[1].head().asNumber();
+					textScale = value.head().asNumber();
+				}
+			}
+			else if (option == "\"samples\"") {
+				if (!value.isHeadNumber() || value.head().asNumber() < 2 || value.head().asNumber() != std::floor(value.head().asNumber())) {
+					throw SemanticError("Error: Samples not given an integer of at least 2");
+				}
+				sampling.samples = static_cast<std::size_t>(std::min(value.head().asNumber(), 1e9));
+			}
+			else if (option == "\"tolerance\"") {
+				if (!value.isHeadNumber() || !(value.head().asNumber() > 0)) {
+					throw SemanticError("Error: Tolerance not given a positive number");
 				}
+				sampling.tolerance = value.head().asNumber();
 			}
+		}
+	}
 
+	// the function is sampled adaptively, each round of points at once
+	FunctionSamples samples(function, env);
+	BatchFunction batch = [&samples](const std::vector<double> & x, std::vector<double> & y) {
+		samples.sample(x);
+		y.clear();
+		for (double point : x) {
+			y.push_back(samples.value(point).head().asNumber());
 		}
-		resultList.splice(resultList.end(), m_tail[2].eval(env).listLabels(minX, maxX, minY, maxY, textScale));
+	};
+	SampledCurve curve = sampleAdaptively(batch, minX, maxX, sampling);
+
+	// the bounds of x are those asked for, whatever was sampled
+	PlotBuffer plot;
+	plot.x = std::move(curve.x);
+	plot.y = std::move(curve.y);
+	plot.computeBounds();
+	plot.minX = minX;
+	plot.maxX = maxX;
+
+	std::shared_ptr<PlotPrimitives> items = std::make_shared<PlotPrimitives>();
+	if (m_tail.size() == 3) {
+		options.listLabels(plot, textScale, *items);
 	}
-	resultList.splice(resultList.end(), coordinateList.buildLines(minX, maxX, minY, maxY));
-	resultList.splice(resultList.end(), coordinateList.buildRect(minX, maxX, minY, maxY));
-	resultList.splice(resultList.end(), coordinateList.buildOrigin(minX, maxX, minY, maxY));
-	resultList.splice(resultList.end(), coordinateList.listAxis(minX, maxX, minY, maxY, textScale));
+	plot.addLines(*items);
+	plot.addFrame(*items);
+	plot.addOrigin(*items);
+	plot.addAxis(*items, textScale);
 	
 
 	if (env.is_proc(m_head)) {
@@ -668,84 +1297,146 @@ Expression Expression::handle_continuous_plot(Environment & env) {
 		throw SemanticError("Error during evaluation: attempt to redefine a previously defined symbol");
 	}
 
-	Expression result(resultList);
-	return result;
+	return Expression(std::shared_ptr<const PlotPrimitives>(std::move(items)));
+}
+std::vector<SpecialForm> & Expression::specialForms() {
+	// the built-in names are interned first, so their ids index the front
+	static std::vector<SpecialForm> forms = {
+		[](const Expression & form, Environment & env) { return form.handle_begin(env); },
+		[](const Expression & form, Environment & env) { return form.handle_define(env); },
+		[](const Expression & form, Environment & env) { return form.handle_lambda(env); },
+		[](const Expression & form, Environment & env) { return form.handle_apply(env); },
+		[](const Expression & form, Environment & env) { return form.handle_map(env); },
+		[](const Expression & form, Environment & env) { return form.handle_set_property(env); },
+		[](const Expression & form, Environment & env) { return form.handle_get_property(env); },
+		[](const Expression & form, Environment & env) { return form.handle_discrete_plot(env); },
+		[](const Expression & form, Environment & env) { return form.handle_continuous_plot(env); },
+		[](const Expression & form, Environment & env) { return form.handle_memoize(env); },
+		[](const Expression & form, Environment & env) { return form.handle_pmap(env); },
+		[](const Expression & form, Environment & env) { return form.handle_preduce(env); },
+	};
+	return forms;
+}
+
+void Expression::registerSpecialForm(const std::string & name, SpecialForm form) {
+	SymbolId id = intern(name);
+	std::vector<SpecialForm> & forms = specialForms();
+	if (id >= forms.size()) {
+		forms.resize(id + 1, nullptr);
+	}
+	forms[id] = form;
+}
+
+bool Expression::isSpecialForm(SymbolId id) noexcept {
+	const std::vector<SpecialForm> & forms = specialForms();
+	return id < forms.size() && forms[id] != nullptr;
 }
+
 // this is a simple recursive version. the iterative version is more
 // difficult with the ast data structure used (no parent pointer).
 // this limits the practical depth of our AST
-Expression Expression::eval(Environment & env) {
+Expression Expression::eval(Environment & env) const {
 
 	if (env.checkEnvInterrupt()) {
 		throw SemanticError("Error: interpreter kernel interrupted");
 	}
 	else {
-		if (m_tail.empty() && m_head.asSymbol() != "list") {
-			return handle_lookup(m_head, env);
-		}
-		// handle begin special-form
-		else if (m_head.isSymbol() && m_head.asSymbol() == "begin") {
-			return handle_begin(env);
-		}
-		// handle define special-form
-		else if (m_head.isSymbol() && m_head.asSymbol() == "define") {
-			return handle_define(env);
-		}
-		// handle lambda special-form
-		else if (m_head.isSymbol() && m_head.asSymbol() == "lambda") {
-			return handle_lambda(env);
+		// a List value, as folding leaves in lambda bodies, is its own value
+		if (m_head.isList()) {
+			return *this;
 		}
-		// handle apply procedure
-		else if (m_head.isSymbol() && m_head.asSymbol() == "apply") {
-			return handle_apply(env);
-		}
-		// handle map procedure
-		else if (m_head.isSymbol() && m_head.asSymbol() == "map") {
-			return handle_map(env);
-		}
-		// handle map procedure
-		else if (m_head.isSymbol() && m_head.asSymbol() == "set-property") {
-			return handle_set_property(env);
-		}
-		// handle map procedure
-		else if (m_head.isSymbol() && m_head.asSymbol() == "get-property") {
-			return handle_get_property(env);
+		if (m_tail.empty() && m_head.asSymbolId() != ListSymbol) {
+			return handle_lookup(m_head, env);
 		}
-		// handle map procedure
-		else if (m_head.isSymbol() && m_head.asSymbol() == "discrete-plot") {
-			return handle_discrete_plot(env);
+		// special-forms are dispatched on the interned symbol id
+		const std::vector<SpecialForm> & forms = specialForms();
+		SymbolId id = m_head.asSymbolId();
+		if (id < forms.size() && forms[id] != nullptr) {
+			return forms[id](*this, env);
 		}
-		else if (m_head.isSymbol() && m_head.asSymbol() == "continuous-plot") {
-			return handle_continuous_plot(env);
+
+		// else attempt to treat as procedure
+		std::vector<Expression> results;
+		if (m_tail.size() <= 2) {
+			// a builtin given one or two plain numbers is called through its
+			// specialized entry, without the argument vector
+			Expression operands[2];
+			for (std::size_t i = 0; i < m_tail.size(); i++) {
+				operands[i] = m_tail[i].eval(env);
+			}
+			Expression result;
+			if (env.apply_numeric(m_head, operands, m_tail.size(), result)) {
+				return result;
+			}
+			results.reserve(m_tail.size());
+			for (std::size_t i = 0; i < m_tail.size(); i++) {
+				results.push_back(std::move(operands[i]));
+			}
 		}
 		else {
-			// else attempt to treat as procedure
-			std::vector<Expression> results;
-			for (Expression::IteratorType it = m_tail.begin(); it != m_tail.end(); ++it) {
+			results.reserve(m_tail.size());
+			for (auto it = m_tail.begin(); it != m_tail.end(); ++it) {
 				results.push_back(it->eval(env));
 			}
-			//evaluate lambda function
-			if (!m_tail.empty() && env.is_exp(m_head)) {
-				//create temporary environment
-				Environment lambdaEnv = env;
-				//make sure the correct amount of parameters are used
-				if (env.get_exp(m_head).getValueInTail(0).getTailLength() != results.size()) {
-					throw SemanticError("Error during evaluation: attempt to redefine a previously defined symbol");
-				}
-				//delete repeated expressions
-				for (unsigned int i = 0; i < env.get_exp(m_head).getValueInTail(0).getTailLength(); i++) {
-					if (env.is_exp(env.get_exp(m_head).getValueInTail(0).getValueInTail(i).head())) {
-						lambdaEnv.delete_exp(env.get_exp(m_head).getValueInTail(0).getValueInTail(i).head());
-					}
-					lambdaEnv.add_exp(env.get_exp(m_head).getValueInTail(0).getValueInTail(i).head(), results[i]);
-				}
-				return env.get_exp(m_head).getValueInTail(1).eval(lambdaEnv);
-			}
-			return apply(m_head, results, env);
 		}
+		//evaluate lambda function
+		if (!m_tail.empty() && env.is_exp(m_head)) {
+			return callLambda(env.get_exp(m_head), results, env);
+		}
+		return apply(m_head, results, env);
 	}
 }
 
+Environment Expression::bindLambdaCall(const Atom & head, std::vector<Expression> & args,
+	const Environment & env, Expression & body) {
+	// fetch the lambda once, its parameters and body share its storage
+	return bindLambda(env.get_exp(head), args, env, body);
+}
+
+Environment Expression::bindLambda(const Expression & lambda, std::vector<Expression> & args,
+	const Environment & env, Expression & body) {
+	//a value that is not a lambda is called as one without parameters
+	const Closure * closure = lambda.head().asClosure();
+	if (closure == nullptr) {
+		throw SemanticError("Error during evaluation: attempt to redefine a previously defined symbol");
+	}
+	body = closure->body(env);
+	return closure->bind(args, env);
+}
+
+Expression Expression::callLambda(const Expression & lambda, std::vector<Expression> & args,
+	Environment & env) {
+	MemoizedCall memo(lambda, args, env);
+	Expression result;
+	if (memo.find(result)) {
+		return result;
+	}
+	Expression body;
+	Environment lambdaEnv = bindLambda(lambda, args, env, body);
+	result = body.eval(lambdaEnv);
+	memo.store(result);
+	return result;
+}
+
+Expression Expression::handle_memoize(Environment & env) const {
+
+	// tail must have size 1 or error
+	if (m_tail.size() != 1) {
+		throw SemanticError("Error during evaluation: invalid number of arguments to memoize");
+	}
+
+	// the operand must evaluate to a lambda
+	Expression lambda = m_tail[0].eval(env);
+	const Closure * closure = lambda.m_head.asClosure();
+	if (closure == nullptr || lambda.m_tail.size() != 2) {
+		throw SemanticError("Error during evaluation: argument to memoize not a lambda");
+	}
+
+	lambda.m_head = Atom::fromClosure(std::make_shared<const Closure>(lambda.m_tail[0], lambda.m_tail[1],
+		closure->captured(), true));
+	return lambda;
+}
+
 std::ostream & operator<<(std::ostream & out, const Expression & exp){
   Environment env;
 
@@ -777,15 +1468,16 @@ std::ostream & operator<<(std::ostream & out, const Expression & exp){
   return out;
 }
 
-bool Expression::operator==(const Expression & exp) const noexcept{
+bool Expression::operator==(const Expression & exp) const{
 
   bool result = (m_head == exp.m_head);
 
-  result = result && (m_tail.size() == exp.m_tail.size());
+  result = result && (getTailLength() == exp.getTailLength());
 
-  if(result){
-    for(auto lefte = m_tail.begin(), righte = exp.m_tail.begin();
-	(lefte != m_tail.end()) && (righte != exp.m_tail.end());
+  // shared storage is equal without visiting it
+  if(result && !sameTail(exp)){
+    for(auto lefte = tailConstBegin(), righte = exp.tailConstBegin();
+	(lefte != tailConstEnd()) && (righte != exp.tailConstEnd());
 	++lefte, ++righte){
       result = result && (*lefte == *righte);
     }
@@ -794,33 +1486,119 @@ bool Expression::operator==(const Expression & exp) const noexcept{
   return result;
 }
 
-bool operator!=(const Expression & left, const Expression & right) noexcept{
+// exact equality of atoms, as identical compares heads
+static bool identicalAtoms(const Atom & left, const Atom & right) noexcept {
+	if (left.isNumber() || right.isNumber()) {
+		double x = left.asNumber(), y = right.asNumber();
+		return left.isNumber() && right.isNumber() && std::memcmp(&x, &y, sizeof(double)) == 0;
+	}
+	if (left.isComplex() || right.isComplex()) {
+		std::complex<double> x = left.asComplex(), y = right.asComplex();
+		return left.isComplex() && right.isComplex() && std::memcmp(&x, &y, sizeof(x)) == 0;
+	}
+	if (left.isLambda() || right.isLambda()) {
+		return left.isLambda() && right.isLambda() && left.asClosure() == right.asClosure();
+	}
+	return left == right;
+}
+
+// hash of an atom, equal for identical atoms
+static std::size_t hashAtom(const Atom & atom) noexcept {
+	if (atom.isNumber()) {
+		return std::hash<double>()(atom.asNumber());
+	}
+	if (atom.isComplex()) {
+		return std::hash<double>()(atom.asComplex().real()) * 31 + std::hash<double>()(atom.asComplex().imag());
+	}
+	if (atom.isLambda()) {
+		return std::hash<const void *>()(atom.asClosure());
+	}
+	if (atom.isString()) {
+		return std::hash<std::string>()(atom.asString());
+	}
+	if (atom.isSymbol()) {
+		return std::hash<SymbolId>()(atom.asSymbolId());
+	}
+	return atom.isList() ? 1 : 0;
+}
+
+bool Expression::identical(const Expression & exp) const {
+	if (!identicalAtoms(m_head, exp.m_head) || getTailLength() != exp.getTailLength()
+		|| propertymap.size() != exp.propertymap.size()) {
+		return false;
+	}
+
+	if (!m_packed.empty() && !exp.m_packed.empty()) {
+		if (!m_packed.sameStorage(exp.m_packed) &&
+			std::memcmp(m_packed.get().data(), exp.m_packed.get().data(), m_packed.size() * sizeof(double)) != 0) {
+			return false;
+		}
+	}
+	else if (!sameTail(exp)) {
+		for (auto left = tailConstBegin(), right = exp.tailConstBegin(); left != tailConstEnd(); ++left, ++right) {
+			if (!left->identical(*right)) {
+				return false;
+			}
+		}
+	}
+
+	for (auto & property : propertymap) {
+		auto other = exp.propertymap.get().find(property.first);
+		if (other == exp.propertymap.end() || !property.second.identical(other->second)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+std::size_t Expression::structuralHash() const {
+	std::size_t hash = hashAtom(m_head);
+	for (double value : m_packed) {
+		hash = hash * 31 + std::hash<double>()(value);
+	}
+	for (auto & element : boxedTail()) {
+		hash = hash * 31 + element.structuralHash();
+	}
+	for (auto & property : propertymap) {
+		hash = hash * 31 + std::hash<std::string>()(property.first);
+		hash = hash * 31 + property.second.structuralHash();
+	}
+	return hash;
+}
+
+bool operator!=(const Expression & left, const Expression & right){
 
   return !(left == right);
 }
 
-Expression  Expression::getValueInTail(unsigned int location) {
-	if (location >= m_tail.size()) {
+Expression  Expression::getValueInTail(unsigned int location) const {
+	if (location >= getTailLength()) {
 		throw SemanticError("Error during evaluation: attempt to redefine a previously defined symbol");
 	}
-	return m_tail[location];
+	if (!m_packed.empty()) {
+		return Expression(Atom(m_packed[location]));
+	}
+	return boxedTail()[location];
 }
 
-unsigned int Expression::getTailLength() {
-	return m_tail.size();
+unsigned int Expression::getTailLength() const {
+	if (m_primitives) {
+		return m_primitives->size();
+	}
+	return m_tail.size() + m_packed.size();
 }
 
-Expression Expression::getProperty(Atom & a) {
-	if (propertymap.find(a.asString()) != propertymap.end()) {
-		return propertymap.find(a.asString())->second;
+Expression Expression::getProperty(const Atom & a) const {
+	if (propertymap.get().find(a.asString()) != propertymap.end()) {
+		return propertymap.get().find(a.asString())->second;
 	}
 	else {
 		throw SemanticError("Error during evaluation: This property was not set for this expression");
 	}
 }
 
-bool Expression::checkProperty(Atom & a){
-	if (propertymap.find(a.asString()) != propertymap.end()) {
+bool Expression::checkProperty(const Atom & a) const {
+	if (propertymap.get().find(a.asString()) != propertymap.end()) {
 		return true;
 	}
 	else {
@@ -829,560 +1607,111 @@ bool Expression::checkProperty(Atom & a){
 
 }
 
-bool Expression::checkValidCoordinates(){
+bool Expression::coordinateBuffer(PlotBuffer & plot) const {
 
-	for (unsigned int i = 0; i < getTailLength(); i++) {
-		if (!getValueInTail(i).isHeadList()) {
+	plot.x.clear();
+	plot.y.clear();
+	plot.x.reserve(getTailLength());
+	plot.y.reserve(getTailLength());
+
+	// a list of numbers holds no points
+	if (!m_packed.empty()) {
+		return false;
+	}
+	for (const Expression & point : boxedTail()) {
+		if (!point.isHeadList() || point.getTailLength() != 2) {
 			return false;
 		}
-		else if (getValueInTail(i).getTailLength() != 2) {
-			return false;
+		if (!point.m_packed.empty()) {
+			plot.x.push_back(point.m_packed[0]);
+			plot.y.push_back(point.m_packed[1]);
+			continue;
 		}
-		else if (!(getValueInTail(i).m_tail[0].isHeadNumber() && getValueInTail(i).m_tail[1].isHeadNumber())) {
+		const std::vector<Expression> & coordinates = point.boxedTail();
+		if (!(coordinates[0].isHeadNumber() && coordinates[1].isHeadNumber())) {
 			return false;
 		}
+		plot.x.push_back(coordinates[0].head().asNumber());
+		plot.y.push_back(coordinates[1].head().asNumber());
 	}
 	return true;
 }
 
-std::list<Expression> Expression::handlePoints(double minX, double maxX ,double minY, double maxY) {
-	Expression xCoordinate;
-	Expression yCoordinate;
-	std::list<Expression> coordinateList;
-
-	Expression coordinate;
-	std::list<Expression> allCoordinates;
-	double xRange = maxX - minX;
-	double yRange = maxY - minY;
-
-	for (unsigned int i = 0; i < getTailLength(); i++) {
-		xCoordinate = Atom(((getValueInTail(i).m_tail[0].head().asNumber())/xRange)*20);
-		yCoordinate = Atom((-((getValueInTail(i).m_tail[1].head().asNumber()))/yRange)*20);
-		coordinateList.emplace_back(xCoordinate);
-		coordinateList.emplace_back(yCoordinate);
-		coordinate = coordinateList;
-		coordinate.propertymap.emplace(std::string("\"object-name\""), Expression(Atom(std::string("\"point\""))));
-		coordinate.propertymap.emplace(std::string("\"size\""), Expression(Atom(0.5)));
-		allCoordinates.emplace_back(coordinate);
-		coordinateList.clear();
-	}
-
-	return allCoordinates;
-}
-
-std::list<Expression> Expression::buildRect(double minX, double maxX, double minY, double maxY) {
-	Expression xCoordinate;
-	Expression yCoordinate;
-	std::list<Expression> coordinateList;
-	std::list<Expression> line;
-	Expression coordinate;
-	std::list<Expression> allCoordinates;
-	double xRange = maxX - minX;
-	double yRange = maxY - minY;
-
-	xCoordinate = Atom(((minX ) / xRange) * 20);
-	yCoordinate = Atom(-((minY ) / yRange) * 20);
-	coordinateList.emplace_back(xCoordinate);
-	coordinateList.emplace_back(yCoordinate);
-	coordinate = coordinateList;
-	line.emplace_back(coordinate);
-	coordinateList.clear();
-	xCoordinate = Atom(((minX ) / xRange) * 20);
-	yCoordinate = Atom(-((maxY ) / yRange) * 20);
-	coordinateList.emplace_back(xCoordinate);
-	coordinateList.emplace_back(yCoordinate);
-	coordinate = coordinateList;
-	line.emplace_back(coordinate);
-	coordinateList.clear();
-	coordinate = line;
-	coordinate.propertymap.emplace(std::string("\"object-name\""), Expression(Atom(std::string("\"line\""))));
-	coordinate.propertymap.emplace(std::string("\"thickness\""), Expression(Atom(0.0)));
-	allCoordinates.emplace_back(coordinate);
-	line.clear();
-
-	xCoordinate = Atom(((minX ) / xRange) * 20);
-	yCoordinate = Atom(-((minY ) / yRange) * 20);
-	coordinateList.emplace_back(xCoordinate);
-	coordinateList.emplace_back(yCoordinate);
-	coordinate = coordinateList;
-	line.emplace_back(coordinate);
-	coordinateList.clear();
-	xCoordinate = Atom(((maxX ) / xRange) * 20);
-	yCoordinate = Atom(-((minY ) / yRange) * 20);
-	coordinateList.emplace_back(xCoordinate);
-	coordinateList.emplace_back(yCoordinate);
-	coordinate = coordinateList;
-	line.emplace_back(coordinate);
-	coordinateList.clear();
-	coordinate = line;
-	coordinate.propertymap.emplace(std::string("\"object-name\""), Expression(Atom(std::string("\"line\""))));
-	coordinate.propertymap.emplace(std::string("\"thickness\""), Expression(Atom(0.0)));
-	allCoordinates.emplace_back(coordinate);
-	line.clear();
-
-	xCoordinate = Atom(((maxX ) / xRange) * 20);
-	yCoordinate = Atom(-((minY ) / yRange) * 20);
-	coordinateList.emplace_back(xCoordinate);
-	coordinateList.emplace_back(yCoordinate);
-	coordinate = coordinateList;
-	line.emplace_back(coordinate);
-	coordinateList.clear();
-	xCoordinate = Atom(((maxX ) / xRange) * 20);
-	yCoordinate = Atom(-((maxY ) / yRange) * 20);
-	coordinateList.emplace_back(xCoordinate);
-	coordinateList.emplace_back(yCoordinate);
-	coordinate = coordinateList;
-	line.emplace_back(coordinate);
-	coordinateList.clear();
-	coordinate = line;
-	coordinate.propertymap.emplace(std::string("\"object-name\""), Expression(Atom(std::string("\"line\""))));
-	coordinate.propertymap.emplace(std::string("\"thickness\""), Expression(Atom(0.0)));
-	allCoordinates.emplace_back(coordinate);
-	line.clear();
-
-	xCoordinate = Atom(((minX ) / xRange) * 20);
-	yCoordinate = Atom(-((maxY ) / yRange) * 20);
-	coordinateList.emplace_back(xCoordinate);
-	coordinateList.emplace_back(yCoordinate);
-	coordinate = coordinateList;
-	line.emplace_back(coordinate);
-	coordinateList.clear();
-	xCoordinate = Atom(((maxX ) / xRange) * 20);
-	yCoordinate = Atom(-((maxY ) / yRange) * 20);
-	coordinateList.emplace_back(xCoordinate);
-	coordinateList.emplace_back(yCoordinate);
-	coordinate = coordinateList;
-	line.emplace_back(coordinate);
-	coordinateList.clear();
-	coordinate = line;
-	coordinate.propertymap.emplace(std::string("\"object-name\""), Expression(Atom(std::string("\"line\""))));
-	coordinate.propertymap.emplace(std::string("\"thickness\""), Expression(Atom(0.0)));
-	allCoordinates.emplace_back(coordinate);
-	line.clear();
-
-	return allCoordinates;
-}
-
-std::list<Expression> Expression::buildOrigin(double minX, double maxX, double minY, double maxY) {
-	Expression xCoordinate;
-	Expression yCoordinate;
-	std::list<Expression> coordinateList;
-	std::list<Expression> line;
-	Expression coordinate;
-	std::list<Expression> allCoordinates;
-	double xRange = maxX - minX;
-	double yRange = maxY - minY;
-
-	if (minX <= 0 && maxX>=0) {
-		xCoordinate = Atom(((0 ) / xRange) * 20);
-		yCoordinate = Atom(-((minY ) / yRange) * 20);
-		coordinateList.emplace_back(xCoordinate);
-		coordinateList.emplace_back(yCoordinate);
-		coordinate = coordinateList;
-		line.emplace_back(coordinate);
-		coordinateList.clear();
-		xCoordinate = Atom(((0 ) / xRange) * 20);
-		yCoordinate = Atom(-((maxY ) / yRange) * 20);
-		coordinateList.emplace_back(xCoordinate);
-		coordinateList.emplace_back(yCoordinate);
-		coordinate = coordinateList;
-		line.emplace_back(coordinate);
-		coordinateList.clear();
-		coordinate = line;
-		coordinate.propertymap.emplace(std::string("\"object-name\""), Expression(Atom(std::string("\"line\""))));
-		coordinate.propertymap.emplace(std::string("\"thickness\""), Expression(Atom(0.0)));
-		allCoordinates.emplace_back(coordinate);
-		line.clear();
-	}
-
-	if (minY <= 0 && maxY>=0) {
-		xCoordinate = Atom(((minX ) / xRange) * 20);
-		yCoordinate = Atom(-((0 ) / yRange) * 20);
-		coordinateList.emplace_back(xCoordinate);
-		coordinateList.emplace_back(yCoordinate);
-		coordinate = coordinateList;
-		line.emplace_back(coordinate);
-		coordinateList.clear();
-		xCoordinate = Atom(((maxX ) / xRange) * 20);
-		yCoordinate = Atom(-((0 ) / yRange) * 20);
-		coordinateList.emplace_back(xCoordinate);
-		coordinateList.emplace_back(yCoordinate);
-		coordinate = coordinateList;
-		line.emplace_back(coordinate);
-		coordinateList.clear();
-		coordinate = line;
-		coordinate.propertymap.emplace(std::string("\"object-name\""), Expression(Atom(std::string("\"line\""))));
-		coordinate.propertymap.emplace(std::string("\"thickness\""), Expression(Atom(0.0)));
-		allCoordinates.emplace_back(coordinate);
-		line.clear();
-	}
-
-	return allCoordinates;
-}
-
-std::list<Expression> Expression::buildStems(double minX, double maxX, double minY, double maxY) {
-	Expression xCoordinate;
-	Expression yCoordinate;
-	std::list<Expression> coordinateList;
-	std::list<Expression> line;
-	Expression coordinate;
-	std::list<Expression> allCoordinates;
-	double xRange = maxX - minX;
-	double yRange = maxY - minY;
-	double bottom=0;
+// a point of the plot's square
+static Expression plotPoint(double x, double y) {
+	return Expression(std::vector<double>{x, y});
+}
 
-	for (unsigned int i = 0; i < getTailLength(); i++) {
-		if (getValueInTail(i).m_tail[1].head().asNumber() < 0) {
-			if (maxY < 0) {
-				bottom = maxY;
+std::vector<Expression> Expression::expandPlot(const PlotPrimitives & items) {
+	std::vector<Expression> result;
+	result.reserve(items.size());
+
+	// the items of each kind are taken in order, a run at a time
+	std::size_t point = 0, line = 0, text = 0;
+	for (const PlotPrimitives::Run & run : items.runs()) {
+		for (std::size_t i = 0; i < run.count; i++) {
+			if (run.kind == PlotPrimitives::PointKind) {
+				const PlotPoint & item = items.points()[point++];
+				Expression coordinate = plotPoint(item.x, item.y);
+				coordinate.propertymap.write().emplace(std::string("\"object-name\""), Expression(Atom(std::string("\"point\""))));
+				coordinate.propertymap.write().emplace(std::string("\"size\""), Expression(Atom(item.size)));
+				result.push_back(std::move(coordinate));
 			}
-		}
-		else {
-			if (minY > 0) {
-				bottom = minY;
+			else if (run.kind == PlotPrimitives::LineKind) {
+				const PlotLine & item = items.lines()[line++];
+				Expression segment(std::list<Expression>{plotPoint(item.x1, item.y1), plotPoint(item.x2, item.y2)});
+				segment.propertymap.write().emplace(std::string("\"object-name\""), Expression(Atom(std::string("\"line\""))));
+				segment.propertymap.write().emplace(std::string("\"thickness\""), Expression(Atom(item.thickness)));
+				result.push_back(std::move(segment));
+			}
+			else {
+				const PlotText & item = items.texts()[text++];
+				Expression myText = Atom(item.text);
+				myText.propertymap.write().emplace(std::string("\"object-name\""), Expression(Atom(std::string("\"text\""))));
+				myText.propertymap.write().emplace(std::string("\"position\""), plotPoint(item.x, item.y));
+				myText.propertymap.write().emplace(std::string("\"scale\""), Expression(Atom(item.scale)));
+				if (item.rotated) {
+					myText.propertymap.write().emplace(std::string("\"rotation\""), Expression(Atom(item.rotation)));
+				}
+				result.push_back(std::move(myText));
 			}
 		}
-		xCoordinate = Atom(((getValueInTail(i).m_tail[0].head().asNumber() ) / xRange) * 20);
-		yCoordinate = Atom(-((bottom ) / yRange) * 20);
-		coordinateList.emplace_back(xCoordinate);
-		coordinateList.emplace_back(yCoordinate);
-		coordinate = coordinateList;
-		line.emplace_back(coordinate);
-		coordinateList.clear();
-		xCoordinate = Atom(((getValueInTail(i).m_tail[0].head().asNumber() ) / xRange) * 20);
-		yCoordinate = Atom(-((getValueInTail(i).m_tail[1].head().asNumber() ) / yRange) * 20);
-		coordinateList.emplace_back(xCoordinate);
-		coordinateList.emplace_back(yCoordinate);
-		coordinate = coordinateList;
-		line.emplace_back(coordinate);
-		coordinateList.clear();
-		coordinate = line;
-		coordinate.propertymap.emplace(std::string("\"object-name\""), Expression(Atom(std::string("\"line\""))));
-		coordinate.propertymap.emplace(std::string("\"thickness\""), Expression(Atom(0.0)));
-		allCoordinates.emplace_back(coordinate);
-		line.clear();
-	}
-
-	return allCoordinates;
-}
-
-std::list<Expression> Expression::listAxis(double minX, double maxX, double minY, double maxY, double textScale) {
-
-	Expression xPoint;
-	Expression yPoint;
-	std::list<Expression> textPoint;
-	Expression myPoint;
-	Expression myText;
-	std::list<Expression> axisLabels;
-	std::stringstream myPrecisionXmin;
-	std::stringstream myPrecisionXmax;
-	std::stringstream myPrecisionYmin;
-	std::stringstream myPrecisionYmax;
-
-	double minX1 = (minX) / (maxX - minX) * 20;
-	double maxX1 = (maxX) / (maxX - minX) * 20;
-	double minY1 = (minY) / (maxY - minY) * 20;
-	double maxY1 = (maxY) / (maxY - minY) * 20;
-
-
-	myPrecisionXmin << std::setprecision(2) << minX;
-	myPrecisionXmax << std::setprecision(2) << maxX;
-	myPrecisionYmin << std::setprecision(2) << minY;
-	myPrecisionYmax << std::setprecision(2) << maxY;
-
-	xPoint = Atom(minX1);
-	textPoint.emplace_back(xPoint);
-	yPoint = Atom(-minY1+2);
-	textPoint.emplace_back(yPoint);
-	myPoint = textPoint;
-	myText = Atom(std::string("\"") + myPrecisionXmin.str() + std::string("\""));
-	myText.propertymap.emplace(std::string("\"object-name\""), Expression(Atom(std::string("\"text\""))));
-	myText.propertymap.emplace(std::string("\"position\""), myPoint);
-	myText.propertymap.emplace(std::string("\"scale\""), Expression(Atom(textScale)));
-	textPoint.clear();
-	axisLabels.emplace_back(myText);
-
-
-	xPoint = Atom(minX1-2);
-	textPoint.emplace_back(xPoint);
-	yPoint = Atom(-minY1);
-	textPoint.emplace_back(yPoint);
-	myPoint = textPoint;
-	myText = Atom(std::string("\"") + myPrecisionYmin.str() + std::string("\""));
-	myText.propertymap.emplace(std::string("\"object-name\""), Expression(Atom(std::string("\"text\""))));
-	myText.propertymap.emplace(std::string("\"position\""), myPoint);
-	myText.propertymap.emplace(std::string("\"scale\""), Expression(Atom(textScale)));
-	textPoint.clear();
-	axisLabels.emplace_back(myText);
-
-
-	xPoint = Atom(minX1 - 2);
-	textPoint.emplace_back(xPoint);
-	yPoint = Atom(-maxY1);
-	textPoint.emplace_back(yPoint);
-	myPoint = textPoint;
-	myText = Atom(std::string("\"") + myPrecisionYmax.str() + std::string("\""));
-	myText.propertymap.emplace(std::string("\"object-name\""), Expression(Atom(std::string("\"text\""))));
-	myText.propertymap.emplace(std::string("\"position\""), myPoint);
-	myText.propertymap.emplace(std::string("\"scale\""), Expression(Atom(textScale)));
-	textPoint.clear();
-	axisLabels.emplace_back(myText);
-
-
-	xPoint = Atom(maxX1);
-	textPoint.emplace_back(xPoint);
-	yPoint = Atom(-minY1+2);
-	textPoint.emplace_back(yPoint);
-	myPoint = textPoint;
-	myText = Atom(std::string("\"") + myPrecisionXmax.str() + std::string("\""));
-	myText.propertymap.emplace(std::string("\"object-name\""), Expression(Atom(std::string("\"text\""))));
-	myText.propertymap.emplace(std::string("\"position\""), myPoint);
-	myText.propertymap.emplace(std::string("\"scale\""), Expression(Atom(textScale)));
-	textPoint.clear();
-	axisLabels.emplace_back(myText);
-	return axisLabels;
-}
-
-std::list<Expression> Expression::listLabels(double minX, double maxX, double minY, double maxY, double textScale) {
-
-	std::list<Expression> resultList;
-	std::list<Expression> buildList;
+	}
+
+	return result;
+}
+
+void Expression::listLabels(const PlotBuffer & plot, double textScale, PlotPrimitives & items) const {
+
 	std::string title;
 	std::string xAxis;
 	std::string yAxis;
 	for (unsigned int i = 0; i < getTailLength(); i++) {
-		if (m_tail[i].m_tail[0].head().asString() == "\"title\"") {
-			if (!m_tail[i].m_tail[1].isHeadString()) {
+		if (getValueInTail(i).getValueInTail(0).head().asString() == "\"title\"") {
+			if (!getValueInTail(i).getValueInTail(1).isHeadString()) {
 
 			}
 			else {
-				title = m_tail[i].m_tail[1].head().asString();
+				title = getValueInTail(i).getValueInTail(1).head().asString();
 
 			}
 		}
-		if (m_tail[i].m_tail[0].head().asString() == "\"abscissa-label\"") {
-			if (!m_tail[i].m_tail[1].isHeadString()) {
+		if (getValueInTail(i).getValueInTail(0).head().asString() == "\"abscissa-label\"") {
+			if (!getValueInTail(i).getValueInTail(1).isHeadString()) {
 
 			}
 			else {
-				xAxis = m_tail[i].m_tail[1].head().asString();
+				xAxis = getValueInTail(i).getValueInTail(1).head().asString();
 			}
 		}
-		if (m_tail[i].m_tail[0].head().asString() == "\"ordinate-label\"") {
-			if (!m_tail[i].m_tail[1].isHeadString()) {
+		if (getValueInTail(i).getValueInTail(0).head().asString() == "\"ordinate-label\"") {
+			if (!getValueInTail(i).getValueInTail(1).isHeadString()) {
 
 			}
 			else {
-				yAxis = m_tail[i].m_tail[1].head().asString();
+				yAxis = getValueInTail(i).getValueInTail(1).head().asString();
 			}
 		}
 	}
-	if (title.length() != 0) {
-		buildList.emplace_back(Expression(Atom(((minX) / (maxX - minX) * 20) + 10)));
-		buildList.emplace_back(Expression(Atom((-(maxY) / (maxY - minY) * 20) - 3)));
-		Expression builderTitle(buildList);
-		buildList.clear();
-		Expression myText = Atom(title);
-		myText.propertymap.emplace(std::string("\"object-name\""), Expression(Atom(std::string("\"text\""))));
-		myText.propertymap.emplace(std::string("\"scale\""), Expression(Atom(textScale)));
-		myText.propertymap.emplace(std::string("\"position\""), builderTitle);
-		resultList.emplace_back(myText);
-	}
-	if (xAxis.length() != 0) {
-		buildList.emplace_back(Expression(Atom(((minX) / (maxX - minX) * 20) + 10)));
-		buildList.emplace_back(Expression(Atom((-(minY) / (maxY - minY) * 20) + 3)));
-		Expression builderTitle(buildList);
-		buildList.clear();
-		Expression myText = Atom(xAxis);
-		myText.propertymap.emplace(std::string("\"object-name\""), Expression(Atom(std::string("\"text\""))));
-		myText.propertymap.emplace(std::string("\"scale\""), Expression(Atom(textScale)));
-		myText.propertymap.emplace(std::string("\"position\""), builderTitle);
-		resultList.emplace_back(myText);
-	}
-	if (yAxis.length() != 0) {
-		buildList.emplace_back(Expression(Atom(((minX) / (maxX - minX) * 20) - 3)));
-		buildList.emplace_back(Expression(Atom((-(minY) / (maxY - minY) * 20) - 10)));
-		Expression builderTitle(buildList);
-		buildList.clear();
-		Expression myText = Atom(yAxis);
-		myText.propertymap.emplace(std::string("\"object-name\""), Expression(Atom(std::string("\"text\""))));
-		myText.propertymap.emplace(std::string("\"scale\""), Expression(Atom(textScale)));
-		myText.propertymap.emplace(std::string("\"rotation\""), Expression(Atom((std::atan2(-1, 0)))));
-		myText.propertymap.emplace(std::string("\"position\""), builderTitle);
-		resultList.emplace_back(myText);
-	}
-	return resultList;
-}
-
-std::list<Expression>  Expression::buildLines(double minX, double maxX, double minY, double maxY) {
-	
-	std::list<Expression> resultList;
-	std::vector<Expression> adjustedX;
-	std::vector<Expression> adjustedY;
-	Expression firstLineCoordinate;
-	Expression secondLineCoordinate;
-	Expression xPointCoordinate;
-	Expression yPointCoordinate;
-	std::list<Expression> pointList;
-	std::list<Expression> lineList;
-	Expression line;
-	Expression point;
-	std::vector<Expression> myPoints;
-	for (unsigned int i = 0; i < getTailLength(); i++) {
-		adjustedX.emplace_back(Expression(Atom(m_tail[i].m_tail[0].head().asNumber() / (maxX - minX) * 20)));
-		adjustedY.emplace_back(Expression(Atom(-m_tail[i].m_tail[1].head().asNumber() / (maxY - minY) * 20)));
-	}
-	for (unsigned int i = 0; i < adjustedX.size(); i++) {
-		xPointCoordinate= adjustedX[i];
-		yPointCoordinate= adjustedY[i];
-		pointList.emplace_back(xPointCoordinate);
-		pointList.emplace_back(yPointCoordinate);
-		point = pointList;
-		myPoints.emplace_back(point);
-		pointList.clear();
-	}
-
-	for (unsigned int i = 0; i <myPoints.size()-1; i++) {
-		firstLineCoordinate =myPoints[i];
-		secondLineCoordinate = myPoints[i+1];
-		lineList.emplace_back(firstLineCoordinate);
-		lineList.emplace_back(secondLineCoordinate);
-		line = lineList;
-		line.propertymap.emplace(std::string("\"object-name\""), Expression(Atom(std::string("\"line\""))));
-		line.propertymap.emplace(std::string("\"thickness\""), Expression(Atom(0.0)));
-		resultList.emplace_back(line);
-		lineList.clear();
-	}
-
-	return resultList;
-}
-
-Expression Expression::fixAngles(double count, Expression function, Environment env) {
-	if (count < 1) {
-		std::list<Expression> resultList;
-		double point1x;
-		double point2x;
-		double point3x;
-		double point1y;
-		double point2y;
-		double point3y;
-		double angle;
-		double newPoint1x;
-		double newPoint1y;
-		double newPoint2x;
-		double newPoint2y;
-
-		double p12;
-		double p13;
-		double p23;
-		Expression myList(Atom(std::string("list")));
-		Expression myMap(Atom(std::string("map")));
-		resultList.emplace_back(m_tail[0]);
-		for (unsigned int i = 1; i < getTailLength() - 1; i++) {
-
-			point1x = m_tail[i - 1].m_tail[0].head().asNumber();
-			point2x = m_tail[i].m_tail[0].head().asNumber();
-			point3x = m_tail[i + 1].m_tail[0].head().asNumber();
-			point1y = m_tail[i - 1].m_tail[1].head().asNumber();
-			point2y = m_tail[i].m_tail[1].head().asNumber();
-			point3y = m_tail[i + 1].m_tail[1].head().asNumber();
-
-			p12 = sqrt(pow((point1x - point2x),2) + pow((point1y - point2y), 2));
-			p13 = sqrt(pow((point1x - point3x), 2) + pow((point1y - point3y), 2));
-			p23 = sqrt(pow((point3x - point2x), 2) + pow((point3y - point2y), 2));
-
-			angle = acos((pow(p12, 2) + pow(p23, 2) - pow(p13, 2)) / (2 * p12*p23));
-
-			angle = angle * 180 / (std::atan2(0, -1));
-
-			if (angle < 175) {
-
-				newPoint1x = point2x + (point1x - point2x)/2;
-				newPoint2x = point2x - (point2x - point3x)/2;
-
-				myList.m_tail.emplace_back(Expression(Atom(newPoint1x)));
-				myList.m_tail.emplace_back(Expression(Atom(newPoint2x)));
-				myMap.m_tail.emplace_back(function);
-				myMap.m_tail.emplace_back(myList);
-
-				Expression yPoints(myMap.eval(env));
-
-				newPoint1y = yPoints.m_tail[0].head().asNumber();
-				newPoint2y = yPoints.m_tail[1].head().asNumber();
-				Expression point1(Atom(std::string("list")));
-				Expression point2(Atom(std::string("list")));
-				point1.m_tail.emplace_back(newPoint1x);
-				point1.m_tail.emplace_back(newPoint1y);
-				point2.m_tail.emplace_back(newPoint2x);
-				point2.m_tail.emplace_back(newPoint2y);
-				resultList.emplace_back(point1.eval(env));
-				resultList.emplace_back(m_tail[i]);
-				resultList.emplace_back(point2.eval(env));
-				myList.m_tail.clear();
-				myMap.m_tail.clear();
-
-				m_tail.insert(m_tail.begin() + i+1, point2.eval(env));
-				i++;
-			}
-			else {
-				resultList.emplace_back(m_tail[i]);
-			}
-		}
-
-		resultList.emplace_back(m_tail[getTailLength()-1]);
-		Expression myResult(resultList);
-
-		myResult = myResult.fixAngles(count + 1, function, env);
-		return myResult;
-	}
-	return *this;
-}
-
-double Expression::getMinX() {
-
-	double lastX = getValueInTail(0).m_tail[0].head().asNumber();
-	double X;
-	for (unsigned int i = 1; i < getTailLength(); i++) {
-		X = getValueInTail(i).m_tail[0].head().asNumber();
-		if (X < lastX) {
-			lastX = X;
-		}
-	}
-	return lastX;
-}
-
-double Expression::getMaxX() {
-	double lastX = getValueInTail(0).m_tail[0].head().asNumber();
-	double X;
-	for (unsigned int i = 1; i < getTailLength(); i++) {
-		X = getValueInTail(i).m_tail[0].head().asNumber();
-		if (X > lastX) {
-			lastX = X;
-		}
-	}
-	return lastX;
-}
-
-double Expression::getMinY() {
-	double lastY = getValueInTail(0).m_tail[1].head().asNumber();
-	double Y;
-	for (unsigned int i = 1; i < getTailLength(); i++) {
-		Y = getValueInTail(i).m_tail[1].head().asNumber();
-		if (Y < lastY) {
-			lastY = Y;
-		}
-	}
-	return lastY;
+	plot.addLabels(items, title, xAxis, yAxis, textScale);
 }
-
-double Expression::getMaxY() {
-	double lastY = getValueInTail(0).m_tail[1].head().asNumber();
-	double Y;
-	for (unsigned int i = 1; i < getTailLength(); i++) {
-		Y = getValueInTail(i).m_tail[1].head().asNumber();
-		if (Y > lastY) {
-			lastY = Y;
-		}
-	}
-	return lastY;
-}
\ No newline at end of file
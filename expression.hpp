@@ -4,25 +4,60 @@ Defines the Expression type and assiciated functions.
 #ifndef EXPRESSION_HPP
 #define EXPRESSION_HPP
 
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <list>
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
+#include <unordered_map>
 
 #include "token.hpp"
 #include "atom.hpp"
+#include "shared_container.hpp"
 
 // forward declare Environment
 class Environment;
+
+// forward declare PlotBuffer and PlotPrimitives
+struct PlotBuffer;
+class PlotPrimitives;
+
+// forward declare Procedure, defined with Environment
+class Expression;
+typedef Expression (*Procedure)(const std::vector<Expression> & args);
+
+/*! \typedef SpecialForm
+\brief A special-form evaluates a form whose operands are not evaluated
+       first, as the evaluator does for begin, define and lambda.
+\param form the expression whose head names the special-form
+\param env the environment to evaluate in
+*/
+typedef Expression (*SpecialForm)(const Expression & form, Environment & env);
+
 /*! \class Expression
 \brief An expression is a tree of Atoms.
 
 An expression is an atom called the head followed by a (possibly empty) 
 list of expressions called the tail.
+
+The tail and the property map are copy-on-write: copying an Expression is
+O(1) and shares both with the original until one of the copies is modified.
+
+A List whose elements are all plain numbers is stored packed, as contiguous
+doubles rather than one Expression node per element. Packed lists behave
+like any other List through the tail accessors and iterators.
+
+The List returned by a plot special-form holds its items as PlotPrimitives,
+which are converted to Expression nodes the first time the tail is read.
  */
 class Expression {
 public:
 
-  typedef std::vector<Expression>::const_iterator ConstIteratorType;
+  /// const random-access iterator over the tail, packed or not
+  class ConstIteratorType;
 
   /// Default construct and Expression, whose type in NoneType
   Expression();
@@ -33,23 +68,56 @@ public:
   Expression(const Atom & a);
 
   /*! Construct an Expression with given list of Expressions 
-  as a tail and true boolean as head
+  as a tail and true boolean as head, packed if all are plain numbers
   \param list of expression to make the tail
   */
   Expression(const std::list<Expression> & a);
 
+  /// Construct a List Expression, moving the given Expressions into the tail
+  Expression(std::list<Expression> && a);
+
+  /// Construct a packed List Expression holding the given numbers
+  explicit Expression(std::vector<double> && values);
+
+  /// Construct a List Expression of the items of a plot
+  explicit Expression(std::shared_ptr<const PlotPrimitives> items);
+
   /*! Construct an Expression with given vector of Expressions
-  as a tail and string lambda as head
+  as a tail and lambda as head, the parameter list and body of a
+  closure that captured nothing
   \param vector of expression to make the tail
   */
   Expression(const std::vector<Expression> & a);
 
-  /// deep-copy construct an expression (recursive)
+  /// Construct a Lambda Expression, moving the given Expressions into the tail
+  Expression(std::vector<Expression> && a);
+
+  /// Construct an Expression with the given head, moving the given Expressions into the tail
+  Expression(const Atom & head, std::vector<Expression> && tail);
+
+  /// copy construct an expression, sharing the tail and properties
   Expression(const Expression & a);
 
-  /// deep-copy assign an expression  (recursive)
+  /// copy assign an expression, sharing the tail and properties
   Expression & operator=(const Expression & a);
 
+  /// move-construct an expression, taking ownership of the tail
+  Expression(Expression && a) noexcept;
+
+  /// move-assign an expression, taking ownership of the tail
+  Expression & operator=(Expression && a) noexcept;
+
+  /// destroy an expression, releasing deeply nested tails without recursion
+  ~Expression();
+
+  /// number of Expression nodes copied since the last reset, including
+  /// the elements copied when a shared tail is detached for writing;
+  /// always 0 when NDEBUG is defined, as copies are then not counted
+  static std::size_t copyCount() noexcept;
+
+  /// reset the copy counter to zero
+  static void resetCopyCount() noexcept;
+
   /// return a reference to the head Atom
   Atom & head();
 
@@ -59,14 +127,18 @@ public:
   /// append Atom to tail of the expression
   void append(const Atom & a);
 
+  /// append Atom to tail of the expression, moving it
+  void append(Atom && a);
+
   /// return a pointer to the last expression in the tail, or nullptr
   Expression * tail();
 
-  /// return a const-iterator to the beginning of tail
-  ConstIteratorType tailConstBegin() const noexcept;
+  /// return a const-iterator to the beginning of tail, converting the
+  /// items of a plot to Expressions on first use
+  ConstIteratorType tailConstBegin() const;
 
   /// return a const-iterator to the tail end
-  ConstIteratorType tailConstEnd() const noexcept;
+  ConstIteratorType tailConstEnd() const;
 
   /// convienience member to determine if head atom is a number
   bool isHeadNumber() const noexcept;
@@ -86,23 +158,116 @@ public:
   /// convienience member to determine if head atom is a lambda
   bool isHeadString() const noexcept;
 
+  /// determine if this is a number without tail or properties
+  bool isPlainNumber() const noexcept;
+
+  /// determine if the tail is stored as packed numbers
+  bool isPacked() const noexcept;
+
+  /// return the packed numbers of the tail, empty unless isPacked()
+  const std::vector<double> & packedValues() const noexcept;
+
+  /// return the items of a plot, or nullptr if the tail is not a plot's
+  const PlotPrimitives * plotPrimitives() const noexcept;
+
   /// Evaluate expression using a post-order traversal (recursive)
-  Expression eval(Environment & env);
+  Expression eval(Environment & env) const;
+
+  /*! Register a special-form. A form whose head is name is then evaluated
+    by it rather than as a procedure call, by every engine. Registering a
+    name again replaces the special-form; registering nullptr removes it.
+    Registration must not race with evaluation on another thread.
+    \param name the name of the special-form
+    \param form the function evaluating the form
+  */
+  static void registerSpecialForm(const std::string & name, SpecialForm form);
+
+  /// determine if an interned symbol names a special-form, built-in or registered
+  static bool isSpecialForm(SymbolId id) noexcept;
+
+  /*! Make the value of a lambda special-form. References to the parameters
+    in the body are resolved to Parameter atoms naming their slot in the
+    call frame.
+    \param parameters the parameter list of the lambda
+    \param body the body of the lambda
+    \return the Lambda Expression, a closure that captured nothing
+  */
+  static Expression makeLambda(const Expression & parameters, const Expression & body);
+
+  /*! Close a lambda value over the call frames of the environment it is
+    made in.
+    \param env the environment the lambda special-form is evaluated in
+    \return the lambda capturing the bindings of env's call frames, or a
+    copy of this lambda if env is the global environment
+  */
+  Expression closedOver(const Environment & env) const;
+
+  /*! Prepare a call of the lambda bound to head, binding its parameters
+    to the evaluated arguments.
+    \param head the symbol naming the lambda in env
+    \param args the evaluated arguments, moved into the result
+    \param env the calling environment
+    \param body set to the body of the lambda
+    \return the environment to evaluate body in
+    \throws SemanticError if the number of arguments is wrong
+  */
+  static Environment bindLambdaCall(const Atom & head, std::vector<Expression> & args,
+                                    const Environment & env, Expression & body);
+
+  /// as bindLambdaCall, for a lambda value rather than a name
+  static Environment bindLambda(const Expression & lambda, std::vector<Expression> & args,
+                                const Environment & env, Expression & body);
+
+  /*! Call a lambda value, through the memo cache when it is memoized.
+    \param lambda the lambda value
+    \param args the evaluated arguments, moved into the call frame
+    \param env the calling environment
+    \return the value of the call
+    \throws SemanticError if the number of arguments is wrong
+  */
+  static Expression callLambda(const Expression & lambda, std::vector<Expression> & args,
+                               Environment & env);
+
+  /*! Call a procedure on each element of an evaluated list, as pmap does.
+    \param name the procedure operand of the form
+    \param proc the builtin it names, or nullptr to call lambda
+    \param lambda the lambda value called when proc is nullptr
+    \param list the List of arguments
+    \param env the calling environment, whose executor runs the calls
+    \return the List of results
+    \throws SemanticError if a call raises one
+  */
+  static Expression parallelMap(const Atom & name, Procedure proc, const Expression & lambda,
+                                const Expression & list, Environment & env);
+
+  /// fold an evaluated list from initial, as preduce does, see parallelMap
+  static Expression parallelReduce(const Atom & name, Procedure proc, const Expression & lambda,
+                                   const Expression & initial, const Expression & list, Environment & env);
+
+  /// determine if pmap and preduce split size elements between threads
+  static bool runsInParallel(const Environment & env, std::size_t size);
 
   /// equality comparison for two expressions (recursive)
-  bool operator==(const Expression & exp) const noexcept;
+  bool operator==(const Expression & exp) const;
+
+  /// determine if exp has the same structure and properties, numbers
+  /// compared exactly and lambdas by their closures (recursive)
+  bool identical(const Expression & exp) const;
+
+  /// hash of the structure, equal for identical expressions (recursive)
+  std::size_t structuralHash() const;
 
   /// function that gives expression in tail at specified location
-  Expression  getValueInTail(unsigned int location);
+  Expression  getValueInTail(unsigned int location) const;
 
   /// function that gives size of tail
-  unsigned  int getTailLength();
+  unsigned  int getTailLength() const;
 
   ///function that returns property paired with atom
-  Expression getProperty(Atom & a);
+  Expression getProperty(const Atom & a) const;
 
   ///function that checks if there is property paired with atom
-  bool checkProperty(Atom & a);
+  bool checkProperty(const Atom & a) const;
 
 private:
 
@@ -110,50 +275,134 @@ private:
   Atom m_head;
 
   // the tail list is expressed as a vector for access efficiency
-  // and cache coherence, at the cost of wasted memory.
-  std::vector<Expression> m_tail;
+  // and cache coherence, at the cost of wasted memory. It is shared
+  // between copies and only cloned when written through write().
+  SharedContainer<std::vector<Expression> > m_tail;
 
-  std::map<std::string, Expression> propertymap;
+  SharedContainer<std::map<std::string, Expression> > propertymap;
 
-  // convenience typedef
-  typedef std::vector<Expression>::iterator IteratorType;
+  // the tail of a packed List, used instead of m_tail when not empty
+  SharedContainer<std::vector<double> > m_packed;
+
+  // the items of a plot, used instead of m_tail when set
+  std::shared_ptr<const PlotPrimitives> m_primitives;
+
+  // counts copy-constructions and copy-assignments of Expression nodes for
+  // the tests; optimized builds skip it, as the threads of pmap would
+  // contend for it on every copy
+  static std::atomic<std::size_t> nodeCopies;
   
   // internal helper methods
 
+  // empty the tail and return its elements as Expression nodes
+  std::vector<Expression> takeElements();
 
-  //Handle Special Expression
-  Expression handle_lookup(const Atom & head, const Environment & env);
-  Expression handle_define(Environment & env);
-  Expression handle_begin(Environment & env);
-  Expression handle_lambda(Environment & env);
-  Expression handle_apply(Environment & env);
-  Expression handle_map(Environment & env);
-  Expression handle_set_property(Environment & env);
-  Expression handle_get_property(Environment & env);
-  Expression handle_discrete_plot(Environment & env);
-  Expression handle_continuous_plot(Environment & env);
+  // convert a packed tail or the items of a plot to Expression nodes
+  void unpack();
+
+  // the tail as Expression nodes, converting the items of a plot once;
+  // empty for a packed tail
+  const std::vector<Expression> & boxedTail() const;
+
+  // determine if the tails are the same storage, and so equal
+  bool sameTail(const Expression & exp) const noexcept;
+
+  // the special-forms, indexed by the interned id of their names
+  static std::vector<SpecialForm> & specialForms();
+
+  // replace the references to slots in node, sharing unchanged subtrees
+  static bool resolveParameters(Expression & node, const std::unordered_map<SymbolId, std::uint32_t> & slots);
 
 
+  //Handle Special Expression
+  Expression handle_lookup(const Atom & head, const Environment & env) const;
+  Expression handle_define(Environment & env) const;
+  Expression handle_begin(Environment & env) const;
+  Expression handle_lambda(Environment & env) const;
+  Expression handle_apply(Environment & env) const;
+  Expression handle_map(Environment & env) const;
+  Expression handle_set_property(Environment & env) const;
+  Expression handle_get_property(Environment & env) const;
+  Expression handle_discrete_plot(Environment & env) const;
+  Expression handle_continuous_plot(Environment & env) const;
+  Expression handle_memoize(Environment & env) const;
+  Expression handle_pmap(Environment & env) const;
+  Expression handle_preduce(Environment & env) const;
+
+
+  // find the builtin or lambda named, or returned by a lambda call, by the
+  // first operand of map or apply;
+  // return false if it is neither, or true leaving both unset for a lambda form
+  bool procedureArgument(Environment & env, Procedure & proc, Expression & lambda) const;
+
+  // call a builtin procedure, or else the lambda, with evaluated arguments
+  static Expression callProcedure(Procedure proc, const Expression & lambda,
+                                  std::vector<Expression> & args, Environment & env);
+
   //Help with Creating Plots
-  bool checkValidCoordinates();
-  std::list<Expression> handlePoints(double minX, double maxX, double minY, double maxY);
-  std::list<Expression> buildRect(double minX, double maxX, double minY, double maxY);
-  std::list<Expression> buildOrigin(double minX, double maxX, double minY, double maxY);
-  std::list<Expression> buildStems(double minX, double maxX, double minY, double maxY);
-  std::list<Expression> listAxis(double minX, double maxX, double minY, double maxY, double textScale);
-  std::list<Expression> listLabels(double minX, double maxX, double minY, double maxY, double textScale);
-  std::list<Expression> buildLines(double minX, double maxX, double minY, double maxY);
-  Expression fixAngles(double count, Expression function, Environment env);
-  double getMinX();
-  double getMaxX();
-  double getMaxY();
-  double getMinY();
+
+  // gather the coordinates of a list of points into plot, returning false
+  // if an element is not a list of two numbers
+  bool coordinateBuffer(PlotBuffer & plot) const;
+
+  // the items of a plot as Expression nodes
+  static std::vector<Expression> expandPlot(const PlotPrimitives & items);
+
+  // add the title and axis labels named by a list of plot options
+  void listLabels(const PlotBuffer & plot, double textScale, PlotPrimitives & items) const;
+};
+
+class Expression::ConstIteratorType {
+public:
+
+  typedef std::random_access_iterator_tag iterator_category;
+  typedef Expression value_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef const Expression * pointer;
+  typedef const Expression & reference;
+
+  ConstIteratorType() noexcept;
+  ConstIteratorType(const ConstIteratorType & other) noexcept;
+  ConstIteratorType & operator=(const ConstIteratorType & other) noexcept;
+
+  /// the referenced element; for packed lists it is only valid until
+  /// the iterator is next dereferenced, moved or destroyed
+  reference operator*() const;
+  pointer operator->() const;
+  Expression operator[](difference_type n) const;
+
+  ConstIteratorType & operator++() noexcept;
+  ConstIteratorType operator++(int) noexcept;
+  ConstIteratorType & operator--() noexcept;
+  ConstIteratorType operator--(int) noexcept;
+  ConstIteratorType & operator+=(difference_type n) noexcept;
+  ConstIteratorType & operator-=(difference_type n) noexcept;
+  ConstIteratorType operator+(difference_type n) const noexcept;
+  ConstIteratorType operator-(difference_type n) const noexcept;
+  difference_type operator-(const ConstIteratorType & other) const noexcept;
+
+  bool operator==(const ConstIteratorType & other) const noexcept;
+  bool operator!=(const ConstIteratorType & other) const noexcept;
+  bool operator<(const ConstIteratorType & other) const noexcept;
+
+private:
+  friend class Expression;
+
+  explicit ConstIteratorType(const Expression * boxed) noexcept;
+  explicit ConstIteratorType(const double * packed) noexcept;
+
+  // exactly one of these is set for a valid iterator
+  const Expression * m_boxed;
+  const double * m_packed;
+
+  // a packed element materialized on dereference
+  mutable Expression m_value;
 };
 
 /// Render expression to output stream
 std::ostream & operator<<(std::ostream & out, const Expression & exp);
 
 /// inequality comparison for two expressions (recursive)
-bool operator!=(const Expression & left, const Expression & right) noexcept;
+bool operator!=(const Expression & left, const Expression & right);
   
 #endif
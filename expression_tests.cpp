@@ -75,4 +75,89 @@ TEST_CASE("Test lambda expression", "[expression]") {
 	REQUIRE(!myExp.isHeadComplex());
 	REQUIRE(!myExp.isHeadList());
 	REQUIRE(myExp.isHeadLambda());
-}
\ No newline at end of file
+}
+
+TEST_CASE("Test copy-on-write expression copies", "[expression]") {
+
+	std::list<Expression> elements;
+	for (int i = 0; i < 1000; i++) {
+		elements.emplace_back(Atom(double(i)));
+	}
+	Expression original(elements);
+
+	// copying a large list copies only the one node
+	Expression::resetCopyCount();
+	Expression copy(original);
+#ifndef NDEBUG
+	REQUIRE(Expression::copyCount() == 1);
+#endif
+	REQUIRE(copy == original);
+
+	// writing to the copy detaches it and leaves the original unchanged
+	copy.append(Atom(1000.0));
+	REQUIRE(copy.getTailLength() == 1001);
+	REQUIRE(original.getTailLength() == 1000);
+	REQUIRE(copy != original);
+
+	// the original is still writable on its own
+	original.append(Atom(-1.0));
+	REQUIRE(original.getValueInTail(1000) == Expression(Atom(-1.0)));
+	REQUIRE(copy.getValueInTail(1000) == Expression(Atom(1000.0)));
+}
+
+TEST_CASE("Test packed list expression", "[expression]") {
+
+	std::list<Expression> numbers = {Expression(1.0), Expression(2.0), Expression(3.0)};
+	Expression packed(numbers);
+
+	REQUIRE(packed.isHeadList());
+	REQUIRE(packed.isPacked());
+	REQUIRE(packed.packedValues() == std::vector<double>({1.0, 2.0, 3.0}));
+	REQUIRE(packed.getTailLength() == 3);
+	REQUIRE(packed.getValueInTail(1) == Expression(2.0));
+
+	// iterating a packed list yields number expressions
+	double sum = 0;
+	for (auto e = packed.tailConstBegin(); e != packed.tailConstEnd(); ++e) {
+		REQUIRE(e->isHeadNumber());
+		sum += e->head().asNumber();
+	}
+	REQUIRE(sum == 6.0);
+	REQUIRE(packed.tailConstEnd() - packed.tailConstBegin() == 3);
+
+	// packed and unpacked lists with equal elements compare equal
+	std::list<Expression> mixed = {Expression(1.0), Expression(Atom("a"))};
+	Expression boxed(mixed);
+	REQUIRE(!boxed.isPacked());
+	REQUIRE(Expression(std::vector<double>({1.0, 2.0, 3.0})) == packed);
+
+	// appending a non-number unpacks the list
+	packed.append(Atom("a"));
+	REQUIRE(!packed.isPacked());
+	REQUIRE(packed.getTailLength() == 4);
+	REQUIRE(packed.getValueInTail(0) == Expression(1.0));
+}
+
+TEST_CASE("Test identical expressions", "[expression]") {
+
+	Expression packed(std::vector<double>({1.0, 2.0, 3.0}));
+	Expression copy(std::vector<double>({1.0, 2.0, 3.0}));
+	REQUIRE(packed.identical(copy));
+	REQUIRE(packed.structuralHash() == copy.structuralHash());
+
+	// numbers are compared exactly, unlike ==
+	Expression sum(0.1 + 0.2);
+	REQUIRE(sum == Expression(0.3));
+	REQUIRE(!sum.identical(Expression(0.3)));
+	REQUIRE(!Expression(0.0).identical(Expression(-0.0)));
+
+	// packed and unpacked lists with the same elements are identical
+	std::list<Expression> nested = {Expression(1.0), packed};
+	Expression list(nested);
+	copy.append(Atom(4.0));
+	std::list<Expression> other = {Expression(1.0), copy};
+	REQUIRE(!list.identical(Expression(other)));
+	REQUIRE(list.identical(Expression(nested)));
+	REQUIRE(list.structuralHash() == Expression(nested).structuralHash());
+	REQUIRE(!Expression(Atom("a")).identical(Expression(Atom(1.0))));
+}
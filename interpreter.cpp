@@ -3,26 +3,122 @@
 // system includes
 #include <stdexcept>
 #include <iostream>
+#include <iterator>
+#include <string>
 
 // module includes
+#include "ast_cache.hpp"
 #include "token.hpp"
 #include "parse.hpp"
 #include "expression.hpp"
 #include "environment.hpp"
 #include "semantic_error.hpp"
 
+Interpreter::Interpreter(): m_executor(std::make_shared<Executor>()){
+  env.setExecutor(m_executor);
+}
 
 bool Interpreter::parseStream(std::istream & expression) noexcept{
 
-  TokenSequenceType tokens = tokenize(expression);
+  std::string source((std::istreambuf_iterator<char>(expression)),
+		     std::istreambuf_iterator<char>());
+
+  return parseSource(source);
+};
 
-  ast = parse(tokens);
+bool Interpreter::parseSource(const std::string & source) noexcept{
+
+  ast = parse(source.data(), source.size());
+  m_compiled = false;
 
   return (ast != Expression());
-};
+}
+
+bool Interpreter::parseFile(const std::string & filename) noexcept{
+
+  ScriptReader reader(filename);
+  m_compiled = false;
+
+  bool ok = reader.next(ast);
+
+  // like parseStream, anything after the first form is an error; reading
+  // to the end also lets the reader install a fresh cache
+  Expression rest;
+  while(reader.next(rest)){
+    ok = false;
+  }
+
+  if(!ok){
+    ast = Expression();
+  }
+  return (ast != Expression());
+}
+
+bool Interpreter::load(const Expression & program) noexcept{
+
+  ast = program;
+  m_compiled = false;
+
+  return (ast != Expression());
+}
 				     
 
+void Interpreter::setEngine(Engine engine) noexcept{
+  m_engine = engine;
+}
+
+Interpreter::Engine Interpreter::engine() const noexcept{
+  return m_engine;
+}
+
+void Interpreter::setDepthLimit(std::size_t limit) noexcept{
+  m_stackEvaluator.setDepthLimit(limit);
+}
+
+std::size_t Interpreter::depthLimit() const noexcept{
+  return m_stackEvaluator.depthLimit();
+}
+
+void Interpreter::setConstantFolding(bool enabled){
+  env.setConstantFolding(enabled);
+}
+
+bool Interpreter::constantFolding() const{
+  return env.constantFolding();
+}
+
+void Interpreter::setMemoCapacity(std::size_t capacity){
+  env.memoCache().setCapacity(capacity);
+}
+
+MemoStatistics Interpreter::memoStatistics() const{
+  return env.memoCache().statistics();
+}
+
+void Interpreter::resetMemoStatistics(){
+  env.memoCache().resetStatistics();
+}
+
+void Interpreter::setThreads(std::size_t threads){
+  m_executor = std::make_shared<Executor>(threads);
+  env.setExecutor(m_executor);
+}
+
+std::size_t Interpreter::threads() const{
+  return m_executor->size();
+}
+
 Expression Interpreter::evaluate(){
+  if(m_engine == StackEngine){
+    return m_stackEvaluator.evaluate(ast, env);
+  }
+  if(m_engine == BytecodeEngine){
+    if(!m_compiled){
+      m_chunk = compile(ast);
+      m_compiled = true;
+    }
+    return m_machine.run(m_chunk, env);
+  }
   return ast.eval(env);
 };
 
@@ -31,7 +127,12 @@ Environment Interpreter::getEnv() {
 }
 
 void Interpreter::setEnv(Environment newEnv) {
-	env = newEnv;
+	// the folding setting and thread pool belong to the interpreter, not the
+	// environment
+	bool folding = env.constantFolding();
+	env = std::move(newEnv);
+	env.setConstantFolding(folding);
+	env.setExecutor(m_executor);
 }
 
 void Interpreter::throwIntInterrupt() {
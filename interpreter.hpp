@@ -12,8 +12,12 @@ It maintains an environment during evaluation.
 #include <string>
 
 // module includes
+#include "bytecode.hpp"
 #include "environment.hpp"
+#include "executor.hpp"
 #include "expression.hpp"
+#include "memoization.hpp"
+#include "stack_evaluator.hpp"
 #include "threadQueue.hpp"
 
 /*! \class Interpreter
@@ -26,13 +30,87 @@ The eval method updates Environment and returns last result.
 class Interpreter {
 public:
 
+  /// the ways the internal Expression can be evaluated
+  enum Engine {
+    TreeWalkEngine, //< Expression::eval, the default
+    BytecodeEngine, //< compiled once and run by a VirtualMachine
+    StackEngine     //< a StackEvaluator, with proper tail calls and a depth limit
+  };
+
+  /// construct an Interpreter whose thread pool has Executor::defaultSize()
+  /// threads
+  Interpreter();
+
   /*! Parse into an internal Expression from a stream
     \param expression the raw text stream repreenting the candidate expression
     \return true on successful parsing 
    */
   bool parseStream(std::istream &expression) noexcept;
 
-  /*! Evaluate the Expression by walking the tree, returning the result.
+  /*! Parse into an internal Expression from a string
+    \param source the raw text of the candidate expression
+    \return true on successful parsing
+   */
+  bool parseSource(const std::string &source) noexcept;
+
+  /*! Parse into an internal Expression from a file holding one expression,
+    using the file's AST cache when it is valid and refreshing it otherwise
+    \param filename the name of the file
+    \return true on successful parsing
+   */
+  bool parseFile(const std::string &filename) noexcept;
+
+  /*! Use an already parsed Expression as the internal Expression
+    \param program the abstract syntax tree
+    \return true if program is not the None Expression
+   */
+  bool load(const Expression &program) noexcept;
+
+  /// select the engine used by evaluate
+  void setEngine(Engine engine) noexcept;
+
+  /// return the engine used by evaluate
+  Engine engine() const noexcept;
+
+  /// set the depth limit of the stack engine
+  void setDepthLimit(std::size_t limit) noexcept;
+
+  /// return the depth limit of the stack engine
+  std::size_t depthLimit() const noexcept;
+
+  /*! Enable or disable constant folding, on by default. When enabled,
+    lambdas are called through their bodies with the constant
+    subexpressions folded, see constant_folding.hpp.
+    \param enabled true to fold constants
+   */
+  void setConstantFolding(bool enabled);
+
+  /// return true if constant folding is enabled
+  bool constantFolding() const;
+
+  /*! Set the most lambda call results the memo cache keeps, 0 to disable
+    it. The cache is shared with copies of the environment.
+    \param capacity the number of entries
+   */
+  void setMemoCapacity(std::size_t capacity);
+
+  /// return the hit and miss counts of the memo cache since the last
+  /// reset, with its size and capacity
+  MemoStatistics memoStatistics() const;
+
+  /// reset the hit and miss counts of the memo cache to zero
+  void resetMemoStatistics();
+
+  /*! Set the number of threads pmap and preduce run on, replacing the
+    thread pool. The pool is shared with copies of the environment.
+    \param threads the number of threads, 1 to evaluate them sequentially
+   */
+  void setThreads(std::size_t threads);
+
+  /// return the number of threads pmap and preduce run on
+  std::size_t threads() const;
+
+  /*! Evaluate the Expression with the selected engine, returning the result.
     \return the Expression resulting from the evaluation in the current environment
     \throws SemanticError when a semantic error is encountered
    */
@@ -58,8 +136,22 @@ private:
   // the environment
   Environment env;
 
+  // the thread pool of pmap and preduce, shared with env
+  std::shared_ptr<Executor> m_executor;
+
   // the AST
   Expression ast;
+
+  // the engine used by evaluate
+  Engine m_engine = TreeWalkEngine;
+
+  // the AST compiled for the bytecode engine, when m_compiled is set
+  Chunk m_chunk;
+  bool m_compiled = false;
+
+  VirtualMachine m_machine;
+
+  StackEvaluator m_stackEvaluator;
 };
 
 #endif
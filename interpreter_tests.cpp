@@ -1,13 +1,18 @@
 #include "catch.hpp"
 
+#include <cmath>
 #include <string>
 #include <sstream>
 #include <fstream>
 #include <iostream>
+#include <type_traits>
+#include <vector>
 
+#include "adaptive_sampling.hpp"
 #include "semantic_error.hpp"
 #include "interpreter.hpp"
 #include "expression.hpp"
+#include "plot_primitives.hpp"
 
 Expression run(const std::string & program){
   
@@ -469,7 +474,7 @@ TEST_CASE("Test Interpreter special forms: lambda, apply and map", "[interpreter
 		std::string program = "(begin (define f (lambda (x) (+ (sin x) 1))) (continuous-plot f (list (- pi) (pi)) (list (list \"title\" \"A continuous linear function\") (list \"abscissa - label\" \"x\") (list \"ordinate - label\" \"y\"))))";
 		INFO(program);
 		Expression result = run(program);
-		REQUIRE(result.getTailLength() == 85);
+		REQUIRE(result.getTailLength() == 59);
 	}
 
 	{
@@ -484,7 +489,7 @@ TEST_CASE("Test Interpreter special forms: lambda, apply and map", "[interpreter
 		std::string program = "(begin (define f (lambda (x) (+ (* 2 x) 1))) (continuous-plot f (list -2 2) (list (list \"title\" \"A continuous linear function\") (list \"abscissa - label\" \"x\") (list \"ordinate - label\" \"y\"))))";
 		INFO(program);
 		Expression result = run(program);
-		REQUIRE(result.getTailLength() == 61);
+		REQUIRE(result.getTailLength() == 43);
 	}
 
 	{
@@ -907,6 +912,484 @@ TEST_CASE("Test Interpreter special forms: lambda, apply and map", "[interpreter
 	
 }
 
+TEST_CASE( "Test lambda parameters resolved to slots", "[interpreter]" ) {
+
+  struct { const char * program; double value; } cases[] = {
+    {"(begin (define f (lambda (x y) (- x y))) (f 10 4))", 6},
+    // a body may redefine a parameter, and later references see it
+    {"(begin (define f (lambda (x) (begin (define x (* x 10)) (+ x 1)))) (f 2))", 21},
+    // the last of two parameters with one name is bound
+    {"(begin (define f (lambda (x x) x)) (f 1 2))", 2},
+    // free variables resolve where the lambda was made, not in the caller
+    {"(begin (define x 1) (define g (lambda (y) (+ y x))) (define f (lambda (x) (g 1))) (f 5))", 2},
+    // nested lambdas bind their own parameters
+    {"(begin (define f (lambda (x) (begin (define g (lambda (x) (* x 3))) (+ (g 2) x)))) (f 1))", 7},
+    {"(begin (define f (lambda (x) (apply + (list x x)))) (f 4))", 8},
+    {"(begin (define f (lambda (n) (first (map (lambda (y) (+ y n)) (list 1 2))))) (f 10))", 11},
+    {"(begin (define f (lambda (sin) (+ sin 1))) (f 5))", 6},
+  };
+
+  for (auto & c : cases) {
+    INFO(c.program);
+    REQUIRE(run(c.program) == Expression(c.value));
+  }
+
+  // a lambda prints with its parameter names
+  std::ostringstream out;
+  out << run("(lambda (x) (* 2 x))");
+  REQUIRE(out.str() == "(((x)) (* (2) (x)))");
+}
+
+TEST_CASE( "Test closures", "[interpreter]" ) {
+
+  struct { const char * program; double value; } cases[] = {
+    // a lambda made in a call keeps the bindings of its frame
+    {"(begin (define adder (lambda (n) (lambda (x) (+ x n)))) (define add3 (adder 3)) (add3 4))", 7},
+    {"(begin (define adder (lambda (n) (lambda (x) (+ x n)))) (define a (adder 1)) (define b (adder 2)) (+ (a 0) (b 0)))", 3},
+    {"(begin (define f (lambda (n) (begin (define k (* n 2)) (lambda (x) (* x k))))) (define h (f 5)) (h 3))", 30},
+    // inner bindings shadow captured and global ones
+    {"(begin (define n 100) (define f (lambda (n) (lambda (n) (* n 2)))) (define h (f 1)) (h 4))", 8},
+    // globals are looked up when called, so later definitions are seen
+    {"(begin (define f (lambda (x) (+ x later))) (define later 5) (f 1))", 6},
+    // closures are called directly by map, apply and nested closures
+    {"(begin (define adder (lambda (n) (lambda (x) (+ x n)))) (+ (apply (adder 10) (list 5)) (first (rest (map (adder 10) (list 1 2))))))", 27},
+    {"(begin (define twice (lambda (g) (lambda (x) (g (g x))))) (define inc (lambda (x) (+ x 1))) (define inc2 (twice inc)) (inc2 5))", 7},
+    // a closure sees definitions made in its frame after it, so local
+    // procedures may call themselves and each other
+    {"(begin (define h (lambda (x) (begin (define f (lambda (x) (g x))) (define g (lambda (x) (* 2 x))) (f x)))) (h 10))", 20},
+    {"(begin (define f (lambda (l) (begin (define walk (lambda (x) (map walk x))) (length (walk l))))) (f (list (list) (list (list)))))", 2},
+    {"(begin (define f (lambda (l) (begin (define a (lambda (x) (map b x))) (define b (lambda (x) (map a x))) (length (a l))))) (f (list (list (list)))))", 1},
+    {"(begin (define mk (lambda (k) (begin (define s (lambda (x) (r x))) (define r (lambda (x) (* k x))) s))) (define t (mk 3)) (t 5))", 15},
+    // and is neither memoized nor folded under the bindings it saw before
+    {"(begin (define h (lambda (x) (begin (define g (lambda (y) y)) (define f (lambda (y) (g y))) (define a (f x)) (define g (lambda (y) (* 10 y))) (+ a (f x))))) (h 2))", 22},
+    {"(begin (define h (lambda (x) (begin (define f (lambda (y) (sin 0))) (define a (f x)) (define sin (lambda (y) 5)) (+ a (f x))))) (h 2))", 5},
+  };
+
+  for (auto & c : cases) {
+    INFO(c.program);
+    REQUIRE(run(c.program) == Expression(c.value));
+  }
+
+  // the caller's bindings are not visible to a closure defined elsewhere
+  runWithError("(begin (define g (lambda (y) (+ y x))) (define f (lambda (x) (g 1))) (f 5))");
+
+  // a local procedure calling itself runs until ln fails
+  runWithError("(begin (define outer (lambda (n) (begin (define r (lambda (x) (begin (ln x) (r (- x 1))))) (r n)))) (outer 3))");
+
+  // a continuous-plot of a closure
+  Expression plot = run("(begin (define scale (lambda (k) (lambda (x) (* k x)))) (continuous-plot (scale 2) (list -1 1)))");
+  REQUIRE(plot.isHeadList());
+  REQUIRE(plot.getTailLength() > 0);
+}
+
+// evaluate program with one engine, returning the result or the error message
+static std::string evaluateWith(Interpreter::Engine engine, const std::string & program){
+
+  std::istringstream iss(program);
+
+  Interpreter interp;
+  interp.setEngine(engine);
+
+  bool ok = interp.parseStream(iss);
+  REQUIRE(ok == true);
+
+  std::ostringstream result;
+  try{
+    result << interp.evaluate();
+  }
+  catch(const SemanticError & ex){
+    result << ex.what();
+  }
+  return result.str();
+}
+
+TEST_CASE( "Test every engine agrees with the tree walker", "[interpreter]" ) {
+
+  std::vector<std::string> programs = {
+    "(1)",
+    "(\"text\")",
+    "(+ 1 (* 2 3) (- 10 4))",
+    "(begin (define r 10) (* pi (* r r)))",
+    "(begin (define a 1) (define b (+ a 1)) (list a b (^ b 8)))",
+    "(list)",
+    "(sqrt -1)",
+    "(begin (define f (lambda (x y) (+ x (* 2 y)))) (f 3 4))",
+    "(begin (define f (lambda (x) (* x x))) (define g (lambda (x) (f (f x)))) (g 3))",
+    "(begin (define f (lambda (x) (+ x 1))) (map f (list 1 2 3)))",
+    "(apply + (list 1 2 3))",
+    "(begin (define x 1) (define f (lambda (x) (+ x 10))) (list (f 5) x))",
+    "(lambda (x) (* 2 x))",
+    "(begin (define p (set-property \"note\" \"a\" (1))) (get-property \"note\" p))",
+    "(first (rest (list 1 2 3)))",
+    "(begin (define f (lambda (x) (begin (define x (* x 10)) (+ x 1)))) (f 2))",
+    "(begin (define g (lambda (y) (+ y x))) (define f (lambda (x) (g 1))) (f 5))",
+    "(begin (define g (lambda (y) (begin (define z 2) (h y)))) (define h (lambda (y) (+ y z))) (g 1))",
+    "(begin (define f (lambda (x x) x)) (f 1 2))",
+    "(begin (define sin 5) (+ sin 1))",
+    "(begin (define adder (lambda (n) (lambda (x) (+ x n)))) (define add3 (adder 3)) (list (add3 4) (apply (adder 1) (list 1))))",
+    "(begin (define outer (lambda (n) (begin (define r (lambda (x) (begin (ln x) (r (- x 1))))) (r n)))) (outer 3))",
+    "(begin (define h (lambda (x) (begin (define f (lambda (x) (g x))) (define g (lambda (x) (* 2 x))) (f x)))) (h 10))",
+    "(begin (define f (lambda (l) (begin (define walk (lambda (x) (map walk x))) (walk l)))) (f (list (list) (list (list)))))",
+    "(begin (define mk (lambda (k) (begin (define s (lambda (x) (r x))) (define r (lambda (x) (* k x))) s))) (define t (mk 3)) (t 5))",
+    "(begin (define h (lambda (x) (begin (define g (lambda (y) y)) (define f (lambda (y) (g y))) (define a (f x)) (define g (lambda (y) (* 10 y))) (+ a (f x))))) (h 2))",
+    "(map sin (list 0 1))",
+    "(map (lambda (x) (* x x)) (list 1 2 3))",
+    "(map (lambda (x) (list x \"s\")) (list 1 2))",
+    "(begin (define adder (lambda (n) (lambda (x) (+ x n)))) (map (adder 2) (list 1 2)))",
+    "(apply (lambda (x y) (- x y)) (list 5 2))",
+    "(begin (define f (lambda (x) x)) (apply f (list)))",
+    "(pmap (lambda (x) (list x)) (list 1 2))",
+    "(pmap - (list 1 2))",
+    "(preduce + 0 (list 1 2 3))",
+    "(preduce (lambda (a b) (+ a b)) 10 (list 1 2 3 4))",
+    "(preduce (lambda (a b) (+ a b)) 10 (list))",
+    "(begin (define f (lambda (n) (apply + (list n 1)))) (f 2))",
+    // errors
+    "(undefined)",
+    "(+ x 1)",
+    "(begin (define a 1) (a))",
+    "(begin (define a 1) (define a 2))",
+    "(define + 3)",
+    "(define begin 3)",
+    "(define a)",
+    "(begin)",
+    "(begin (define f (lambda (x) x)) (f 1 2))",
+    "(begin (define f (lambda (x) (undefined x))) (f 1))",
+    "(begin (define f (lambda (x) (f (rest x)))) (f (list 1 2 3)))",
+    "(1 2)",
+    "(/ 1 (list 1 2) 3)",
+    "(map sin 3)",
+    "(map undefined (list 1))",
+    "(map (lambda (x) (undefined x)) (list 1))",
+    "(apply + (list))",
+    "(apply + 3)",
+    "(apply (+ 1 2) (list 1))",
+    "(apply begin (list 1))",
+    "(pmap 3 (list 1))",
+    "(preduce sin 0 3)",
+    "(preduce (lambda (a) a) 0 (list 1 2))",
+  };
+
+  for (auto engine : {Interpreter::BytecodeEngine, Interpreter::StackEngine}) {
+    for(auto & program : programs){
+      INFO("engine " << engine << ": " << program);
+      REQUIRE(evaluateWith(engine, program) ==
+	      evaluateWith(Interpreter::TreeWalkEngine, program));
+    }
+  }
+}
+
+// a special-form giving its operand unevaluated
+static Expression quote(const Expression & form, Environment &){
+  if (form.getTailLength() != 1) {
+    throw SemanticError("Error in call to quote: invalid number of arguments.");
+  }
+  return form.getValueInTail(0);
+}
+
+TEST_CASE( "Test registered special-forms", "[interpreter]" ) {
+
+  Expression::registerSpecialForm("quote", quote);
+  REQUIRE(Expression::isSpecialForm(intern("quote")));
+  REQUIRE(Expression::isSpecialForm(MapSymbol));
+  REQUIRE(!Expression::isSpecialForm(intern("sin")));
+
+  for (auto engine : {Interpreter::TreeWalkEngine, Interpreter::BytecodeEngine, Interpreter::StackEngine}) {
+    INFO(engine);
+    Interpreter interp;
+    interp.setEngine(engine);
+
+    std::istringstream iss("(list (quote (undefined 1 2)) (quote 3))");
+    REQUIRE(interp.parseStream(iss));
+    Expression result = interp.evaluate();
+    REQUIRE(result.getTailLength() == 2);
+    std::ostringstream out;
+    out << result.getValueInTail(0);
+    REQUIRE(out.str() == "(undefined(1) (2))");
+
+    // the operand in a lambda body is left as written
+    std::istringstream body("(begin (define f (lambda (x) (quote x))) (f 1))");
+    REQUIRE(interp.parseStream(body));
+    REQUIRE(interp.evaluate() == Expression(Atom(std::string("x"))));
+
+    std::istringstream error("(quote 1 2)");
+    REQUIRE(interp.parseStream(error));
+    REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+  }
+
+  // once removed the name is a procedure call again
+  Expression::registerSpecialForm("quote", nullptr);
+  REQUIRE(!Expression::isSpecialForm(intern("quote")));
+  runWithError("(quote 1)");
+}
+
+TEST_CASE( "Test constant folding", "[interpreter]" ) {
+
+  const double pi = std::atan2(0, -1);
+
+  struct { const char * program; double value; } cases[] = {
+    {"(begin (define f (lambda (x) (* x (* 2 pi)))) (f 1))", 2 * pi},
+    {"(begin (define f (lambda (x) (+ x (length (range 0 99 1)) (/ 1 4)))) (first (map f (list 1 2))))", 101.25},
+    {"(begin (define f (lambda (x) (+ x (real (* I I))))) (f 3))", 2},
+    // names the body may bind are not folded
+    {"(begin (define f (lambda (pi) (* 2 pi))) (f 3))", 6},
+    {"(begin (define g (lambda (x) (* x 10))) (define f (lambda (sin) (sin 1))) (f g))", 10},
+    {"(begin (define f (lambda (x) (begin (define e 2) (* x e)))) (f 3))", 6},
+    {"(begin (define mk (lambda (pi) (lambda (x) (* x pi)))) (define h (mk 2)) (h 3))", 6},
+    // a call raising an error is only evaluated if the body reaches it
+    {"(begin (define f (lambda (x) (first (list)))) 1)", 1},
+  };
+
+  for (auto engine : {Interpreter::TreeWalkEngine, Interpreter::BytecodeEngine, Interpreter::StackEngine}) {
+    for (bool folding : {true, false}) {
+      INFO(engine << " " << folding);
+      Interpreter interp;
+      interp.setEngine(engine);
+      interp.setConstantFolding(folding);
+      REQUIRE(interp.constantFolding() == folding);
+
+      for (auto & c : cases) {
+	INFO(c.program);
+	REQUIRE(interp.parseSource(c.program));
+	REQUIRE(interp.evaluate() == Expression(c.value));
+      }
+
+      REQUIRE(interp.parseSource("(begin (define f (lambda (x) (+ x (ln -1)))) 1)"));
+      REQUIRE(interp.evaluate() == Expression(1.));
+      REQUIRE(interp.parseSource("(f 1)"));
+      REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+
+      // redefining a built-in later is seen by lambdas already called
+      REQUIRE(interp.parseSource("(begin (define f (lambda (x) (* x pi))) (f 1))"));
+      REQUIRE(interp.evaluate() == Expression(pi));
+      REQUIRE(interp.parseSource("(define pi 3)"));
+      interp.evaluate();
+      REQUIRE(interp.parseSource("(f 2)"));
+      REQUIRE(interp.evaluate() == Expression(6.));
+    }
+  }
+
+  // the lambda value is displayed as written
+  REQUIRE(run("(begin (define f (lambda (x) (* x (+ 1 2)))) (f 1) f)") ==
+	  run("(lambda (x) (* x (+ 1 2)))"));
+
+  // the setting is kept when the environment is replaced
+  Interpreter interp;
+  interp.setConstantFolding(false);
+  interp.setEnv(Environment());
+  REQUIRE(!interp.constantFolding());
+}
+
+TEST_CASE( "Test memoization", "[interpreter]" ) {
+
+  struct { const char * program; double value; std::size_t hits; std::size_t misses; } cases[] = {
+    // a pure lambda calling a lambda is memoized, one calling only built-ins is not
+    {"(begin (define sq (lambda (x) (* x x))) (define f (lambda (x) (+ (sq x) 1))) (f 3) (f 3))", 10, 1, 1},
+    {"(begin (define g (lambda (x) (* x 2))) (g 1) (g 1))", 2, 0, 0},
+    // memoize opts any lambda in
+    {"(begin (define g (memoize (lambda (x) (* x 2)))) (g 1) (g 2) (g 1))", 2, 1, 2},
+    // a call of a parameter is not known to be pure
+    {"(begin (define sq (lambda (x) (* x x))) (define h (lambda (k x) (k x))) (h sq 2) (h sq 2))", 4, 0, 0},
+    // lists are compared structurally
+    {"(begin (define len (lambda (l) (length l))) (define f (lambda (l) (len l))) (f (list 1 2)) (f (list 1 2)))", 2, 1, 1},
+    // calls with large arguments are not
+    {"(begin (define len (lambda (l) (length l))) (define f (lambda (l) (len l))) (define l (range 0 2000 1)) (f l) (f l))", 2001, 0, 0},
+    {"(begin (define g (memoize (lambda (l) (length l)))) (g (range 0 2000 1)) (g (range 0 2000 1)))", 2001, 0, 0},
+  };
+
+  for (auto engine : {Interpreter::TreeWalkEngine, Interpreter::BytecodeEngine, Interpreter::StackEngine}) {
+    for (auto & c : cases) {
+      INFO(engine << " " << c.program);
+      Interpreter interp;
+      interp.setEngine(engine);
+      REQUIRE(interp.parseSource(c.program));
+      REQUIRE(interp.evaluate() == Expression(c.value));
+      MemoStatistics statistics = interp.memoStatistics();
+      REQUIRE(statistics.hits == c.hits);
+      REQUIRE(statistics.misses == c.misses);
+      REQUIRE(statistics.capacity == MemoCache::DefaultCapacity);
+    }
+
+    INFO(engine);
+    Interpreter interp;
+    interp.setEngine(engine);
+
+    // a global definition is seen by calls cached before it
+    REQUIRE(interp.parseSource("(begin (define sq (lambda (x) (* x x))) (define f (lambda (x) (+ (sq x) 1))) (f 3))"));
+    REQUIRE(interp.evaluate() == Expression(10.));
+    REQUIRE(interp.parseSource("(define sq (lambda (x) (* x x x)))"));
+    interp.evaluate();
+    REQUIRE(interp.parseSource("(f 3)"));
+    REQUIRE(interp.evaluate() == Expression(28.));
+    REQUIRE(interp.memoStatistics().hits == 0);
+
+    // the least recently used entries are evicted
+    interp.setMemoCapacity(1);
+    REQUIRE(interp.parseSource("(begin (f 1) (f 2) (f 1))"));
+    REQUIRE(interp.evaluate() == Expression(2.));
+    REQUIRE(interp.memoStatistics().entries == 1);
+    REQUIRE(interp.memoStatistics().hits == 0);
+
+    interp.resetMemoStatistics();
+    interp.setMemoCapacity(0);
+    REQUIRE(interp.evaluate() == Expression(2.));
+    REQUIRE(interp.memoStatistics().entries == 0);
+    REQUIRE(interp.memoStatistics().hits == 0);
+    REQUIRE(interp.memoStatistics().misses == 3);
+  }
+
+  runWithError("(memoize)");
+  runWithError("(memoize 1)");
+  runWithError("(begin (define f (memoize (lambda (x) x))) (f 1 2))");
+}
+
+TEST_CASE( "Test pmap and preduce", "[interpreter]" ) {
+
+  struct { const char * program; const char * expected; } cases[] = {
+    {"(pmap (lambda (x) (* x x)) (range 1 1000 1))", "(map (lambda (x) (* x x)) (range 1 1000 1))"},
+    {"(pmap sqrt (range 0 999 1))", "(map sqrt (range 0 999 1))"},
+    {"(pmap (lambda (x) (list x 1)) (range 1 200 1))", "(map (lambda (x) (list x 1)) (range 1 200 1))"},
+    {"(pmap - (list 1 2 3))", "(list -1 -2 -3)"},
+    {"(preduce + 0 (range 1 1000 1))", "(+ 500500)"},
+    {"(preduce (lambda (a b) (+ a b)) 10 (range 1 1000 1))", "(+ 500510)"},
+    // partial results are combined in order
+    {"(preduce join (list) (map (lambda (x) (list x)) (range 1 300 1)))", "(range 1 300 1)"},
+    {"(preduce * 2 (list))", "(+ 2)"},
+  };
+
+  for (std::size_t threads : {1, 4}) {
+    for (auto engine : {Interpreter::TreeWalkEngine, Interpreter::BytecodeEngine, Interpreter::StackEngine}) {
+      for (auto & c : cases) {
+        INFO(threads << " " << engine << " " << c.program);
+        Interpreter interp;
+        interp.setThreads(threads);
+        REQUIRE(interp.threads() == threads);
+        interp.setEngine(engine);
+        REQUIRE(interp.parseSource(c.expected));
+        Expression expected = interp.evaluate();
+        REQUIRE(interp.parseSource(c.program));
+        REQUIRE(interp.evaluate() == expected);
+      }
+
+      // an error raised in any chunk is raised by pmap
+      Interpreter interp;
+      interp.setThreads(threads);
+      interp.setEngine(engine);
+      REQUIRE(interp.parseSource("(pmap (lambda (x) (+ x \"a\")) (range 1 1000 1))"));
+      REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+    }
+  }
+
+  runWithError("(pmap)");
+  runWithError("(pmap + 1)");
+  runWithError("(pmap 1 (list 1 2))");
+  runWithError("(preduce + 0)");
+  runWithError("(preduce + 0 1)");
+}
+
+TEST_CASE( "Test continuous-plot sampling options", "[interpreter]" ) {
+
+  // the box, origin and axis items, besides the lines of the curve
+  const std::size_t frame = 10;
+
+  // a line is drawn from the grid and one round of midpoints
+  Expression line = run("(continuous-plot (lambda (x) (+ (* 2 x) 1)) (list -2 2))");
+  REQUIRE(line.getTailLength() == frame + 2 * InitialIntervals);
+
+  line = run("(continuous-plot (lambda (x) (+ (* 2 x) 1)) (list -2 2) (list (list \"samples\" 2)))");
+  REQUIRE(line.getTailLength() == frame + 1);
+
+  // a curve is refined further the lower the tolerance
+  Expression coarse = run("(continuous-plot (lambda (x) (sin (* 10 x))) (list -2 2) (list (list \"tolerance\" 1)))");
+  Expression fine = run("(continuous-plot (lambda (x) (sin (* 10 x))) (list -2 2) (list (list \"tolerance\" 0.01)))");
+  REQUIRE(coarse.getTailLength() < fine.getTailLength());
+
+  Expression budget = run("(continuous-plot (lambda (x) (sin (* 10 x))) (list -2 2) (list (list \"tolerance\" 0.01) (list \"samples\" 100)))");
+  REQUIRE(budget.getTailLength() == frame + 99);
+
+  runWithError("(continuous-plot (lambda (x) x) (list -2 2) (list (list \"samples\" 1)))");
+  runWithError("(continuous-plot (lambda (x) x) (list -2 2) (list (list \"samples\" 2.5)))");
+  runWithError("(continuous-plot (lambda (x) x) (list -2 2) (list (list \"samples\" \"many\")))");
+  runWithError("(continuous-plot (lambda (x) x) (list -2 2) (list (list \"tolerance\" 0)))");
+  runWithError("(continuous-plot (lambda (x) x) (list -2 2) (list (list \"tolerance\" -1)))");
+}
+
+TEST_CASE( "Test continuous-plot samples in parallel", "[interpreter]" ) {
+
+  const char * programs[] = {
+    "(continuous-plot (lambda (x) (sin (* 10 x))) (list -2 2))",
+    "(continuous-plot (lambda (x) (/ 1 x)) (list -2 2))",
+    "(continuous-plot (lambda (x) (* x x x)) (list -1 1) (list (list \"text-scale\" 2)))",
+  };
+
+  for (auto program : programs) {
+    INFO(program);
+    Interpreter serial;
+    serial.setThreads(1);
+    REQUIRE(serial.parseSource(program));
+    Expression expected = serial.evaluate();
+
+    Interpreter parallel;
+    parallel.setThreads(4);
+    REQUIRE(parallel.parseSource(program));
+    REQUIRE(parallel.evaluate().identical(expected));
+  }
+
+  Interpreter interp;
+  interp.setThreads(4);
+  REQUIRE(interp.parseSource("(continuous-plot (lambda (x) (+ x \"a\")) (list -2 2))"));
+  REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+}
+
+TEST_CASE( "Test plot items are stored compactly", "[interpreter]" ) {
+
+  std::string program = "(discrete-plot (list (list -1 -1) (list 1 1)) (list (list \"ordinate-label\" \"y\")))";
+  Expression plot = run(program);
+
+  // 2 points, 4 lines of the box, 2 of the origin and 2 stems, 4 axis
+  // numbers and the label
+  const PlotPrimitives * items = plot.plotPrimitives();
+  REQUIRE(items != nullptr);
+  REQUIRE(items->points().size() == 2);
+  REQUIRE(items->lines().size() == 8);
+  REQUIRE(items->texts().size() == 5);
+  REQUIRE(items->runs().size() == 3);
+  REQUIRE(plot.getTailLength() == 15);
+
+  PlotPoint point = items->points()[0];
+  REQUIRE(point.x == -10);
+  REQUIRE(point.y == 10);
+  REQUIRE(point.size == 0.5);
+  REQUIRE(items->texts()[4].text == "\"y\"");
+  REQUIRE(items->texts()[4].rotated);
+
+  // inspecting the items makes the Expressions make-point and the others do
+  Expression first = plot.getValueInTail(0);
+  REQUIRE(first == Expression(std::vector<double>{-10, 10}));
+  REQUIRE(first.getProperty(Atom(std::string("\"object-name\""))) == Expression(Atom(std::string("\"point\""))));
+  REQUIRE(first.getProperty(Atom(std::string("\"size\""))) == Expression(0.5));
+
+  Expression stem = plot.getValueInTail(8);
+  REQUIRE(stem.getProperty(Atom(std::string("\"object-name\""))) == Expression(Atom(std::string("\"line\""))));
+  REQUIRE(stem.getValueInTail(0) == Expression(std::vector<double>{-10, 0}));
+
+  Expression label = plot.getValueInTail(14);
+  REQUIRE(label.head().asString() == "\"y\"");
+  REQUIRE(label.getProperty(Atom(std::string("\"rotation\""))) == Expression(std::atan2(-1, 0)));
+
+  // as a List, it equals the same items built by script code
+  REQUIRE(run("(first " + program + ")") == first);
+  REQUIRE(run("(length " + program + ")") == Expression(15.));
+  REQUIRE(plot == run(program));
+  REQUIRE(plot.identical(run(program)));
+  REQUIRE(plot.structuralHash() == run(program).structuralHash());
+
+  Expression appended = run("(append " + program + " 1)");
+  REQUIRE(appended.plotPrimitives() == nullptr);
+  REQUIRE(appended.getTailLength() == 16);
+  REQUIRE(appended.getValueInTail(14) == label);
+}
+
 TEST_CASE( "Test arithmetic procedures", "[interpreter]" ) {
 
   {
@@ -990,3 +1473,140 @@ TEST_CASE( "Test using number as procedure", "[interpreter]" ) {
   
   REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
 }
+
+TEST_CASE( "Test expression copies per evaluation", "[interpreter]" ) {
+
+  static_assert(std::is_nothrow_move_constructible<Expression>::value, "Expression move must be noexcept");
+  static_assert(std::is_nothrow_move_assignable<Expression>::value, "Expression move assign must be noexcept");
+
+  // counts measured before move semantics were added: 122, 5900 and 24144;
+  // copies are O(1) since the tail became copy-on-write
+  struct { const char * program; std::size_t limit; } cases[] = {
+    {"(apply + (list 1 2 3 4 5 6 7 8 9 10))", 20},
+    {"(begin (define a (range 0 99 1)) (length (join a (rest a))))", 1000},
+    {"(begin (define f (lambda (x) (* 2 x))) (map f (range 0 99 1)))", 6000},
+  };
+
+  for (auto & c : cases) {
+    INFO(c.program);
+    std::istringstream iss(c.program);
+    Interpreter interp;
+    REQUIRE(interp.parseStream(iss));
+
+    Expression::resetCopyCount();
+    Expression result = interp.evaluate();
+#ifndef NDEBUG
+    REQUIRE(Expression::copyCount() <= c.limit);
+#endif
+  }
+}
+
+TEST_CASE( "Test lambda calls do not copy the environment", "[interpreter]" ) {
+
+  std::string program = "(begin";
+  for (int i = 0; i < 200; ++i) {
+    program += " (define g" + std::to_string(i) + " (list \"global\" " + std::to_string(i) + "))";
+  }
+  program += " (define f (lambda (x) (begin (define local (* 2 x)) (+ local (length g7)))))";
+
+  std::istringstream iss(program + ")");
+  Interpreter interp;
+  REQUIRE(interp.parseStream(iss));
+  REQUIRE_NOTHROW(interp.evaluate());
+
+  std::istringstream call("(f 3)");
+  REQUIRE(interp.parseStream(call));
+  Expression::resetCopyCount();
+  Expression result = interp.evaluate();
+#ifndef NDEBUG
+  REQUIRE(Expression::copyCount() <= 20);
+#endif
+
+  // the call's definitions stay in its frame
+  std::istringstream local("(local)");
+  REQUIRE(interp.parseStream(local));
+  REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+}
+
+TEST_CASE( "Test map and apply call procedures directly", "[interpreter]" ) {
+
+  Interpreter interp;
+  std::istringstream iss("(list (apply (lambda (x y) (- x y)) (list 5 2)) "
+			 "(length (map (lambda (x) (* x x)) (range 1 100 1))))");
+  REQUIRE(interp.parseStream(iss));
+  REQUIRE(interp.evaluate() == run("(list 3 100)"));
+
+  // nothing is left defined by an inline lambda
+  REQUIRE(!interp.getEnv().is_known(Atom(std::string("temporaryLambda"))));
+
+  // results that are not all numbers make an ordinary list
+  {
+    Expression result = run("(map (lambda (x) (list x)) (list 1 2))");
+    REQUIRE(result == run("(list (list 1) (list 2))"));
+    result = run("(map (lambda (x) (/ 1 x)) (list 2 (list 4)))");
+    REQUIRE(result == run("(list 0.5 (list 0.25))"));
+    REQUIRE(!result.isPacked());
+  }
+
+  // the list argument is evaluated once
+  {
+    Expression result = run("(begin (define n 0) (map sqrt (begin (define n (+ n 1)) (list n 4))))");
+    REQUIRE(result == run("(list 1 2)"));
+  }
+
+  {
+    Expression result = run("(begin (define f (lambda (x) (+ x 1))) (map f (map f (range 1 3 1))))");
+    REQUIRE(result.isPacked());
+    REQUIRE(result.packedValues() == std::vector<double>({3, 4, 5}));
+  }
+
+  runWithError("(apply + (list))");
+  runWithError("(map (lambda (x y) x) (list 1 2))");
+}
+
+TEST_CASE( "Test packed numeric lists", "[interpreter]" ) {
+
+  // range, list of numbers and map over numeric results are packed
+  {
+    std::vector<std::string> programs = {"(range 0 3 1)",
+					 "(list 0 1 2 3)",
+					 "(map (lambda (x) (- x 1)) (list 1 2 3 4))",
+					 "(rest (list -1 0 1 2 3))",
+					 "(append (list 0 1 2) 3)",
+					 "(join (list 0 1) (range 2 3 1))"};
+
+    for(auto s : programs){
+      INFO(s);
+      Expression result = run(s);
+      REQUIRE(result.isPacked());
+      REQUIRE(result.packedValues() == std::vector<double>({0, 1, 2, 3}));
+    }
+  }
+
+  // lists with other elements are not packed but compare equal element-wise
+  {
+    Expression result = run("(append (range 0 1 1) (list 2))");
+    REQUIRE(!result.isPacked());
+    REQUIRE(result.getTailLength() == 3);
+    REQUIRE(result.getValueInTail(2) == run("(list 2)"));
+  }
+
+  {
+    Expression result = run("(first (range 5 10 1))");
+    REQUIRE(result == Expression(5.));
+    result = run("(length (range 1 1000 1))");
+    REQUIRE(result == Expression(1000.));
+    result = run("(apply + (list 1 2 3 4))");
+    REQUIRE(result == Expression(10.));
+  }
+
+  {
+    std::ostringstream out;
+    out << run("(rest (range 0 2 1))");
+    REQUIRE(out.str() == "((1) (2))");
+  }
+
+  // a list is rejected where its elements are, NaN included
+  runWithError("(ln (^ -8 (/ 1 3)))");
+  runWithError("(ln (list 1 (^ -8 (/ 1 3))))");
+}
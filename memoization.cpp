@@ -0,0 +1,300 @@
+#include "memoization.hpp"
+
+#include <unordered_set>
+
+#include "closure.hpp"
+#include "environment.hpp"
+
+bool MemoKey::operator==(const MemoKey & other) const{
+  if(closure != other.closure || epoch != other.epoch || args.size() != other.args.size()){
+    return false;
+  }
+  for(std::size_t i = 0; i < args.size(); ++i){
+    if(!args[i].identical(other.args[i])){
+      return false;
+    }
+  }
+  return true;
+}
+
+const std::size_t MemoCache::DefaultCapacity;
+
+MemoCache::MemoCache(std::size_t capacity):
+  m_capacity(capacity), m_hits(0), m_misses(0){}
+
+bool MemoCache::find(const MemoKey & key, Expression & result){
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  auto found = m_entries.find(key);
+  if(found == m_entries.end()){
+    ++m_misses;
+    return false;
+  }
+  ++m_hits;
+  m_order.splice(m_order.begin(), m_order, found->second.position);
+  result = found->second.value;
+  return true;
+}
+
+void MemoCache::insert(const MemoKey & key, const Expression & result){
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  if(m_capacity == 0){
+    return;
+  }
+  auto inserted = m_entries.emplace(key, Entry{result, m_order.end()});
+  if(!inserted.second){
+    // cached by a call that finished first
+    return;
+  }
+  m_order.push_front(&inserted.first->first);
+  inserted.first->second.position = m_order.begin();
+  evict();
+}
+
+void MemoCache::setCapacity(std::size_t capacity){
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_capacity = capacity;
+  evict();
+}
+
+std::size_t MemoCache::capacity() const{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_capacity;
+}
+
+MemoStatistics MemoCache::statistics() const{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return MemoStatistics{m_hits, m_misses, m_entries.size(), m_capacity};
+}
+
+void MemoCache::resetStatistics(){
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_hits = 0;
+  m_misses = 0;
+}
+
+void MemoCache::clear(){
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_entries.clear();
+  m_order.clear();
+}
+
+void MemoCache::evict(){
+  while(m_entries.size() > m_capacity){
+    m_entries.erase(*m_order.back());
+    m_order.pop_back();
+  }
+}
+
+const std::size_t MemoizedCall::MaxArgumentNodes;
+
+// determine if the arguments are cheap to hash and compare: each a terminal
+// or lambda, or a List of terminals and packed Lists, holding at most limit
+// nodes together, each number of a packed List counted as one
+static bool smallArguments(const std::vector<Expression> & args, std::size_t limit){
+  std::size_t nodes = 0;
+  for(const Expression & arg : args){
+    nodes += 1;
+    if(arg.isHeadLambda() || arg.getTailLength() == 0){
+      continue;
+    }
+    if(!arg.isHeadList()){
+      return false;
+    }
+    if(arg.isPacked() || arg.plotPrimitives() != nullptr){
+      nodes += arg.getTailLength();
+    }
+    else{
+      for(auto it = arg.tailConstBegin(); it != arg.tailConstEnd() && nodes <= limit; ++it){
+	if(it->getTailLength() != 0 && !it->isPacked()){
+	  return false;
+	}
+	nodes += 1 + it->getTailLength();
+      }
+    }
+    if(nodes > limit){
+      return false;
+    }
+  }
+  return true;
+}
+
+MemoizedCall::MemoizedCall(const Expression & lambda, const std::vector<Expression> & args,
+                           const Environment & env): m_cache(nullptr){
+  const Closure * closure = lambda.head().asClosure();
+  if(closure == nullptr || args.size() != closure->arity() || !closure->memoized(env) ||
+     !smallArguments(args, MaxArgumentNodes)){
+    return;
+  }
+  m_cache = &env.memoCache();
+  m_key.closure = closure->id();
+  m_key.epoch = closure->epoch(env);
+  m_key.args = args;
+  m_key.hash = std::hash<std::uint64_t>()(m_key.closure) ^ (std::hash<std::uint64_t>()(m_key.epoch) << 1);
+  for(const Expression & arg : args){
+    m_key.hash = m_key.hash * 31 + arg.structuralHash();
+  }
+}
+
+bool MemoizedCall::active() const noexcept{
+  return m_cache != nullptr;
+}
+
+bool MemoizedCall::find(Expression & result) const{
+  return (m_cache != nullptr) && m_cache->find(m_key, result);
+}
+
+void MemoizedCall::store(const Expression & result) const{
+  if(m_cache != nullptr){
+    m_cache->insert(m_key, result);
+  }
+}
+
+// Walks a lambda body, and the bodies of the lambdas it calls, for calls
+// that are not pure.
+class EffectAnalysis {
+public:
+
+  explicit EffectAnalysis(const Environment & env): m_env(env), m_callsLambda(false) {}
+
+  // determine if the body of closure is pure
+  bool pure(const Closure & closure);
+
+  bool callsLambda() const{
+    return m_callsLambda;
+  }
+
+private:
+
+  // names the frame of a body may bind: parameters and definitions
+  void collectLocals(const Expression & node, std::unordered_set<SymbolId> & locals) const;
+
+  bool pureNode(const Expression & node, const Environment & frame,
+                const std::unordered_set<SymbolId> & locals);
+
+  // determine if calling the procedure named is pure
+  bool pureProcedure(const Atom & name, const Environment & frame,
+                     const std::unordered_set<SymbolId> & locals);
+
+  const Environment & m_env;
+  bool m_callsLambda;
+
+  // the closures whose bodies are being or have been walked
+  std::unordered_set<const Closure *> m_visited;
+};
+
+bool EffectAnalysis::pure(const Closure & closure){
+  // a closure met again, as by recursion, is pure if the rest of its body is
+  if(!m_visited.insert(&closure).second){
+    return true;
+  }
+
+  std::unordered_set<SymbolId> locals;
+  for(const Atom & parameter : closure.parameters()){
+    locals.insert(parameter.asSymbolId());
+  }
+  collectLocals(closure.body(), locals);
+
+  Environment frame = m_env.closureFrame(closure.captured());
+  return pureNode(closure.body(), frame, locals);
+}
+
+void EffectAnalysis::collectLocals(const Expression & node, std::unordered_set<SymbolId> & locals) const{
+  if(node.isHeadList()){
+    return;
+  }
+  SymbolId id = node.head().asSymbolId();
+  if((id == DefineSymbol || id == LambdaSymbol) && node.getTailLength() > 0){
+    const Expression & names = *node.tailConstBegin();
+    locals.insert(names.head().asSymbolId());
+    for(auto it = names.tailConstBegin(); it != names.tailConstEnd(); ++it){
+      locals.insert(it->head().asSymbolId());
+    }
+  }
+  for(auto it = node.tailConstBegin(); it != node.tailConstEnd(); ++it){
+    collectLocals(*it, locals);
+  }
+}
+
+bool EffectAnalysis::pureNode(const Expression & node, const Environment & frame,
+                              const std::unordered_set<SymbolId> & locals){
+  const Atom & head = node.head();
+
+  // lookups and values
+  if(node.isHeadList() || (node.getTailLength() == 0 && head.asSymbolId() != ListSymbol)){
+    return true;
+  }
+
+  std::size_t first = 0;
+  switch(head.asSymbolId()){
+  case BeginSymbol:
+    break;
+  case DefineSymbol:
+    first = 1;
+    break;
+  case LambdaSymbol:
+    // making a closure calls nothing
+    return true;
+  case MapSymbol:
+  case ApplySymbol:
+  case PmapSymbol:
+  case PreduceSymbol:{
+    if(node.getTailLength() == 0){
+      return false;
+    }
+    // the procedure is a name or a lambda form, whose body runs here
+    const Expression & procedure = *node.tailConstBegin();
+    if(procedure.head().asSymbolId() == LambdaSymbol && procedure.getTailLength() == 2){
+      if(!pureNode(*(procedure.tailConstBegin() + 1), frame, locals)){
+	return false;
+      }
+    }
+    else if(procedure.getTailLength() != 0 || !pureProcedure(procedure.head(), frame, locals)){
+      return false;
+    }
+    first = 1;
+    break;
+  }
+  default:
+    if(Expression::isSpecialForm(head.asSymbolId())){
+      return false;
+    }
+    if(!pureProcedure(head, frame, locals)){
+      return false;
+    }
+    break;
+  }
+
+  for(auto it = node.tailConstBegin() + first; it < node.tailConstEnd(); ++it){
+    if(!pureNode(*it, frame, locals)){
+      return false;
+    }
+  }
+  return true;
+}
+
+bool EffectAnalysis::pureProcedure(const Atom & name, const Environment & frame,
+                                   const std::unordered_set<SymbolId> & locals){
+  // a procedure bound in the frame is only known when called
+  if(!name.isSymbol() || locals.find(name.asSymbolId()) != locals.end()){
+    return false;
+  }
+  if(frame.is_proc(name)){
+    return frame.is_pure(name);
+  }
+
+  Expression lambda = frame.get_exp(name);
+  const Closure * closure = lambda.head().asClosure();
+  if(closure == nullptr){
+    return false;
+  }
+  m_callsLambda = true;
+  return pure(*closure);
+}
+
+Effects analyzeEffects(const Closure & closure, const Environment & env){
+  EffectAnalysis analysis(env);
+  bool pure = analysis.pure(closure);
+  return Effects{pure, analysis.callsLambda()};
+}
@@ -0,0 +1,184 @@
+/*! \file memoization.hpp
+Defines the memo cache of lambda calls and the effect analysis deciding
+which calls go through it.
+
+Plotscript has no assignment: a lambda body only depends on its arguments,
+the bindings it captured and the global bindings it reads when called. A
+call is therefore cached under the closure, its epoch in the environment
+it is called in, which changes with every global definition and every
+definition in the bindings it captured, and the arguments, compared
+structurally.
+
+A lambda is pure when its body only calls pure built-ins and pure lambdas,
+named so the analysis can find them, and uses no special-form other than
+begin, define, lambda, map, apply, pmap and preduce. Calls of a pure lambda
+whose body calls a lambda, such as itself or a function it composes, go
+through the cache automatically; a pure lambda that only calls built-ins is
+cheaper to evaluate than to look up. The memoize special-form opts any lambda in.
+
+Calls are cached only when their arguments are terminals, lambdas and
+Lists of terminals and packed Lists, holding at most
+MemoizedCall::MaxArgumentNodes nodes: hashing and comparing larger
+arguments costs about as much as many calls, and a recursion down a long or
+deeply nested list would hash every level of it.
+ */
+#ifndef MEMOIZATION_HPP
+#define MEMOIZATION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "expression.hpp"
+
+class Closure;
+class Environment;
+
+/*! \struct MemoStatistics
+\brief The hit and miss counts and size of a memo cache.
+*/
+struct MemoStatistics {
+  std::size_t hits;
+  std::size_t misses;
+  std::size_t entries;
+  std::size_t capacity;
+};
+
+/*! \struct MemoKey
+\brief The closure, epoch and arguments of a call.
+*/
+struct MemoKey {
+  std::uint64_t closure;
+  std::uint64_t epoch;
+  std::vector<Expression> args;
+  std::size_t hash;
+
+  bool operator==(const MemoKey & other) const;
+};
+
+/*! \class MemoCache
+\brief A bounded cache of lambda call results, evicting the least recently
+       used.
+
+A MemoCache is shared by the copies of a global environment and may be used
+by several threads at once.
+*/
+class MemoCache {
+public:
+
+  /// the capacity of a new cache, in entries
+  static const std::size_t DefaultCapacity = 4096;
+
+  /// construct an empty cache
+  explicit MemoCache(std::size_t capacity = DefaultCapacity);
+
+  /*! Look up a call, counting a hit or a miss.
+    \param key the call
+    \param result set to the cached value on a hit
+    \return true on a hit
+  */
+  bool find(const MemoKey & key, Expression & result);
+
+  /// cache the value of a call, evicting the least recently used entries
+  /// beyond the capacity
+  void insert(const MemoKey & key, const Expression & result);
+
+  /// set the most entries kept, 0 to disable the cache
+  void setCapacity(std::size_t capacity);
+
+  /// return the most entries kept
+  std::size_t capacity() const;
+
+  /// return the hit and miss counts since the last reset, and the size
+  MemoStatistics statistics() const;
+
+  /// reset the hit and miss counts to zero
+  void resetStatistics();
+
+  /// remove every entry
+  void clear();
+
+private:
+
+  struct KeyHash {
+    std::size_t operator()(const MemoKey & key) const noexcept{
+      return key.hash;
+    }
+  };
+
+  // the keys from most to least recently used, pointing into m_entries
+  typedef std::list<const MemoKey *> Order;
+
+  struct Entry {
+    Expression value;
+    Order::iterator position;
+  };
+
+  // remove least recently used entries until at most capacity are left
+  void evict();
+
+  std::unordered_map<MemoKey, Entry, KeyHash> m_entries;
+  Order m_order;
+  std::size_t m_capacity;
+  std::size_t m_hits;
+  std::size_t m_misses;
+
+  // guards all of the above
+  mutable std::mutex m_mutex;
+};
+
+/*! \class MemoizedCall
+\brief The memo cache entry of one lambda call, looked up before the call
+       and filled in after it.
+*/
+class MemoizedCall {
+public:
+
+  /// the most nodes, counting each number of a packed List, the arguments
+  /// of a cached call may hold
+  static const std::size_t MaxArgumentNodes = 256;
+
+  /*! Prepare the entry of a call.
+    \param lambda the lambda value called
+    \param args the evaluated arguments, before they are bound
+    \param env the calling environment
+  */
+  MemoizedCall(const Expression & lambda, const std::vector<Expression> & args,
+               const Environment & env);
+
+  /// determine if the call goes through the cache
+  bool active() const noexcept;
+
+  /// look the call up, returning true and setting result on a hit
+  bool find(Expression & result) const;
+
+  /// cache the value of the call
+  void store(const Expression & result) const;
+
+private:
+
+  // the cache of the calling environment, nullptr if not active
+  MemoCache * m_cache;
+
+  MemoKey m_key;
+};
+
+/*! \struct Effects
+\brief What the effect analysis found about a lambda body.
+*/
+struct Effects {
+  bool pure;        //< only pure built-ins and pure lambdas are called
+  bool callsLambda; //< some call is of a lambda
+};
+
+/*! Analyze the body of a closure as it would be called in env.
+  \param closure the closure
+  \param env the calling environment, whose global bindings are used
+  \return the effects of the body
+*/
+Effects analyzeEffects(const Closure & closure, const Environment & env);
+
+#endif
@@ -661,9 +661,9 @@ void NotebookTest::testContinuousPlotLayout() {
 	auto scene = view->scene();
 
 	// first check total number of items
-	// 6 grid lines + 50 plot lines + 7 text = 63
+	// 6 grid lines + 32 plot lines + 7 text = 45
 	auto items = scene->items();
-	QCOMPARE(items.size(), 63);
+	QCOMPARE(items.size(), 45);
 
 	// make them all selectable
 	foreach(auto item, items) {
@@ -746,9 +746,9 @@ void NotebookTest::testSimpleContinuousPlot() {
 	auto scene = view->scene();
 
 	// first check total number of items
-	// 6 grid lines + 50 plot lines + 7 text = 63
+	// 6 grid lines + 32 plot lines + 7 text = 45
 	auto items = scene->items();
-	QCOMPARE(items.size(), 63);
+	QCOMPARE(items.size(), 45);
 
 	// make them all selectable
 	foreach(auto item, items) {
@@ -833,9 +833,9 @@ void NotebookTest::testQuadraticContinuousPlot() {
 	auto scene = view->scene();
 
 	// first check total number of items
-	// 6 grid lines + 50 plot lines + 7 text = 63
+	// 6 grid lines + 39 plot lines + 7 text = 52
 	auto items = scene->items();
-	QCOMPARE(items.size(), 80);
+	QCOMPARE(items.size(), 52);
 
 	// make them all selectable
 	foreach(auto item, items) {
@@ -917,9 +917,9 @@ void NotebookTest::testSineContinuousPlot() {
 	auto scene = view->scene();
 
 	// first check total number of items
-	// 6 grid lines + 74 plot lines + 7 text = 63
+	// 6 grid lines + 48 plot lines + 7 text = 61
 	auto items = scene->items();
-	QCOMPARE(items.size(), 87);
+	QCOMPARE(items.size(), 61);
 
 	// make them all selectable
 	foreach(auto item, items) {
@@ -48,7 +48,11 @@ void OutputWidget::output_Expression_as_qstring(Expression exp) {
 	QString myOutput;
 	Atom propertyCheck = Atom(std::string("\"object-name\""));
 	Expression myPropertyValue;
-	if (exp.checkProperty(propertyCheck)) {
+	// the items of a plot are drawn without making Expressions of them
+	if (exp.plotPrimitives() != nullptr) {
+		displayPlot(*exp.plotPrimitives());
+	}
+	else if (exp.checkProperty(propertyCheck)) {
 		myPropertyValue = exp.getProperty(propertyCheck);
 		if (myPropertyValue.head().asString() == "\"point\"") {
 			this->displayPoint(exp);
@@ -148,16 +152,20 @@ void OutputWidget::displayPoint(Expression exp) {
 		displayText(QString("Size property is less than 0"));
 	}
 	else {
-		double sizeOffest = exp.getProperty(mySize).head().asNumber() / 2;
-		QPointF myCenterPoint(exp.getValueInTail(0).head().asNumber() - sizeOffest, exp.getValueInTail(1).head().asNumber() - sizeOffest);
-		QSizeF myPointSize(exp.getProperty(mySize).head().asNumber(), exp.getProperty(mySize).head().asNumber());
-		QRectF myCoordinates(myCenterPoint, myPointSize);
-		QPen myPen(Qt::NoPen);
-		QBrush myBrush(Qt::black);
-		myScene->addEllipse(myCoordinates, myPen, myBrush);
+		drawPoint(exp.getValueInTail(0).head().asNumber(), exp.getValueInTail(1).head().asNumber(), exp.getProperty(mySize).head().asNumber());
 	}
 }
 
+void OutputWidget::drawPoint(double x, double y, double size) {
+	double sizeOffest = size / 2;
+	QPointF myCenterPoint(x - sizeOffest, y - sizeOffest);
+	QSizeF myPointSize(size, size);
+	QRectF myCoordinates(myCenterPoint, myPointSize);
+	QPen myPen(Qt::NoPen);
+	QBrush myBrush(Qt::black);
+	myScene->addEllipse(myCoordinates, myPen, myBrush);
+}
+
 void OutputWidget::displayLine(Expression exp) {
 	std::string thickness = "\"thickness\"";
 	Atom myThickness = thickness;
@@ -187,17 +195,23 @@ void OutputWidget::displayLine(Expression exp) {
 		displayText(QString("Thickness property is less than 0"));
 	}
 	else {
-		QPointF myPoint1(exp.getValueInTail(0).getValueInTail(0).head().asNumber(), exp.getValueInTail(0).getValueInTail(1).head().asNumber());
-		QPointF myPoint2(exp.getValueInTail(1).getValueInTail(0).head().asNumber(), exp.getValueInTail(1).getValueInTail(1).head().asNumber());
-		myLineFirstPoint = myPoint1;
-		myLineSecondPoint = myPoint2;
-		QLineF myLine(myPoint1, myPoint2);
-		QPen myPen(Qt::black, exp.getProperty(myThickness).head().asNumber(), Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin);
-		lineThickness = exp.getProperty(myThickness).head().asNumber();
-		myScene->addLine(myLine, myPen);
+		drawLine(exp.getValueInTail(0).getValueInTail(0).head().asNumber(), exp.getValueInTail(0).getValueInTail(1).head().asNumber(),
+			exp.getValueInTail(1).getValueInTail(0).head().asNumber(), exp.getValueInTail(1).getValueInTail(1).head().asNumber(),
+			exp.getProperty(myThickness).head().asNumber());
 	}
 }
 
+void OutputWidget::drawLine(double x1, double y1, double x2, double y2, double thickness) {
+	QPointF myPoint1(x1, y1);
+	QPointF myPoint2(x2, y2);
+	myLineFirstPoint = myPoint1;
+	myLineSecondPoint = myPoint2;
+	QLineF myLine(myPoint1, myPoint2);
+	QPen myPen(Qt::black, thickness, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin);
+	lineThickness = thickness;
+	myScene->addLine(myLine, myPen);
+}
+
 void OutputWidget::displayTextAtLocation(Expression exp) {
 	std::string position = "\"position\"";
 	Atom myPosition = position;
@@ -219,28 +233,52 @@ void OutputWidget::displayTextAtLocation(Expression exp) {
 
 	else {
 
-		double myScaleFactor = checkScale(exp);
-		double myAngle = checkRotation(exp);
+		drawText(exp.head().asString(), exp.getProperty(myPosition).getValueInTail(0).head().asNumber(),
+			exp.getProperty(myPosition).getValueInTail(1).head().asNumber(), checkScale(exp), checkRotation(exp));
+	}
+}
 
-		qreal myQx(exp.getProperty(myPosition).getValueInTail(0).head().asNumber());
-		qreal myQy(exp.getProperty(myPosition).getValueInTail(1).head().asNumber());
-		QGraphicsTextItem *myText = myScene->addText(QString::fromStdString((exp.head().asString().substr(1, exp.head().asString().size() -2))));
-		myLocationText = QString::fromStdString((exp.head().asString().substr(1, exp.head().asString().size() - 2)));
+void OutputWidget::drawText(const std::string & text, double x, double y, double scale, double angle) {
+	qreal myQx(x);
+	qreal myQy(y);
+	QGraphicsTextItem *myText = myScene->addText(QString::fromStdString((text.substr(1, text.size() - 2))));
+	myLocationText = QString::fromStdString((text.substr(1, text.size() - 2)));
 
-		QFont myFont("Monospace");
-		myFont.setStyleHint(QFont::TypeWriter);
-		myFont.setPointSize(myScaleFactor);
-		myText->setFont(myFont);
+	QFont myFont("Monospace");
+	myFont.setStyleHint(QFont::TypeWriter);
+	myFont.setPointSize(scale);
+	myText->setFont(myFont);
 
 
-		qreal widthOffset = myText->boundingRect().width() / 2;
-		qreal heightOffset = myText->boundingRect().height() / 2;
-		QPointF myPoint(myQx - widthOffset, myQy - heightOffset);
-		myTextLocation = myPoint;
-		myText->setPos(myPoint);
+	qreal widthOffset = myText->boundingRect().width() / 2;
+	qreal heightOffset = myText->boundingRect().height() / 2;
+	QPointF myPoint(myQx - widthOffset, myQy - heightOffset);
+	myTextLocation = myPoint;
+	myText->setPos(myPoint);
 
-		myText->setTransformOriginPoint(myText->boundingRect().center());
-		myText->setRotation(myAngle);
+	myText->setTransformOriginPoint(myText->boundingRect().center());
+	myText->setRotation(angle);
+}
+
+void OutputWidget::displayPlot(const PlotPrimitives & items) {
+	// the items of each kind are drawn in order, a run at a time
+	std::size_t point = 0, line = 0, text = 0;
+	for (const PlotPrimitives::Run & run : items.runs()) {
+		for (std::size_t i = 0; i < run.count; i++) {
+			if (run.kind == PlotPrimitives::PointKind) {
+				const PlotPoint & item = items.points()[point++];
+				drawPoint(item.x, item.y, item.size);
+			}
+			else if (run.kind == PlotPrimitives::LineKind) {
+				const PlotLine & item = items.lines()[line++];
+				drawLine(item.x1, item.y1, item.x2, item.y2, item.thickness);
+			}
+			else {
+				const PlotText & item = items.texts()[text++];
+				double angle = item.rotated ? item.rotation * 180 / (std::atan2(0, -1)) : 0;
+				drawText(item.text, item.x, item.y, item.scale > 0 ? item.scale : 1, angle);
+			}
+		}
 	}
 }
 
@@ -4,6 +4,7 @@
 #include <complex>
 #include <QWidget>
 #include "interpreter.hpp"
+#include "plot_primitives.hpp"
 #include "startup_config.hpp"
 #include <fstream>
 #include <iostream>
@@ -39,6 +40,10 @@ private:
 	void displayPoint(Expression exp);
 	void displayLine(Expression exp);
 	void displayTextAtLocation(Expression exp);
+	void displayPlot(const PlotPrimitives & items);
+	void drawPoint(double x, double y, double size);
+	void drawLine(double x1, double y1, double x2, double y2, double thickness);
+	void drawText(const std::string & text, double x, double y, double scale, double angle);
 	void output_Expression_as_qstring(Expression exp);
 	QString output_Atom_as_qstring(Atom a);
 	bool validPoint(Expression exp);
@@ -1,68 +1,112 @@
 #include "parse.hpp"
 
 #include <stack>
+#include <cctype>
 #include <iostream>
 
-bool setHead(Expression &exp, const Token &token) {
+bool setHead(Expression &exp, Atom &&a) {
 
-  Atom a(token);
+  bool ok = !a.isNone();
 
-  exp.head() = a;
+  exp.head() = std::move(a);
 
-  return !a.isNone();
+  return ok;
 }
 
-bool append(Expression *exp, const Token &token) {
+bool append(Expression *exp, Atom &&a) {
 
-  Atom a(token);
+  bool ok = !a.isNone();
 
-  exp->append(a);
+  exp->append(std::move(a));
 
-  return !a.isNone();
+  return ok;
 }
 
-Expression parse(const TokenSequenceType &tokens) noexcept {
+// Tokens read from a TokenSequenceType.
+class SequenceSource {
+public:
+  SequenceSource(const TokenSequenceType &tokens)
+      : m_pos(tokens.begin()), m_end(tokens.end()) {}
 
-  Expression ast;
+  bool next(Token::TokenType &type) {
+    if (m_pos == m_end) {
+      return false;
+    }
+    m_current = m_pos++;
+    type = m_current->type();
+    return true;
+  }
 
-  // cannot parse empty
-  if (tokens.empty())
-    return Expression();
+  Atom atom() const { return Atom(*m_current); }
+
+private:
+  TokenSequenceType::const_iterator m_pos, m_end, m_current;
+};
+
+// Tokens scanned one at a time from a character buffer.
+class BufferSource {
+public:
+  BufferSource(const char *source, std::size_t size)
+      : m_source(source), m_scanner(source, size) {}
+
+  bool next(Token::TokenType &type) {
+    if (!m_scanner.next(m_span)) {
+      return false;
+    }
+    type = m_span.type;
+    return true;
+  }
+
+  Atom atom() const { return Atom(m_source + m_span.offset, m_span.length); }
+
+private:
+  const char *m_source;
+  TokenScanner m_scanner;
+  TokenSpan m_span;
+};
+
+// Build an expression from the tokens of source, which provides
+// bool next(Token::TokenType &) and atom() for the last STRING token.
+template <typename TokenSource>
+Expression parseTokens(TokenSource &source) noexcept {
+
+  Expression ast;
 
   bool athead = false;
 
   // stack tracks the last node created
   std::stack<Expression *> stack;
 
-  std::size_t num_tokens_seen = 0;
+  Token::TokenType type;
+  bool more = source.next(type);
 
-  for (auto &t : tokens) {
-    if (t.type() == Token::OPEN) {
+  // cannot parse empty
+  if (!more)
+    return Expression();
+
+  for (; more; more = source.next(type)) {
+    if (type == Token::OPEN) {
       athead = true;
-    } else if (t.type() == Token::CLOSE) {
+    } else if (type == Token::CLOSE) {
       if (stack.empty()) {
         return Expression();
       }
       stack.pop();
 
       if (stack.empty()) {
-        num_tokens_seen += 1;
+        more = source.next(type);
         break;
       }
     } else {
 
       if (athead) {
         if (stack.empty()) {
-          if (!setHead(ast, t)) {
+          if (!setHead(ast, source.atom())) {
             return Expression();
           }
           stack.push(&ast);
         } else {
-          if (stack.empty()) {
-            return Expression();
-          }
-
-          if (!append(stack.top(), t)) {
+          if (!append(stack.top(), source.atom())) {
             return Expression();
           }
           stack.push(stack.top()->tail());
@@ -73,17 +117,117 @@ Expression parse(const TokenSequenceType &tokens) noexcept {
           return Expression();
         }
 
-        if (!append(stack.top(), t)) {
+        if (!append(stack.top(), source.atom())) {
           return Expression();
         }
       }
     }
-    num_tokens_seen += 1;
   }
 
-  if (stack.empty() && (num_tokens_seen == tokens.size())) {
+  // every token must belong to the expression
+  if (stack.empty() && !more) {
     return ast;
   }
 
   return Expression();
-};
+}
+
+Expression parse(const TokenSequenceType &tokens) noexcept {
+
+  SequenceSource source(tokens);
+
+  return parseTokens(source);
+}
+
+Expression parse(const char *source, std::size_t size) noexcept {
+
+  BufferSource buffer(source, size);
+
+  return parseTokens(buffer);
+}
+
+FormReader::FormReader(std::istream &stream, std::size_t chunkSize)
+    : m_stream(stream), m_chunkSize(chunkSize > 0 ? chunkSize : 1),
+      m_begin(0) {}
+
+bool FormReader::fill() {
+  std::size_t size = m_buffer.size();
+  m_buffer.resize(size + m_chunkSize);
+  m_stream.read(&m_buffer[size], m_chunkSize);
+  m_buffer.resize(size + m_stream.gcount());
+  return m_buffer.size() > size;
+}
+
+bool FormReader::next(std::string &form) {
+
+  // scanner state, kept while more of the stream is read
+  std::size_t pos = m_begin;
+  std::size_t start = std::string::npos;
+  int depth = 0;
+  bool inAtom = false;
+  bool inString = false;
+  bool inComment = false;
+  std::size_t end = std::string::npos;
+
+  while (end == std::string::npos) {
+    if (pos == m_buffer.size()) {
+      // drop the text already returned or skipped before reading more
+      std::size_t drop = (start == std::string::npos) ? pos : start;
+      m_buffer.erase(0, drop);
+      pos -= drop;
+      start = (start == std::string::npos) ? start : 0;
+      m_begin = 0;
+      if (!fill()) {
+        break;
+      }
+    }
+
+    for (; pos < m_buffer.size(); ++pos) {
+      char c = m_buffer[pos];
+
+      if (inComment) {
+        inComment = (c != '\n');
+      } else if (inString) {
+        inString = (c != '"');
+      } else if (inAtom && (c == '(' || c == ')' || c == ';' ||
+                            std::isspace(static_cast<unsigned char>(c)))) {
+        // a bare top-level atom ends at the next delimiter
+        end = pos;
+        break;
+      } else if (c == ';') {
+        inComment = true;
+      } else if (c == '(' || c == ')') {
+        if (start == std::string::npos) {
+          start = pos;
+        }
+        depth += (c == '(') ? 1 : -1;
+        if (depth <= 0) {
+          end = pos + 1;
+          break;
+        }
+      } else if (!std::isspace(static_cast<unsigned char>(c))) {
+        if (start == std::string::npos) {
+          start = pos;
+        }
+        inAtom = (depth == 0);
+        inString = (c == '"');
+      }
+    }
+  }
+
+  if (start == std::string::npos) {
+    // only whitespace and comments remain
+    return false;
+  }
+
+  if (end == std::string::npos) {
+    end = m_buffer.size();
+  }
+  form.assign(m_buffer, start, end - start);
+  m_begin = end;
+  return true;
+}
+
+std::size_t FormReader::buffered() const noexcept {
+  return m_buffer.size() - m_begin;
+}
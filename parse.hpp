@@ -4,6 +4,10 @@ Defines the parse function.
 #ifndef PARSE_HPP
 #define PARSE_HPP
 
+#include <cstddef>
+#include <istream>
+#include <string>
+
 #include "token.hpp"
 #include "expression.hpp"
 
@@ -15,4 +19,52 @@ Defines the parse function.
  */
 Expression parse(const TokenSequenceType & tokens) noexcept;
 
+/*! \fn parse
+\brief parse a character buffer into an expression (abstract syntax tree)
+
+Tokens are scanned and turned into atoms as the tree is built, so no token
+sequence is created. The result is the same as tokenizing the buffer and
+parsing the tokens.
+
+\param source, the first character of the buffer
+\param size, the number of characters in the buffer
+\returns the expression resulting from parsing or the None Expression on failure
+ */
+Expression parse(const char * source, std::size_t size) noexcept;
+
+/*! \class FormReader
+\brief Reads a stream one complete top-level form at a time.
+
+The stream is read in chunks only as far as needed to find the end of the
+next form, following the tokenizer's rules for comments and quoted strings,
+so the memory used is bounded by the largest form plus one chunk. Comments
+and whitespace between forms are dropped. A form may be a parenthesized
+expression, a bare atom, or a stray ")". If the stream ends inside a form,
+the unfinished text is returned as the last form, and it will not parse.
+*/
+class FormReader {
+public:
+
+  /// construct a reader of stream, reading chunkSize characters at a time
+  explicit FormReader(std::istream & stream, std::size_t chunkSize = 65536);
+
+  /// store the text of the next form in form, return false at the end of the stream
+  bool next(std::string & form);
+
+  /// return the number of characters read from the stream but not yet returned
+  std::size_t buffered() const noexcept;
+
+private:
+
+  // append the next chunk of the stream to the buffer, false at the end
+  bool fill();
+
+  std::istream & m_stream;
+  std::size_t m_chunkSize;
+
+  // characters read from the stream, those before m_begin are already returned
+  std::string m_buffer;
+  std::size_t m_begin;
+};
+
 #endif
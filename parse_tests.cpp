@@ -57,3 +57,77 @@ TEST_CASE( "Test empty parens", "[parse]" ) {
   REQUIRE(parse(tokens) == Expression());
 }
 
+
+TEST_CASE( "Test parsing a buffer", "[parse]" ) {
+
+  std::vector<std::string> programs = {
+    "(begin (define r 10) (* pi (* r r)))",
+    "(define s \"a (string) ; here\") ; trailing comment",
+    "(list 1 -2.5 3e2 .5 (list \"x\" y))",
+    "((begin (+ 1))))))",
+    "(define a 1.2abc)",
+    "+ 1 2",
+    "()",
+    "(+ 1 2) (+ 3 4)",
+    "(+ 1 2",
+    "",
+  };
+
+  for (auto &program : programs) {
+    INFO(program);
+    std::istringstream iss(program);
+    Expression expected = parse(tokenize(iss));
+    REQUIRE(parse(program.data(), program.size()) == expected);
+  }
+
+  std::string program = "(list 1 2.5)";
+  Expression exp = parse(program.data(), program.size());
+  REQUIRE(exp.getTailLength() == 2);
+  REQUIRE(exp.getValueInTail(1) == Expression(2.5));
+}
+
+TEST_CASE( "Test reading top-level forms", "[parse]" ) {
+
+  std::string program = "  ; a comment with (\n(define a 1)(+ a 2) \"a ) b\" sym;c\n"
+                        "(f \"s ; (\" ; )\n x)) (+ 1";
+  std::vector<std::string> expected = {"(define a 1)", "(+ a 2)", "\"a ) b\"", "sym",
+                                       "(f \"s ; (\" ; )\n x)", ")", "(+ 1"};
+
+  // the forms are the same however the stream is split into chunks
+  for (std::size_t chunk : {1, 2, 3, 7, 64, 65536}) {
+    INFO(chunk);
+    std::istringstream iss(program);
+    FormReader reader(iss, chunk);
+    std::string form;
+    std::vector<std::string> forms;
+    while (reader.next(form)) {
+      forms.push_back(form);
+    }
+    REQUIRE(forms == expected);
+    REQUIRE(!reader.next(form));
+  }
+
+  std::istringstream blank(" ; only a comment\n\t");
+  FormReader reader(blank);
+  std::string form;
+  REQUIRE(!reader.next(form));
+}
+
+TEST_CASE( "Test reading forms in bounded memory", "[parse]" ) {
+
+  std::string program;
+  for (int i = 0; i < 2000; ++i) {
+    program += "(define x" + std::to_string(i) + " (list 1 2 3)) ; form\n";
+  }
+
+  std::istringstream iss(program);
+  FormReader reader(iss, 256);
+  std::string form;
+  std::size_t count = 0;
+  while (reader.next(form)) {
+    REQUIRE(parse(form.data(), form.size()) != Expression());
+    REQUIRE(reader.buffered() <= 256);
+    ++count;
+  }
+  REQUIRE(count == 2000);
+}
@@ -0,0 +1,131 @@
+#include "plot_buffer.hpp"
+
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+#include "plot_primitives.hpp"
+#include "vector_kernels.hpp"
+
+// the size of a point and thickness of a line
+static const double PointSize = 0.5;
+static const double LineThickness = 0.0;
+
+void PlotBuffer::computeBounds(){
+  if(x.empty()){
+    minX = maxX = minY = maxY = 0;
+    return;
+  }
+  vectorMinMax(x.data(), x.size(), minX, maxX);
+  vectorMinMax(y.data(), y.size(), minY, maxY);
+}
+
+// the position of an abscissa in the plot's square
+static double plotX(const PlotBuffer & plot, double x){
+  return (x / (plot.maxX - plot.minX)) * 20;
+}
+
+// the position of an ordinate in the plot's square
+static double plotY(const PlotBuffer & plot, double y){
+  return -(y / (plot.maxY - plot.minY)) * 20;
+}
+
+static PlotLine line(double x1, double y1, double x2, double y2){
+  return PlotLine{x1, y1, x2, y2, LineThickness};
+}
+
+static PlotText text(const std::string & value, double x, double y, double scale){
+  return PlotText{value, x, y, scale, false, 0};
+}
+
+// the bound formatted as the axis shows it
+static std::string axisText(double bound){
+  std::stringstream out;
+  out << std::setprecision(2) << bound;
+  return "\"" + out.str() + "\"";
+}
+
+void PlotBuffer::addPoints(PlotPrimitives & items) const{
+  items.reserve(PlotPrimitives::PointKind, x.size());
+  for(std::size_t i = 0; i < x.size(); ++i){
+    items.addPoint(PlotPoint{plotX(*this, x[i]), plotY(*this, y[i]), PointSize});
+  }
+}
+
+void PlotBuffer::addLines(PlotPrimitives & items) const{
+  if(x.size() < 2){
+    return;
+  }
+  items.reserve(PlotPrimitives::LineKind, x.size() - 1);
+  for(std::size_t i = 1; i < x.size(); ++i){
+    items.addLine(line(plotX(*this, x[i - 1]), plotY(*this, y[i - 1]), plotX(*this, x[i]), plotY(*this, y[i])));
+  }
+}
+
+void PlotBuffer::addStems(PlotPrimitives & items) const{
+
+  // stems rise from the abscissa, or from the edge of the plot nearest it
+  // when it is outside
+  double bottom = 0;
+  if(maxY < 0){
+    bottom = maxY;
+  }
+  else if(minY > 0){
+    bottom = minY;
+  }
+
+  items.reserve(PlotPrimitives::LineKind, x.size());
+  for(std::size_t i = 0; i < x.size(); ++i){
+    double stem = plotX(*this, x[i]);
+    items.addLine(line(stem, plotY(*this, bottom), stem, plotY(*this, y[i])));
+  }
+}
+
+void PlotBuffer::addFrame(PlotPrimitives & items) const{
+  double left = plotX(*this, minX);
+  double right = plotX(*this, maxX);
+  double bottom = plotY(*this, minY);
+  double top = plotY(*this, maxY);
+
+  items.addLine(line(left, bottom, left, top));
+  items.addLine(line(left, bottom, right, bottom));
+  items.addLine(line(right, bottom, right, top));
+  items.addLine(line(left, top, right, top));
+}
+
+void PlotBuffer::addOrigin(PlotPrimitives & items) const{
+  if(minX <= 0 && maxX >= 0){
+    items.addLine(line(plotX(*this, 0), plotY(*this, minY), plotX(*this, 0), plotY(*this, maxY)));
+  }
+  if(minY <= 0 && maxY >= 0){
+    items.addLine(line(plotX(*this, minX), plotY(*this, 0), plotX(*this, maxX), plotY(*this, 0)));
+  }
+}
+
+void PlotBuffer::addAxis(PlotPrimitives & items, double textScale) const{
+  double left = plotX(*this, minX);
+  double right = plotX(*this, maxX);
+  double bottom = plotY(*this, minY);
+  double top = plotY(*this, maxY);
+
+  items.addText(text(axisText(minX), left, bottom + 2, textScale));
+  items.addText(text(axisText(minY), left - 2, bottom, textScale));
+  items.addText(text(axisText(maxY), left - 2, top, textScale));
+  items.addText(text(axisText(maxX), right, bottom + 2, textScale));
+}
+
+void PlotBuffer::addLabels(PlotPrimitives & items, const std::string & title, const std::string & xAxis,
+                           const std::string & yAxis, double textScale) const{
+  if(!title.empty()){
+    items.addText(text(title, ((minX) / (maxX - minX) * 20) + 10, (-(maxY) / (maxY - minY) * 20) - 3, textScale));
+  }
+  if(!xAxis.empty()){
+    items.addText(text(xAxis, ((minX) / (maxX - minX) * 20) + 10, (-(minY) / (maxY - minY) * 20) + 3, textScale));
+  }
+  if(!yAxis.empty()){
+    PlotText label = text(yAxis, ((minX) / (maxX - minX) * 20) - 3, (-(minY) / (maxY - minY) * 20) - 10, textScale);
+    label.rotated = true;
+    label.rotation = std::atan2(-1, 0);
+    items.addText(std::move(label));
+  }
+}
@@ -0,0 +1,50 @@
+/*! \file plot_buffer.hpp
+Defines the coordinate buffer the plot special-forms draw from.
+
+discrete-plot and continuous-plot gather the points they draw into a pair
+of contiguous buffers once, find the bounds of the plot in one vectorized
+pass over each, and build every item of the plot from the buffers.
+
+A plot is drawn in a square of side 20, the ordinate growing downwards.
+ */
+#ifndef PLOT_BUFFER_HPP
+#define PLOT_BUFFER_HPP
+
+#include <string>
+#include <vector>
+
+class PlotPrimitives;
+
+/*! \struct PlotBuffer
+\brief The points of a plot and its bounds.
+*/
+struct PlotBuffer {
+
+  std::vector<double> x;
+  std::vector<double> y;
+
+  double minX = 0;
+  double maxX = 0;
+  double minY = 0;
+  double maxY = 0;
+
+  /// set the bounds to the least and greatest coordinates, 0 when there
+  /// are no points
+  void computeBounds();
+
+  /// add the items of the plot, scaled into its square, once the bounds
+  /// are set
+  void addPoints(PlotPrimitives & items) const;
+  void addLines(PlotPrimitives & items) const;
+  void addStems(PlotPrimitives & items) const;
+  void addFrame(PlotPrimitives & items) const;
+  void addOrigin(PlotPrimitives & items) const;
+  void addAxis(PlotPrimitives & items, double textScale) const;
+
+  /// add the title and axis labels that are not empty, quoted as string
+  /// Atoms hold them
+  void addLabels(PlotPrimitives & items, const std::string & title, const std::string & xAxis,
+                 const std::string & yAxis, double textScale) const;
+};
+
+#endif
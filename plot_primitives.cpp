@@ -0,0 +1,57 @@
+#include "plot_primitives.hpp"
+
+void PlotPrimitives::extend(Kind kind){
+  if(m_runs.empty() || m_runs.back().kind != kind){
+    m_runs.push_back(Run{kind, 0});
+  }
+  ++m_runs.back().count;
+}
+
+void PlotPrimitives::addPoint(const PlotPoint & point){
+  m_points.push_back(point);
+  extend(PointKind);
+}
+
+void PlotPrimitives::addLine(const PlotLine & line){
+  m_lines.push_back(line);
+  extend(LineKind);
+}
+
+void PlotPrimitives::addText(PlotText && text){
+  m_texts.push_back(std::move(text));
+  extend(TextKind);
+}
+
+void PlotPrimitives::reserve(Kind kind, std::size_t count){
+  switch(kind){
+  case PointKind:
+    m_points.reserve(m_points.size() + count);
+    break;
+  case LineKind:
+    m_lines.reserve(m_lines.size() + count);
+    break;
+  case TextKind:
+    m_texts.reserve(m_texts.size() + count);
+    break;
+  }
+}
+
+std::size_t PlotPrimitives::size() const noexcept{
+  return m_points.size() + m_lines.size() + m_texts.size();
+}
+
+const std::vector<PlotPoint> & PlotPrimitives::points() const noexcept{
+  return m_points;
+}
+
+const std::vector<PlotLine> & PlotPrimitives::lines() const noexcept{
+  return m_lines;
+}
+
+const std::vector<PlotText> & PlotPrimitives::texts() const noexcept{
+  return m_texts;
+}
+
+const std::vector<PlotPrimitives::Run> & PlotPrimitives::runs() const noexcept{
+  return m_runs;
+}
@@ -0,0 +1,105 @@
+/*! \file plot_primitives.hpp
+Defines the compact form of the items a plot special-form returns.
+
+discrete-plot and continuous-plot return a List of points, lines and text,
+each an Expression with the properties of make-point, make-line and
+make-text. A large plot holds millions of such nodes, so the plot forms
+store their items as plain structs instead. The List holding them converts
+them to Expressions the first time its elements are read, and OutputWidget
+draws them without converting them at all.
+ */
+#ifndef PLOT_PRIMITIVES_HPP
+#define PLOT_PRIMITIVES_HPP
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "expression.hpp"
+
+/// a point, drawn as a disc of diameter size centred at (x, y)
+struct PlotPoint {
+  double x;
+  double y;
+  double size;
+};
+
+/// a line from (x1, y1) to (x2, y2)
+struct PlotLine {
+  double x1;
+  double y1;
+  double x2;
+  double y2;
+  double thickness;
+};
+
+/// text centred at (x, y), quoted as a string Atom holds it
+struct PlotText {
+  std::string text;
+  double x;
+  double y;
+  double scale;
+  bool rotated;
+  double rotation;
+};
+
+/*! \class PlotPrimitives
+\brief The items of a plot, in the order they were added.
+
+The items are built on one thread and are then only read, so a
+PlotPrimitives may be shared by Expressions on any number of threads.
+*/
+class PlotPrimitives {
+public:
+
+  /// the kinds of item
+  enum Kind {PointKind, LineKind, TextKind};
+
+  /// consecutive items of one kind, the order of the items is that of
+  /// the runs
+  struct Run {
+    Kind kind;
+    std::size_t count;
+  };
+
+  PlotPrimitives() = default;
+
+  PlotPrimitives(const PlotPrimitives &) = delete;
+  PlotPrimitives & operator=(const PlotPrimitives &) = delete;
+
+  /// add an item after the others
+  void addPoint(const PlotPoint & point);
+  void addLine(const PlotLine & line);
+  void addText(PlotText && text);
+
+  /// reserve room for more items of a kind
+  void reserve(Kind kind, std::size_t count);
+
+  /// return the number of items
+  std::size_t size() const noexcept;
+
+  /// return the items of each kind, in order
+  const std::vector<PlotPoint> & points() const noexcept;
+  const std::vector<PlotLine> & lines() const noexcept;
+  const std::vector<PlotText> & texts() const noexcept;
+
+  /// return the runs of items of one kind
+  const std::vector<Run> & runs() const noexcept;
+
+private:
+  friend class Expression;
+
+  void extend(Kind kind);
+
+  std::vector<PlotPoint> m_points;
+  std::vector<PlotLine> m_lines;
+  std::vector<PlotText> m_texts;
+  std::vector<Run> m_runs;
+
+  // the items as Expressions, built by Expression on first use
+  mutable std::once_flag m_expanded;
+  mutable std::vector<Expression> m_expressions;
+};
+
+#endif
@@ -6,10 +6,15 @@
 #include "handleInterrupt.hpp"
 #include "startup_config.hpp"
 #include "interpreter.hpp"
+#include "parse.hpp"
+#include "ast_cache.hpp"
 #include "semantic_error.hpp"
 #include "threadQueue.hpp"
 #include "consumer.hpp"
 
+// cleared by --no-fold, applied to every Interpreter made here
+static bool foldConstants = true;
+
 void prompt() {
 	std::cout << "\nplotscript> ";
 }
@@ -62,37 +67,65 @@ int eval_startup(Interpreter &interp) {
 	return EXIT_SUCCESS;
 }
 
-int eval_from_stream(std::istream & stream) {
+// evaluates the form last parsed by interp, reporting its result or error
+bool eval_form(Interpreter & interp, bool parsed) {
 
-	Interpreter interp;
-	eval_startup(interp);
-	if (!interp.parseStream(stream)) {
+	if (!parsed) {
 		error("Invalid Program. Could not parse.");
-		return EXIT_FAILURE;
+		return false;
 	}
-	else {
-		try {
-			Expression exp = interp.evaluate();
-			std::cout << exp << std::endl;
-		}
-		catch (const SemanticError & ex) {
-			std::cerr << ex.what() << std::endl;
-			return EXIT_FAILURE;
-		}
+	try {
+		Expression exp = interp.evaluate();
+		std::cout << exp << std::endl;
 	}
-	return EXIT_SUCCESS;
+	catch (const SemanticError & ex) {
+		std::cerr << ex.what() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// parses the whole stream as one program before evaluating it
+int eval_from_stream(std::istream & stream) {
+
+	Interpreter interp;
+	interp.setConstantFolding(foldConstants);
+	eval_startup(interp);
+	return eval_form(interp, interp.parseStream(stream)) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
+// evaluates each top-level form of the file in turn, reporting its result or
+// error, so only one form is held in memory at a time; the forms are read
+// from the file's AST cache when it is valid
 int eval_from_file(std::string filename) {
 
-	std::ifstream ifs(filename);
-	if (!ifs) {
+	ScriptReader reader(filename);
+	if (!reader.isOpen()) {
 		error("Could not open file for reading.");
 		return EXIT_FAILURE;
 	}
-	return eval_from_stream(ifs);
+
+	Interpreter interp;
+	interp.setConstantFolding(foldConstants);
+	eval_startup(interp);
+
+	int status = EXIT_SUCCESS;
+	Expression form;
+	bool empty = true;
+	while (reader.next(form)) {
+		empty = false;
+		if (!eval_form(interp, interp.load(form))) {
+			status = EXIT_FAILURE;
+		}
+	}
+	if (empty) {
+		error("Invalid Program. Could not parse.");
+		return EXIT_FAILURE;
+	}
+	return status;
 }
 
+// a -e program is parsed whole, so it must be a single form
 int eval_from_command(std::string argexp) {
 
 	std::istringstream expression(argexp);
@@ -120,6 +153,7 @@ void repl() {
 	ThreadSafeQueue<std::string> * stringQueue = new ThreadSafeQueue<std::string>();
 	ThreadSafeQueue<Expression> * expressionQueue = new ThreadSafeQueue<Expression>();
 	Interpreter * interp = new Interpreter();
+	interp->setConstantFolding(foldConstants);
 	Consumer * input = new Consumer(stringQueue, expressionQueue, interp);
 	std::thread * consumer_th1 = new std::thread(*input);
 	bool activeKernel = true;			//start kernel running
@@ -176,6 +210,7 @@ void repl() {
 			}
 
 			interp = new Interpreter();
+			interp->setConstantFolding(foldConstants);
 			input = new Consumer(stringQueue, expressionQueue, interp);
 			consumer_th1 = new std::thread(*input);
 			activeKernel = true;
@@ -221,6 +256,36 @@ void repl() {
 int main(int argc, char *argv[])
 {
 	install_handler();
+
+	// leading options: -j N sets the number of threads pmap and preduce run
+	// on, --no-fold turns off constant folding of lambda bodies
+	while (argc >= 2) {
+		std::string option(argv[1]);
+		if (option == "-j" && argc >= 3) {
+			long threads = 0;
+			try {
+				threads = std::stol(argv[2]);
+			}
+			catch (const std::exception &) {
+			}
+			if (threads < 1) {
+				error("Invalid number of threads.");
+				return EXIT_FAILURE;
+			}
+			Executor::setDefaultSize(static_cast<std::size_t>(threads));
+			argc -= 2;
+			argv += 2;
+		}
+		else if (option == "--no-fold") {
+			foldConstants = false;
+			argc -= 1;
+			argv += 1;
+		}
+		else {
+			break;
+		}
+	}
+
 	if (argc == 2) {
 		return eval_from_file(argv[1]);
 	}
@@ -54,6 +54,26 @@ class TestExecuteCommandline(unittest.TestCase):
                 self.assertNotEqual(retcode, 0)
                 self.assertTrue(output.strip().startswith(b'Error'))
 
+        def test_several_forms(self):
+                args = ' -e ' + ' "(1) (2)" '
+                (output, retcode) = pexpect.run(cmd+args, withexitstatus=True, extra_args=args)
+                self.assertNotEqual(retcode, 0)
+                self.assertTrue(output.strip().startswith(b'Error'))
+
+        def test_unbalanced(self):
+                args = ' -e ' + ' "(+ 1 2))" '
+                (output, retcode) = pexpect.run(cmd+args, withexitstatus=True, extra_args=args)
+                self.assertNotEqual(retcode, 0)
+                self.assertTrue(output.strip().startswith(b'Error'))
+
+        def test_no_fold(self):
+                program = '"(begin (define f (lambda (x) (+ x (* 2 3)))) (f 1))"'
+                for options in [' ', ' --no-fold ', ' --no-fold -j 2 ', ' -j 2 --no-fold ']:
+                        args = options + '-e ' + program
+                        (output, retcode) = pexpect.run(cmd+args, withexitstatus=True, extra_args=args)
+                        self.assertEqual(retcode, 0)
+                        self.assertEqual(output.strip(), b"(7)")
+
 class TestExecuteFromFile(unittest.TestCase):
                 
         def test_unix(self):
@@ -0,0 +1,116 @@
+/*! \file shared_container.hpp
+Defines a copy-on-write handle to a standard container.
+ */
+#ifndef SHARED_CONTAINER_HPP
+#define SHARED_CONTAINER_HPP
+
+#include <memory>
+
+/*! \class SharedContainer
+\brief A copy-on-write handle to a standard container.
+
+Copies of a SharedContainer share the same storage, so copying is O(1)
+regardless of the container size. Reading never copies. The first call to
+write() on a handle whose storage is shared with another handle clones the
+storage, so every handle keeps value semantics. An empty handle owns no
+storage at all.
+
+The reference count is atomic, so handles sharing storage may be copied
+and read from different threads.
+*/
+template <typename Container>
+class SharedContainer {
+public:
+
+  typedef typename Container::const_iterator const_iterator;
+  typedef typename Container::size_type size_type;
+  typedef typename Container::value_type value_type;
+
+  /// return true if the container has no elements
+  bool empty() const noexcept {
+    return !m_data || m_data->empty();
+  }
+
+  /// return the number of elements
+  size_type size() const noexcept {
+    return m_data ? m_data->size() : 0;
+  }
+
+  /// return a const-iterator to the first element
+  const_iterator begin() const noexcept {
+    return get().cbegin();
+  }
+
+  /// return a const-iterator past the last element
+  const_iterator end() const noexcept {
+    return get().cend();
+  }
+
+  /// return read-only access to the container
+  const Container & get() const noexcept {
+    return m_data ? *m_data : emptyContainer();
+  }
+
+  /// return the element at index (sequence containers only)
+  const value_type & operator[](size_type index) const {
+    return (*m_data)[index];
+  }
+
+  /// return the last element (sequence containers only)
+  const value_type & back() const {
+    return m_data->back();
+  }
+
+  /// return writable access to the container, cloning it first if shared
+  Container & write() {
+    if (!m_data) {
+      m_data = std::make_shared<Container>();
+    }
+    else if (m_data.use_count() > 1) {
+      m_data = std::make_shared<Container>(*m_data);
+    }
+    return *m_data;
+  }
+
+  /// empty the handle and return its elements, moving them if not shared
+  Container take() {
+    Container result;
+    if (m_data) {
+      if (m_data.use_count() == 1) {
+        result = std::move(*m_data);
+      }
+      else {
+        result = *m_data;
+      }
+      m_data.reset();
+    }
+    return result;
+  }
+
+  /// release this handle's storage
+  void clear() noexcept {
+    m_data.reset();
+  }
+
+  /// return true if this handle is the only one referring to its storage
+  bool unique() const noexcept {
+    return m_data && m_data.use_count() == 1;
+  }
+
+  /// return true if both handles refer to the same storage
+  bool sameStorage(const SharedContainer & other) const noexcept {
+    return m_data == other.m_data;
+  }
+
+private:
+
+  // a single empty container used for reads through an empty handle
+  static const Container & emptyContainer() noexcept {
+    static const Container empty;
+    return empty;
+  }
+
+  std::shared_ptr<Container> m_data;
+};
+
+#endif
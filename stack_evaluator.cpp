@@ -0,0 +1,467 @@
+#include "stack_evaluator.hpp"
+
+#include <iterator>
+
+#include "memoization.hpp"
+#include "semantic_error.hpp"
+
+StackEvaluator::StackEvaluator() noexcept: m_depthLimit(DefaultDepthLimit) {}
+
+void StackEvaluator::setDepthLimit(std::size_t limit) noexcept{
+  m_depthLimit = limit;
+}
+
+std::size_t StackEvaluator::depthLimit() const noexcept{
+  return m_depthLimit;
+}
+
+void StackEvaluator::push(std::vector<Task> & tasks, const Task & task) const{
+  if(tasks.size() >= m_depthLimit){
+    throw SemanticError("Error during evaluation: maximum evaluation depth exceeded");
+  }
+  tasks.push_back(task);
+}
+
+// the checks Expression::eval makes before evaluating the value of a define
+static bool validDefine(const Expression & node, const Environment & env){
+  if(node.getTailLength() != 2 || !node.tailConstBegin()->isHeadSymbol()){
+    return false;
+  }
+  SymbolId s = node.tailConstBegin()->head().asSymbolId();
+  if((s == DefineSymbol) || (s == BeginSymbol) || (s == LambdaSymbol) || (s == MapSymbol) || (s == ApplySymbol)){
+    return false;
+  }
+  return !env.is_known(node.head());
+}
+
+// the checks Expression::eval makes before evaluating any operand of apply,
+// map, pmap or preduce
+static bool validProcedureForm(const Expression & node, const Environment & env){
+  switch(node.head().asSymbolId()){
+  case PmapSymbol:
+    return node.getTailLength() == 2;
+  case PreduceSymbol:
+    return node.getTailLength() == 3;
+  default:
+    break;
+  }
+  if(node.getTailLength() != 2 || !node.tailConstBegin()->isHeadSymbol()){
+    return false;
+  }
+  SymbolId s = node.tailConstBegin()->head().asSymbolId();
+  if((s == DefineSymbol) || (s == BeginSymbol)){
+    return false;
+  }
+  return !env.is_proc(node.head()) && !env.is_exp(node.head());
+}
+
+// determine if the first operand of a procedure form must be evaluated to
+// find its procedure, as a call returning a lambda
+static bool procedureCall(const Expression & operand, const Environment & env){
+  return operand.isHeadSymbol() && operand.getTailLength() > 0 &&
+    operand.head().asSymbolId() != LambdaSymbol && env.is_exp(operand.head());
+}
+
+// find the procedure the first operand of a procedure form names, as
+// Expression::eval does; value is the lambda, set here for a name, and proc
+// the builtin. Return false if there is neither, or true leaving both unset
+// for a lambda form.
+static bool procedureOperand(const Expression & node, const Environment & env, Expression & value, Procedure & proc){
+  const Expression & operand = *node.tailConstBegin();
+  if(!operand.isHeadSymbol()){
+    return false;
+  }
+  if(operand.head().asSymbolId() == LambdaSymbol){
+    return true;
+  }
+  if(env.is_exp(operand.head())){
+    if(operand.getTailLength() == 0){
+      value = env.get_exp(operand.head());
+    }
+    return value.isHeadLambda();
+  }
+  if(env.is_proc(operand.head())){
+    proc = env.get_proc(operand.head());
+    return true;
+  }
+  return false;
+}
+
+// the List of the values, packed if they are all plain numbers
+static Expression listOf(std::vector<Expression>::iterator begin, std::vector<Expression>::iterator end){
+  bool numbers = true;
+  for(auto it = begin; numbers && it != end; ++it){
+    numbers = it->isPlainNumber();
+  }
+  if(numbers){
+    std::vector<double> packed;
+    packed.reserve(end - begin);
+    for(auto it = begin; it != end; ++it){
+      packed.push_back(it->head().asNumber());
+    }
+    return Expression(std::move(packed));
+  }
+  return Expression(Atom(true), std::vector<Expression>(std::make_move_iterator(begin), std::make_move_iterator(end)));
+}
+
+// map a builtin over an evaluated list, as Expression::eval does
+static Expression mapBuiltin(const Atom & name, Procedure proc, const Expression & list, const Environment & env){
+  double (*unary)(double) = env.get_numeric(name).unary;
+  if(unary != nullptr && list.isPacked()){
+    std::vector<double> numbers;
+    numbers.reserve(list.getTailLength());
+    for(double x : list.packedValues()){
+      numbers.push_back(unary(x));
+    }
+    return Expression(std::move(numbers));
+  }
+  std::vector<Expression> results;
+  results.reserve(list.getTailLength());
+  std::vector<Expression> args(1);
+  for(auto it = list.tailConstBegin(); it != list.tailConstEnd(); ++it){
+    args[0] = *it;
+    results.push_back(proc(args));
+  }
+  return listOf(results.begin(), results.end());
+}
+
+// the stages of the procedure form tasks, in their next member: the first
+// operand was evaluated, the others were, the procedure is being called with
+// each element; and the first operand names no procedure, raising an error
+// once the others were evaluated
+static const std::uint32_t ProcedureEvaluated = 0;
+static const std::uint32_t OperandsEvaluated = 1;
+static const std::uint32_t Calling = 2;
+static const std::uint32_t NoProcedure = static_cast<std::uint32_t>(-1);
+
+Expression StackEvaluator::evaluate(const Expression & program, Environment & env){
+
+  std::vector<Task> tasks;
+  std::vector<Expression> values;
+  std::deque<Frame> frames;
+  std::vector<MemoizedCall> memos;
+
+  // call lambda with evaluated args, pushing its value; tail is true if
+  // the value is that of the innermost lambda body
+  auto callLambda = [&](const Expression & lambda, std::vector<Expression> & args, Environment & callerEnv, bool tail){
+    Expression value;
+    MemoizedCall memo(lambda, args, callerEnv);
+    if(memo.find(value)){
+      values.push_back(std::move(value));
+      return;
+    }
+    bool tailCall = tail && !frames.empty() && &callerEnv == &frames.back().env;
+    if(memo.active() && !tailCall){
+      // the value of the body, or of a call replacing it, is cached; a
+      // tail call is not, so tail recursion keeps running in constant space
+      push(tasks, Task{MemoTask, false, 0, &program, &callerEnv, 0});
+      memos.push_back(std::move(memo));
+    }
+
+    Expression body;
+    Environment frame = Expression::bindLambda(lambda, args, callerEnv, body);
+
+    if(tailCall){
+      // a tail call replaces the frame of the calling body, which the
+      // new frame does not chain to
+      frames.back().env = std::move(frame);
+      frames.back().body = std::move(body);
+    }
+    else{
+      push(tasks, Task{FrameTask, false, 0, &program, &callerEnv, 0});
+      frames.push_back(Frame{std::move(frame), std::move(body)});
+    }
+    push(tasks, Task{EvalTask, true, 0, &frames.back().body, &frames.back().env, 0});
+  };
+
+  push(tasks, Task{EvalTask, false, 0, &program, &env, 0});
+
+  while(!tasks.empty()){
+    Task task = tasks.back();
+    tasks.pop_back();
+    const Expression & node = *task.node;
+
+    switch(task.kind){
+    case EvalTask:{
+      if(task.env->checkEnvInterrupt()){
+	throw SemanticError("Error: interpreter kernel interrupted");
+      }
+
+      // terminal expressions and List values do not recurse
+      if(node.getTailLength() == 0 || node.isHeadList()){
+	values.push_back(node.eval(*task.env));
+	break;
+      }
+
+      switch(node.head().asSymbolId()){
+      case BeginSymbol:
+	push(tasks, Task{BeginTask, task.tail, 0, &node, task.env, values.size()});
+	break;
+      case DefineSymbol:
+	if(!validDefine(node, *task.env)){
+	  // raises the error
+	  values.push_back(node.eval(*task.env));
+	  break;
+	}
+	push(tasks, Task{DefineTask, false, 0, &node, task.env, values.size()});
+	push(tasks, Task{EvalTask, false, 0, &*(node.tailConstBegin() + 1), task.env, 0});
+	break;
+      case ApplySymbol:
+      case MapSymbol:
+      case PmapSymbol:
+      case PreduceSymbol:{
+	if(!validProcedureForm(node, *task.env)){
+	  // raises the error
+	  values.push_back(node.eval(*task.env));
+	  break;
+	}
+	TaskKind kind = (node.head().asSymbolId() == ApplySymbol) ? ApplyTask :
+	  (node.head().asSymbolId() == PreduceSymbol) ? ReduceTask : MapTask;
+	push(tasks, Task{kind, task.tail, ProcedureEvaluated, &node, task.env, values.size()});
+	if(procedureCall(*node.tailConstBegin(), *task.env)){
+	  push(tasks, Task{EvalTask, false, 0, &*node.tailConstBegin(), task.env, 0});
+	}
+	else{
+	  values.push_back(Expression());
+	}
+	break;
+      }
+      default:
+	// the other special-forms recurse through Expression::eval
+	if(Expression::isSpecialForm(node.head().asSymbolId())){
+	  values.push_back(node.eval(*task.env));
+	  break;
+	}
+	push(tasks, Task{CallTask, task.tail, 0, &node, task.env, values.size()});
+	break;
+      }
+      break;
+    }
+
+    case BeginTask:{
+      // only the value of the last form is kept
+      if(task.next > 0){
+	values.pop_back();
+      }
+      const Expression * form = &*(node.tailConstBegin() + task.next);
+      if(task.next + 1 < node.getTailLength()){
+	push(tasks, Task{BeginTask, task.tail, task.next + 1, &node, task.env, task.base});
+	push(tasks, Task{EvalTask, false, 0, form, task.env, 0});
+      }
+      else{
+	push(tasks, Task{EvalTask, task.tail, 0, form, task.env, 0});
+      }
+      break;
+    }
+
+    case CallTask:{
+      if(task.next < node.getTailLength()){
+	const Expression * operand = &*(node.tailConstBegin() + task.next);
+	push(tasks, Task{CallTask, task.tail, task.next + 1, &node, task.env, task.base});
+	push(tasks, Task{EvalTask, false, 0, operand, task.env, 0});
+	break;
+      }
+
+      // a builtin call on plain numbers takes the values in place
+      Expression value;
+      if(task.env->apply_numeric(node.head(), values.data() + task.base, values.size() - task.base, value)){
+	values.resize(task.base);
+	values.push_back(std::move(value));
+	break;
+      }
+
+      std::vector<Expression> args;
+      args.reserve(values.size() - task.base);
+      for(auto it = values.begin() + task.base; it != values.end(); ++it){
+	args.push_back(std::move(*it));
+      }
+      values.resize(task.base);
+
+      // a lambda call, as in Expression::eval
+      Atom head = node.head();
+      Environment & callerEnv = *task.env;
+      if(!args.empty() && callerEnv.is_exp(head)){
+	callLambda(callerEnv.get_exp(head), args, callerEnv, task.tail);
+      }
+      else if(!head.isSymbol()){
+	throw SemanticError("Error during evaluation: procedure name not symbol");
+      }
+      else if(!callerEnv.is_proc(head)){
+	throw SemanticError("Error during evaluation: symbol does not name a procedure");
+      }
+      else{
+	values.push_back(callerEnv.get_proc(head)(args));
+      }
+      break;
+    }
+
+    case ApplyTask:{
+      Environment & callerEnv = *task.env;
+      const Expression & operand = *node.tailConstBegin();
+      if(task.next == ProcedureEvaluated){
+	Procedure proc = nullptr;
+	bool valid = procedureOperand(node, callerEnv, values.back(), proc);
+	if(proc != nullptr && operand.getTailLength() != 0){
+	  throw SemanticError("Error during apply: first argument is not a procedure");
+	}
+	const Expression & list = *(node.tailConstBegin() + 1);
+	if(!valid || !(list.head().asSymbolId() == ListSymbol || list.isHeadList())){
+	  throw SemanticError("Error during apply: argument is wrong type: First should be procedure, Second should be list");
+	}
+	push(tasks, Task{ApplyTask, task.tail, OperandsEvaluated, &node, task.env, task.base});
+	push(tasks, Task{EvalTask, false, 0, &list, task.env, 0});
+	break;
+      }
+
+      std::vector<Expression> args;
+      args.reserve(values.back().getTailLength());
+      for(auto it = values.back().tailConstBegin(); it != values.back().tailConstEnd(); ++it){
+	args.push_back(*it);
+      }
+      values.pop_back();
+      Expression lambda = std::move(values.back());
+      values.pop_back();
+      if(operand.head().asSymbolId() == LambdaSymbol){
+	lambda = operand.eval(callerEnv);
+      }
+
+      // without arguments the call is a lookup of the procedure's name
+      if(args.empty()){
+	if(!lambda.isHeadLambda()){
+	  throw SemanticError("Error during evaluation: unknown symbol");
+	}
+	values.push_back(std::move(lambda));
+      }
+      else if(!lambda.isHeadLambda()){
+	values.push_back(callerEnv.get_proc(operand.head())(args));
+      }
+      else{
+	// apply in tail position is a tail call
+	callLambda(lambda, args, callerEnv, task.tail);
+      }
+      break;
+    }
+
+    case MapTask:{
+      Environment & callerEnv = *task.env;
+      const Atom & name = node.tailConstBegin()->head();
+      bool parallel = (node.head().asSymbolId() == PmapSymbol);
+      if(task.next == ProcedureEvaluated){
+	Procedure proc = nullptr;
+	bool valid = procedureOperand(node, callerEnv, values.back(), proc);
+	push(tasks, Task{MapTask, false, valid ? OperandsEvaluated : NoProcedure, &node, task.env, task.base});
+	push(tasks, Task{EvalTask, false, 0, &*(node.tailConstBegin() + 1), task.env, 0});
+	break;
+      }
+
+      if(task.next != Calling){
+	if(task.next == NoProcedure || !values.back().isHeadList()){
+	  throw SemanticError(parallel ?
+			      "Error during pmap: argument is wrong type: First should be procedure, Second should be list" :
+			      "Error during map: argument is wrong type: First should be procedure, Second should be list");
+	}
+	if(name.asSymbolId() == LambdaSymbol){
+	  values[task.base] = node.tailConstBegin()->eval(callerEnv);
+	}
+
+	// builtins do not recurse, nor is the stack shared with other threads
+	const Expression & list = values.back();
+	Procedure proc = values[task.base].isHeadLambda() ? nullptr : callerEnv.get_proc(name);
+	if(proc != nullptr || (parallel && Expression::runsInParallel(callerEnv, list.getTailLength()))){
+	  Expression value = parallel ?
+	    Expression::parallelMap(name, proc, values[task.base], list, callerEnv) :
+	    mapBuiltin(name, proc, list, callerEnv);
+	  values.resize(task.base);
+	  values.push_back(std::move(value));
+	  break;
+	}
+      }
+
+      // the results so far follow the procedure and the list
+      const Expression & list = values[task.base + 1];
+      std::size_t done = values.size() - task.base - 2;
+      if(done < list.getTailLength()){
+	std::vector<Expression> args(1, *(list.tailConstBegin() + done));
+	push(tasks, Task{MapTask, false, Calling, &node, task.env, task.base});
+	callLambda(Expression(values[task.base]), args, callerEnv, false);
+	break;
+      }
+      Expression value = listOf(values.begin() + task.base + 2, values.end());
+      values.resize(task.base);
+      values.push_back(std::move(value));
+      break;
+    }
+
+    case ReduceTask:{
+      Environment & callerEnv = *task.env;
+      const Atom & name = node.tailConstBegin()->head();
+      if(task.next == ProcedureEvaluated){
+	Procedure proc = nullptr;
+	bool valid = procedureOperand(node, callerEnv, values.back(), proc);
+	push(tasks, Task{ReduceTask, false, valid ? OperandsEvaluated : NoProcedure, &node, task.env, task.base});
+	push(tasks, Task{EvalTask, false, 0, &*(node.tailConstBegin() + 2), task.env, 0});
+	push(tasks, Task{EvalTask, false, 0, &*(node.tailConstBegin() + 1), task.env, 0});
+	break;
+      }
+
+      // the fold continues from the element after next - Calling
+      std::size_t index = task.next - Calling;
+      if(task.next == OperandsEvaluated || task.next == NoProcedure){
+	if(task.next == NoProcedure || !values.back().isHeadList()){
+	  throw SemanticError("Error during preduce: argument is wrong type: First should be procedure, Third should be list");
+	}
+	if(name.asSymbolId() == LambdaSymbol){
+	  values[task.base] = node.tailConstBegin()->eval(callerEnv);
+	}
+
+	const Expression & list = values.back();
+	Procedure proc = values[task.base].isHeadLambda() ? nullptr : callerEnv.get_proc(name);
+	if(proc != nullptr || list.getTailLength() == 0 || Expression::runsInParallel(callerEnv, list.getTailLength())){
+	  Expression value = Expression::parallelReduce(name, proc, values[task.base], values[task.base + 1], list, callerEnv);
+	  values.resize(task.base);
+	  values.push_back(std::move(value));
+	  break;
+	}
+
+	// the partial result starts as the first element
+	values.push_back(*list.tailConstBegin());
+	index = 1;
+      }
+
+      const Expression & list = values[task.base + 2];
+      std::vector<Expression> args(2);
+      if(index < list.getTailLength()){
+	args[0] = std::move(values.back());
+	args[1] = *(list.tailConstBegin() + index);
+	values.pop_back();
+	push(tasks, Task{ReduceTask, false, static_cast<std::uint32_t>(Calling + index + 1), &node, task.env, task.base});
+	callLambda(Expression(values[task.base]), args, callerEnv, false);
+	break;
+      }
+
+      // the partial result is folded from the initial value
+      args[0] = std::move(values[task.base + 1]);
+      args[1] = std::move(values.back());
+      Expression lambda = std::move(values[task.base]);
+      values.resize(task.base);
+      callLambda(lambda, args, callerEnv, false);
+      break;
+    }
+
+    case DefineTask:
+      task.env->add_exp(node.tailConstBegin()->head(), values.back());
+      break;
+
+    case FrameTask:
+      frames.pop_back();
+      break;
+
+    case MemoTask:
+      memos.back().store(values.back());
+      memos.pop_back();
+      break;
+    }
+  }
+
+  return std::move(values.back());
+}
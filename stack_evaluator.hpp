@@ -0,0 +1,95 @@
+/*! \file stack_evaluator.hpp
+Defines an evaluator that keeps its continuations on the heap.
+
+Expression::eval recurses on the C++ stack once per nested expression and
+several times per lambda call, so a deep expression or a long lambda
+recursion overflows the stack. The StackEvaluator walks the same tree with
+an explicit stack of pending work instead. A call in tail position of a
+lambda body, including the last form of a begin there, replaces the frame
+of the body rather than adding to the stack, so tail recursion runs in
+constant space, as does an apply there. The procedures that map, apply,
+pmap and preduce call are called on the same stack. The stack is bounded
+by a depth limit, and exceeding it raises a SemanticError.
+ */
+#ifndef STACK_EVALUATOR_HPP
+#define STACK_EVALUATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "environment.hpp"
+#include "expression.hpp"
+
+/*! \class StackEvaluator
+\brief Evaluates expressions with a heap-allocated continuation stack.
+
+Results and SemanticErrors are those of Expression::eval. The special-forms
+other than begin, define, apply, map, pmap and preduce, including
+registered ones, are evaluated by Expression::eval, so recursion through
+them still uses the C++ stack, as do the calls of pmap and preduce when
+they run on more than one thread.
+*/
+class StackEvaluator {
+public:
+
+  /// the depth limit of a new evaluator
+  static const std::size_t DefaultDepthLimit = 10000000;
+
+  /// construct an evaluator with the default depth limit
+  StackEvaluator() noexcept;
+
+  /// set the most pending continuations an evaluation may hold
+  void setDepthLimit(std::size_t limit) noexcept;
+
+  /// return the depth limit
+  std::size_t depthLimit() const noexcept;
+
+  /*! Evaluate an expression.
+    \param program the abstract syntax tree
+    \param env the environment, updated by any definitions
+    \return the value of the program
+    \throws SemanticError when a semantic error is encountered or the
+    depth limit is exceeded
+  */
+  Expression evaluate(const Expression & program, Environment & env);
+
+private:
+
+  // the kinds of pending work
+  enum TaskKind : std::uint8_t {
+    EvalTask,   // evaluate node, pushing its value
+    BeginTask,  // evaluate the forms of a begin in turn
+    CallTask,   // evaluate the operands of a call in turn, then call
+    DefineTask, // bind the value on top of the stack
+    ApplyTask,  // evaluate the operands of apply, then call
+    MapTask,    // evaluate the operands of map or pmap, then call for each element
+    ReduceTask, // evaluate the operands of preduce, then fold
+    FrameTask,  // discard the innermost lambda frame
+    MemoTask    // cache the value on top of the stack for the innermost memoized call
+  };
+
+  // one continuation
+  struct Task {
+    TaskKind kind;
+    bool tail;           // the value is that of the innermost lambda body
+    std::uint32_t next;  // the next operand to evaluate, or the stage of a procedure form
+    const Expression * node;
+    Environment * env;
+    std::size_t base;    // the value stack size when the task began
+  };
+
+  // a lambda call in progress, holding the body its tasks point into
+  struct Frame {
+    Environment env;
+    Expression body;
+  };
+
+  // push a task, checking the depth limit
+  void push(std::vector<Task> & tasks, const Task & task) const;
+
+  std::size_t m_depthLimit;
+};
+
+#endif
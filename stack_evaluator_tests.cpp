@@ -0,0 +1,144 @@
+#include "catch.hpp"
+
+#include <string>
+#include <sstream>
+
+#include "semantic_error.hpp"
+#include "interpreter.hpp"
+#include "stack_evaluator.hpp"
+
+// parse program into a stack engine interpreter with the given depth limit
+static void prepare(Interpreter & interp, const std::string & program, std::size_t limit){
+  interp.setEngine(Interpreter::StackEngine);
+  interp.setDepthLimit(limit);
+  std::istringstream iss(program);
+  REQUIRE(interp.parseStream(iss));
+}
+
+TEST_CASE( "Test the stack engine at depth 1000000", "[stack_evaluator]" ) {
+
+  const std::size_t depth = 1000000;
+
+  {
+    INFO("deeply nested expression");
+    std::string program;
+    for(std::size_t i = 0; i < depth; ++i){
+      program += "(+ 1 ";
+    }
+    program += "0" + std::string(depth, ')');
+
+    Interpreter interp;
+    prepare(interp, program, 4 * depth);
+    REQUIRE(interp.evaluate() == Expression(double(depth)));
+
+    interp.setDepthLimit(depth / 2);
+    REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+  }
+
+  {
+    INFO("deeply nested list");
+    std::string program;
+    for(std::size_t i = 0; i < depth; ++i){
+      program += "(list ";
+    }
+    program += "1" + std::string(depth, ')');
+
+    Interpreter interp;
+    prepare(interp, program, 4 * depth);
+    Expression result = interp.evaluate();
+    REQUIRE(result.isHeadList());
+    REQUIRE(result.getTailLength() == 1);
+  }
+
+  {
+    INFO("recursion through map and pmap over a deeply nested list");
+    std::string nested;
+    for(std::size_t i = 0; i < depth; ++i){
+      nested += "(list ";
+    }
+    nested += std::string(depth, ')');
+
+    for(std::string form : {"map", "pmap"}){
+      INFO(form);
+      Interpreter interp;
+      prepare(interp, "(begin (define f (lambda (l) (" + form + " f l))) (f " + nested + "))", 4 * depth);
+      Expression result = interp.evaluate();
+      REQUIRE(result.isHeadList());
+      REQUIRE(result.getTailLength() == 1);
+
+      interp.setDepthLimit(depth / 2);
+      REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+    }
+  }
+
+  // without conditionals a recursion ends in an error: ln of a negative number
+  const std::string lnError = "Error in call to natural log: invalid argument.";
+
+  {
+    INFO("tail recursion runs in constant space");
+    Interpreter interp;
+    prepare(interp, "(begin (define f (lambda (n) (begin (ln n) (f (- n 1))))) (f " +
+	    std::to_string(depth) + "))", 100);
+    try{
+      interp.evaluate();
+      FAIL("the recursion must end in an error");
+    }
+    catch(const SemanticError & ex){
+      REQUIRE(std::string(ex.what()) == lnError);
+    }
+  }
+
+  {
+    INFO("tail recursion through apply runs in constant space");
+    Interpreter interp;
+    prepare(interp, "(begin (define f (lambda (n) (begin (ln n) (apply f (list (- n 1)))))) (f " +
+	    std::to_string(depth) + "))", 100);
+    try{
+      interp.evaluate();
+      FAIL("the recursion must end in an error");
+    }
+    catch(const SemanticError & ex){
+      REQUIRE(std::string(ex.what()) == lnError);
+    }
+  }
+
+  {
+    INFO("recursion through apply beyond the depth limit");
+    Interpreter interp;
+    prepare(interp, "(begin (define f (lambda (n) (begin (ln n) (+ 1 (apply f (list (- n 1))))))) (f " +
+	    std::to_string(depth) + "))", 1000);
+    try{
+      interp.evaluate();
+      FAIL("the recursion must end in an error");
+    }
+    catch(const SemanticError & ex){
+      REQUIRE(std::string(ex.what()) == "Error during evaluation: maximum evaluation depth exceeded");
+    }
+  }
+
+  {
+    INFO("recursion beyond the depth limit");
+    Interpreter interp;
+    prepare(interp, "(begin (define f (lambda (n) (begin (ln n) (+ 1 (f (- n 1)))))) (f " +
+	    std::to_string(depth) + "))", 1000);
+    try{
+      interp.evaluate();
+      FAIL("the recursion must end in an error");
+    }
+    catch(const SemanticError & ex){
+      REQUIRE(std::string(ex.what()) == "Error during evaluation: maximum evaluation depth exceeded");
+    }
+
+    // the same recursion, ending before the limit
+    interp.setDepthLimit(1000000);
+    std::istringstream iss("(f 1000)");
+    REQUIRE(interp.parseStream(iss));
+    try{
+      interp.evaluate();
+      FAIL("the recursion must end in an error");
+    }
+    catch(const SemanticError & ex){
+      REQUIRE(std::string(ex.what()) == lnError);
+    }
+  }
+}
@@ -0,0 +1,53 @@
+#include "symbol_table.hpp"
+
+SymbolTable::SymbolTable() {
+
+  // must match the order of the BuiltinSymbol enum
+  const char * builtins[] = {"begin", "define", "lambda", "apply", "map",
+                             "set-property", "get-property",
+                             "discrete-plot", "continuous-plot",
+                             "memoize", "pmap", "preduce", "list"};
+
+  for (auto name : builtins) {
+    intern(name);
+  }
+}
+
+SymbolTable & SymbolTable::instance() {
+  // initialization of a function-local static is thread-safe
+  static SymbolTable table;
+  return table;
+}
+
+SymbolId SymbolTable::intern(const std::string & name) {
+  std::lock_guard<std::mutex> lock(the_mutex);
+
+  auto result = ids.find(name);
+  if (result != ids.end()) {
+    return result->second;
+  }
+
+  SymbolId id = static_cast<SymbolId>(names.size());
+  names.push_back(name);
+  ids.emplace(name, id);
+  return id;
+}
+
+const std::string & SymbolTable::name(SymbolId id) const {
+  static const std::string empty;
+
+  std::lock_guard<std::mutex> lock(the_mutex);
+  if (id >= names.size()) {
+    return empty;
+  }
+  return names[id];
+}
+
+std::size_t SymbolTable::size() const {
+  std::lock_guard<std::mutex> lock(the_mutex);
+  return names.size();
+}
+
+SymbolId intern(const std::string & name) {
+  return SymbolTable::instance().intern(name);
+}
@@ -0,0 +1,89 @@
+/*! \file symbol_table.hpp
+Defines the global symbol interner.
+
+Every symbol seen by the interpreter is interned exactly once and from then on
+is represented by a compact integer id. Comparing and hashing symbols is then
+an integer operation; the textual name is only looked up when it is printed.
+ */
+#ifndef SYMBOL_TABLE_HPP
+#define SYMBOL_TABLE_HPP
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/*! \typedef SymbolId
+\brief A compact integer handle for an interned symbol name.
+*/
+typedef std::uint32_t SymbolId;
+
+/*! \enum BuiltinSymbol
+\brief Symbols interned when the table is created, so their ids are constants.
+
+The order must match the names listed in SymbolTable::SymbolTable().
+*/
+enum BuiltinSymbol : SymbolId {
+  BeginSymbol = 0,
+  DefineSymbol,
+  LambdaSymbol,
+  ApplySymbol,
+  MapSymbol,
+  SetPropertySymbol,
+  GetPropertySymbol,
+  DiscretePlotSymbol,
+  ContinuousPlotSymbol,
+  MemoizeSymbol,
+  PmapSymbol,
+  PreduceSymbol,
+  ListSymbol,
+  BuiltinSymbolCount
+};
+
+/// id returned for atoms that are not symbols
+const SymbolId NoSymbol = static_cast<SymbolId>(-1);
+
+/*! \class SymbolTable
+\brief Thread-safe, process-wide table mapping symbol names to ids.
+
+Ids are never reused or invalidated, so they may be stored freely by any
+thread. Names are stored in a deque, so references returned by name() stay
+valid for the lifetime of the program.
+*/
+class SymbolTable {
+public:
+
+  /// return the process-wide symbol table
+  static SymbolTable & instance();
+
+  /// return the id of name, interning it if it has not been seen before
+  SymbolId intern(const std::string & name);
+
+  /// return the name of an interned id, or the empty string if unknown
+  const std::string & name(SymbolId id) const;
+
+  /// number of interned symbols
+  std::size_t size() const;
+
+private:
+
+  SymbolTable();
+
+  SymbolTable(const SymbolTable &) = delete;
+  SymbolTable & operator=(const SymbolTable &) = delete;
+
+  // name to id lookup
+  std::unordered_map<std::string, SymbolId> ids;
+
+  // id to name lookup, a deque so references stay valid on growth
+  std::deque<std::string> names;
+
+  // guards both containers
+  mutable std::mutex the_mutex;
+};
+
+/// convenience wrapper for SymbolTable::instance().intern(name)
+SymbolId intern(const std::string & name);
+
+#endif
@@ -9,6 +9,7 @@
 /************************************************************************************************************************/
 #include <queue>
 #include <mutex>
+#include <utility>
 #include <condition_variable>
 
 template<typename T>
@@ -25,6 +26,15 @@ public:
 		the_condition_variable.notify_one();
 	}
 
+	void push(T && value)
+	{
+		std::unique_lock<std::mutex>
+		lock(the_mutex);
+		the_queue.push(std::move(value));
+		lock.unlock();
+		the_condition_variable.notify_one();
+	}
+
 	bool empty() const 
 	{
 		std::lock_guard<std::mutex>
@@ -39,7 +49,7 @@ public:
 		if (the_queue.empty()) {
 			return false;
 		}
-		popped_value = the_queue.front();
+		popped_value = std::move(the_queue.front());
 		the_queue.pop();
 		return true;
 	}
@@ -51,7 +61,7 @@ public:
 		while (the_queue.empty()) {
 			the_condition_variable.wait(lock);
 		}
-		popped_value = the_queue.front();
+		popped_value = std::move(the_queue.front());
 		the_queue.pop();
 	}
 
@@ -1,8 +1,8 @@
 #include "token.hpp"
 
 // system includes
-#include <cctype>
-#include <iostream>
+#include <cstring>
+#include <iterator>
 
 // define constants for special characters
 const char OPENCHAR = '(';
@@ -14,6 +14,8 @@ Token::Token(TokenType t): m_type(t){}
 
 Token::Token(const std::string & str): m_type(STRING), value(str) {}
 
+Token::Token(const char * str, std::size_t length): m_type(STRING), value(str, length) {}
+
 Token::TokenType Token::type() const{
   return m_type;
 }
@@ -33,57 +35,114 @@ std::string Token::asString() const{
 }
 
 
-// add token to sequence unless it is empty, clears token
-void store_ifnot_empty(std::string & token, TokenSequenceType & seq){
-  if(!token.empty()){
-    seq.emplace_back(token);
-    token.clear();
+// character classes used by the scanner
+enum CharClass : unsigned char { ATOMCHAR, SPACECHAR, OPENCLASS, CLOSECLASS, COMMENTCLASS, QUOTECLASS };
+
+// table mapping every byte to its character class
+struct CharClassTable {
+  CharClassTable(){
+    for(int c = 0; c < 256; ++c){
+      classes[c] = ATOMCHAR;
+    }
+    // the characters std::isspace accepts in the "C" locale
+    for(char c : {' ', '\t', '\n', '\v', '\f', '\r'}){
+      classes[static_cast<unsigned char>(c)] = SPACECHAR;
+    }
+    classes[static_cast<unsigned char>(OPENCHAR)] = OPENCLASS;
+    classes[static_cast<unsigned char>(CLOSECHAR)] = CLOSECLASS;
+    classes[static_cast<unsigned char>(COMMENTCHAR)] = COMMENTCLASS;
+    classes[static_cast<unsigned char>(QUOTATION)] = QUOTECLASS;
   }
+
+  CharClass operator[](char c) const{
+    return classes[static_cast<unsigned char>(c)];
+  }
+
+  CharClass classes[256];
+};
+
+static const CharClassTable charClass;
+
+// return the first occurrence of c in [pos, end), or end if there is none
+static const char * find(const char * pos, const char * end, char c){
+  const void * found = std::memchr(pos, c, end - pos);
+  return found ? static_cast<const char *>(found) : end;
 }
 
-TokenSequenceType tokenize(std::istream & seq){
-  TokenSequenceType tokens;
-  std::string token;
-  
-  while(true){
-    char c = seq.get();
-
-    if(seq.eof()) break;
-    
-    if(c == COMMENTCHAR){
-      // chomp until the end of the line
-      while((!seq.eof()) && (c != '\n')){
-	c = seq.get();
+TokenScanner::TokenScanner(const char * source, std::size_t size):
+  m_begin(source), m_pos(source), m_end(source + size) {}
+
+bool TokenScanner::next(TokenSpan & span){
+  while(m_pos != m_end){
+    switch(charClass[*m_pos]){
+    case SPACECHAR:
+      ++m_pos;
+      break;
+    case COMMENTCLASS:
+      // skip to the end of the line
+      m_pos = find(m_pos, m_end, '\n');
+      break;
+    case OPENCLASS:
+      span = {Token::OPEN, offset(), 1};
+      ++m_pos;
+      return true;
+    case CLOSECLASS:
+      span = {Token::CLOSE, offset(), 1};
+      ++m_pos;
+      return true;
+    default:{
+      // an atom runs to the next delimiter outside of a quoted string
+      const char * start = m_pos;
+      while(m_pos != m_end){
+	CharClass c = charClass[*m_pos];
+	if(c == ATOMCHAR){
+	  ++m_pos;
+	}
+	else if(c == QUOTECLASS){
+	  const char * close = find(m_pos + 1, m_end, QUOTATION);
+	  m_pos = (close == m_end) ? m_end : close + 1;
+	}
+	else{
+	  break;
+	}
       }
-      if(seq.eof()) break;
-    }
-    else if(c == OPENCHAR){
-      store_ifnot_empty(token, tokens);
-      tokens.push_back(Token::TokenType::OPEN);
+      span = {Token::STRING, static_cast<std::size_t>(start - m_begin),
+	      static_cast<std::size_t>(m_pos - start)};
+      return true;
     }
-    else if(c == CLOSECHAR){
-      store_ifnot_empty(token, tokens);
-      tokens.push_back(Token::TokenType::CLOSE);
     }
-	
-	else if (c == QUOTATION) {
-		token.push_back(c);
-		c = seq.get();
-		while (c !=QUOTATION) {
-			token.push_back(c);
-			c = seq.get();
-			if (seq.eof()) break;
-		}
-		token.push_back(c);
-	}
-	
-    else if(isspace(c)){
-      store_ifnot_empty(token, tokens);
+  }
+  return false;
+}
+
+std::size_t TokenScanner::offset() const{
+  return m_pos - m_begin;
+}
+
+TokenSpanSequenceType tokenize(const char * source, std::size_t size){
+  TokenSpanSequenceType spans;
+  TokenScanner scanner(source, size);
+  TokenSpan span;
+  while(scanner.next(span)){
+    spans.push_back(span);
+  }
+  return spans;
+}
+
+TokenSequenceType tokenize(std::istream & seq){
+  std::string buffer((std::istreambuf_iterator<char>(seq)),
+		     std::istreambuf_iterator<char>());
+
+  TokenSequenceType tokens;
+  TokenScanner scanner(buffer.data(), buffer.size());
+  TokenSpan span;
+  while(scanner.next(span)){
+    if(span.type == Token::STRING){
+      tokens.emplace_back(buffer.data() + span.offset, span.length);
     }
     else{
-      token.push_back(c);
+      tokens.emplace_back(span.type);
     }
   }
-  store_ifnot_empty(token, tokens);
   return tokens;
 }
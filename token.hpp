@@ -4,8 +4,11 @@ Defines the Token and TokenSequence types, and associated functions.
 #ifndef TOKEN_HPP
 #define TOKEN_HPP
 
+#include <cstddef>
 #include <deque>
 #include <istream>
+#include <string>
+#include <vector>
 
 /*! \class Token
   \brief Value class representing a token.
@@ -30,6 +33,9 @@ public:
   /// contruct a token of type String with value
   Token(const std::string & str);
 
+  /// contruct a token of type String with the value [str, str+length)
+  Token(const char * str, std::size_t length);
+
   /// return the type of the token
   TokenType type() const;
 
@@ -47,6 +53,59 @@ sequential access should do.
  */
 typedef std::deque<Token> TokenSequenceType;
 
+/*! \class TokenSpan
+  \brief A token located in a source buffer.
+
+  A span does not own its text: for STRING tokens the value is the
+  length characters of the source starting at offset.
+*/
+struct TokenSpan {
+  Token::TokenType type;
+  std::size_t offset;
+  std::size_t length;
+};
+
+/*! \typedef TokenSpanSequenceType
+Define the sequence of token spans produced from a source buffer.
+ */
+typedef std::vector<TokenSpan> TokenSpanSequenceType;
+
+/*! \class TokenScanner
+  \brief Splits a contiguous buffer into token spans, one token at a time.
+
+  Characters are classified with a lookup table, and comments and quoted
+  strings are skipped with memchr, so no character is copied. The buffer
+  must outlive the scanner and the spans it returns.
+*/
+class TokenScanner {
+public:
+
+  /// construct a scanner over the size characters starting at source
+  TokenScanner(const char * source, std::size_t size);
+
+  /// store the next token in span, return false at the end of the buffer
+  bool next(TokenSpan & span);
+
+  /// return the offset of the first character not yet scanned
+  std::size_t offset() const;
+
+private:
+  const char * m_begin;
+  const char * m_pos;
+  const char * m_end;
+};
+
+/*! \fn TokenSpanSequenceType tokenize(const char * source, std::size_t size)
+\brief Split a buffer into a sequence of token spans
+
+\param source the first character of the buffer
+\param size the number of characters in the buffer
+\return The sequence of spans, as offsets into source
+
+Follows the same rules as tokenize(std::istream &).
+*/
+TokenSpanSequenceType tokenize(const char * source, std::size_t size);
+
 /*! \fn TokenSequenceType tokenize(std::istream & seq)
 \brief Split a stream into a sequnce of tokens
 
@@ -57,6 +116,8 @@ Split a stream into a sequnce of tokens where a token is one of
 OPEN or CLOSE or any space-delimited string
 
 Ignores any whitespace and comments (from any ";" to end-of-line).
+A quoted string may contain spaces, parentheses and ";". The stream is
+read into a buffer and split with TokenScanner.
 */
 TokenSequenceType tokenize(std::istream & seq);
 
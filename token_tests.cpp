@@ -82,3 +82,43 @@ TEST_CASE( "Test tokenize", "[token]" ) {
   REQUIRE(tokens.empty());
 }
 
+
+TEST_CASE( "Test tokenize buffer", "[token]" ) {
+  std::string input = "(define s \"a (b) ; c\");comment\n(f 1)x;\n \"open";
+
+  TokenSpanSequenceType spans = tokenize(input.data(), input.size());
+
+  std::vector<Token::TokenType> types = {Token::OPEN, Token::STRING, Token::STRING, Token::STRING,
+					  Token::CLOSE, Token::OPEN, Token::STRING, Token::STRING,
+					  Token::CLOSE, Token::STRING, Token::STRING};
+  std::vector<std::string> values = {"(", "define", "s", "\"a (b) ; c\"", ")", "(", "f", "1", ")", "x", "\"open"};
+
+  REQUIRE(spans.size() == types.size());
+  for(std::size_t i = 0; i < spans.size(); ++i){
+    REQUIRE(spans[i].type == types[i]);
+    REQUIRE(input.substr(spans[i].offset, spans[i].length) == values[i]);
+  }
+  REQUIRE(spans[1].offset == 1);
+  REQUIRE(spans[3].offset == 10);
+
+  // the stream wrapper produces the same tokens
+  std::istringstream iss(input);
+  TokenSequenceType tokens = tokenize(iss);
+  REQUIRE(tokens.size() == spans.size());
+  for(std::size_t i = 0; i < tokens.size(); ++i){
+    REQUIRE(tokens[i].type() == types[i]);
+    REQUIRE(tokens[i].asString() == values[i]);
+  }
+
+  // the scanner can be driven one token at a time
+  TokenScanner scanner(input.data(), 8);
+  TokenSpan span;
+  REQUIRE(scanner.next(span));
+  REQUIRE(span.type == Token::OPEN);
+  REQUIRE(scanner.next(span));
+  REQUIRE(span.length == 6);
+  REQUIRE(!scanner.next(span));
+  REQUIRE(scanner.offset() == 8);
+
+  REQUIRE(tokenize(input.data(), 0).empty());
+}
@@ -0,0 +1,546 @@
+#include "vector_kernels.hpp"
+
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+// the SIMD kernels need the GCC/Clang target attribute and cpu detection
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VECTOR_KERNELS_X86
+#include <immintrin.h>
+#define SSE2_TARGET __attribute__((target("sse2")))
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+// the polynomial kernels are always inlined into a loop compiled for the
+// right instruction set, so the vector ABI of their return values never
+// matters; they take vectors by reference for the same reason
+#if !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+typedef double v2d __attribute__((vector_size(16)));
+typedef long long v2l __attribute__((vector_size(16)));
+typedef double v4d __attribute__((vector_size(32)));
+typedef long long v4l __attribute__((vector_size(32)));
+#endif
+
+#if defined(__GNUC__)
+#define KERNEL_INLINE static inline __attribute__((always_inline))
+#else
+#define KERNEL_INLINE static inline
+#endif
+
+/***********************************************************************
+Element operations, one struct per VectorOp
+**********************************************************************/
+
+struct AddKernel {
+  static const bool simd = true;
+  static double scalar(double a, double b) { return a + b; }
+#ifdef VECTOR_KERNELS_X86
+  SSE2_TARGET static __m128d sse2(__m128d a, __m128d b) { return _mm_add_pd(a, b); }
+  AVX2_TARGET static __m256d avx2(__m256d a, __m256d b) { return _mm256_add_pd(a, b); }
+#endif
+};
+
+struct SubtractKernel {
+  static const bool simd = true;
+  static double scalar(double a, double b) { return a - b; }
+#ifdef VECTOR_KERNELS_X86
+  SSE2_TARGET static __m128d sse2(__m128d a, __m128d b) { return _mm_sub_pd(a, b); }
+  AVX2_TARGET static __m256d avx2(__m256d a, __m256d b) { return _mm256_sub_pd(a, b); }
+#endif
+};
+
+struct MultiplyKernel {
+  static const bool simd = true;
+  static double scalar(double a, double b) { return a * b; }
+#ifdef VECTOR_KERNELS_X86
+  SSE2_TARGET static __m128d sse2(__m128d a, __m128d b) { return _mm_mul_pd(a, b); }
+  AVX2_TARGET static __m256d avx2(__m256d a, __m256d b) { return _mm256_mul_pd(a, b); }
+#endif
+};
+
+struct DivideKernel {
+  static const bool simd = true;
+  static double scalar(double a, double b) { return a / b; }
+#ifdef VECTOR_KERNELS_X86
+  SSE2_TARGET static __m128d sse2(__m128d a, __m128d b) { return _mm_div_pd(a, b); }
+  AVX2_TARGET static __m256d avx2(__m256d a, __m256d b) { return _mm256_div_pd(a, b); }
+#endif
+};
+
+// there is no SIMD pow instruction, every instruction set uses libm
+struct PowerKernel {
+  static const bool simd = false;
+  static double scalar(double a, double b) { return std::pow(a, b); }
+#ifdef VECTOR_KERNELS_X86
+  SSE2_TARGET static __m128d sse2(__m128d a, __m128d) { return a; }
+  AVX2_TARGET static __m256d avx2(__m256d a, __m256d) { return a; }
+#endif
+};
+
+/***********************************************************************
+Loops over the arrays, one per instruction set
+**********************************************************************/
+
+template <typename Kernel>
+static void scalarLoop(const double * x, bool xBroadcast, const double * y, bool yBroadcast,
+                       double * out, std::size_t i, std::size_t n) {
+  for (; i < n; ++i) {
+    out[i] = Kernel::scalar(xBroadcast ? *x : x[i], yBroadcast ? *y : y[i]);
+  }
+}
+
+#ifdef VECTOR_KERNELS_X86
+
+template <typename Kernel>
+SSE2_TARGET static void sse2Loop(const double * x, bool xBroadcast, const double * y, bool yBroadcast,
+                                 double * out, std::size_t n) {
+  std::size_t i = 0;
+  if (Kernel::simd) {
+    const __m128d xs = _mm_set1_pd(*x);
+    const __m128d ys = _mm_set1_pd(*y);
+    for (; i + 2 <= n; i += 2) {
+      __m128d a = xBroadcast ? xs : _mm_loadu_pd(x + i);
+      __m128d b = yBroadcast ? ys : _mm_loadu_pd(y + i);
+      _mm_storeu_pd(out + i, Kernel::sse2(a, b));
+    }
+  }
+  scalarLoop<Kernel>(x, xBroadcast, y, yBroadcast, out, i, n);
+}
+
+template <typename Kernel>
+AVX2_TARGET static void avx2Loop(const double * x, bool xBroadcast, const double * y, bool yBroadcast,
+                                 double * out, std::size_t n) {
+  std::size_t i = 0;
+  if (Kernel::simd) {
+    const __m256d xs = _mm256_set1_pd(*x);
+    const __m256d ys = _mm256_set1_pd(*y);
+    for (; i + 4 <= n; i += 4) {
+      __m256d a = xBroadcast ? xs : _mm256_loadu_pd(x + i);
+      __m256d b = yBroadcast ? ys : _mm256_loadu_pd(y + i);
+      _mm256_storeu_pd(out + i, Kernel::avx2(a, b));
+    }
+  }
+  scalarLoop<Kernel>(x, xBroadcast, y, yBroadcast, out, i, n);
+}
+
+#endif
+
+template <typename Kernel>
+static void dispatch(VectorIsa isa, const double * x, bool xBroadcast, const double * y, bool yBroadcast,
+                     double * out, std::size_t n) {
+  if (n == 0) {
+    return;
+  }
+  switch (isa) {
+#ifdef VECTOR_KERNELS_X86
+  case Avx2Isa:
+    avx2Loop<Kernel>(x, xBroadcast, y, yBroadcast, out, n);
+    return;
+  case Sse2Isa:
+    sse2Loop<Kernel>(x, xBroadcast, y, yBroadcast, out, n);
+    return;
+#endif
+  default:
+    scalarLoop<Kernel>(x, xBroadcast, y, yBroadcast, out, 0, n);
+    return;
+  }
+}
+
+/***********************************************************************
+Polynomial kernels for the unary functions
+
+The kernels are written once against a lane type V with integer lanes L:
+double/long long for the scalar loop and GCC vector types for SSE2 and AVX2.
+The coefficients are the minimax polynomials of fdlibm.
+**********************************************************************/
+
+KERNEL_INLINE long long asBits(double v) {
+  long long bits;
+  std::memcpy(&bits, &v, sizeof(bits));
+  return bits;
+}
+
+KERNEL_INLINE double asDouble(long long bits, double) {
+  double v;
+  std::memcpy(&v, &bits, sizeof(v));
+  return v;
+}
+
+KERNEL_INLINE double select(bool mask, double a, double b) { return mask ? a : b; }
+KERNEL_INLINE long long select(bool mask, long long a, long long b) { return mask ? a : b; }
+
+#ifdef VECTOR_KERNELS_X86
+KERNEL_INLINE v2l asBits(const v2d & v) { return (v2l)v; }
+KERNEL_INLINE v4l asBits(const v4d & v) { return (v4l)v; }
+KERNEL_INLINE v2d asDouble(const v2l & bits, const v2d &) { return (v2d)bits; }
+KERNEL_INLINE v4d asDouble(const v4l & bits, const v4d &) { return (v4d)bits; }
+KERNEL_INLINE v2d select(const v2l & mask, const v2d & a, const v2d & b) { return mask ? a : b; }
+KERNEL_INLINE v4d select(const v4l & mask, const v4d & a, const v4d & b) { return mask ? a : b; }
+KERNEL_INLINE v2l select(const v2l & mask, const v2l & a, const v2l & b) { return mask ? a : b; }
+KERNEL_INLINE v4l select(const v4l & mask, const v4l & a, const v4l & b) { return mask ? a : b; }
+#endif
+
+// largest argument reduced by the kernels, 2^19 pi/2; above it the
+// product of the quadrant and the pi/2 pieces would no longer be exact
+static const double trigLimit = 823549.6654753485;
+
+// Cody-Waite reduction: r = x - k pi/2 with k = round(x 2/pi), pi/2 split in
+// three 33-bit pieces so every product k * piece is exact. The low bits of
+// quadrant hold k, which selects the polynomial and the sign.
+template <typename V, typename L>
+KERNEL_INLINE V reduceQuarterPi(const V & x, L & quadrant) {
+  const double invpio2 = 6.36619772367581382433e-01;
+  const double pio2_1 = 1.57079632673412561417e+00;
+  const double pio2_2 = 6.07710050630396597660e-11;
+  const double pio2_3 = 2.02226624871116645580e-21;
+  // adding 1.5 * 2^52 rounds to an integer held in the low mantissa bits
+  const double toInt = 6755399441055744.0;
+
+  V t = x * invpio2 + toInt;
+  quadrant = asBits(t);
+  V k = t - toInt;
+  return ((x - k * pio2_1) - k * pio2_2) - k * pio2_3;
+}
+
+// sin(r) for |r| <= pi/4
+template <typename V>
+KERNEL_INLINE V sinPolynomial(const V & r) {
+  const double S1 = -1.66666666666666324348e-01;
+  const double S2 = 8.33333333332248946124e-03;
+  const double S3 = -1.98412698298579493134e-04;
+  const double S4 = 2.75573137070700676789e-06;
+  const double S5 = -2.50507602534068634195e-08;
+  const double S6 = 1.58969099521155010221e-10;
+
+  V z = r * r;
+  V p = S2 + z * (S3 + z * (S4 + z * (S5 + z * S6)));
+  return r + (z * r) * (S1 + z * p);
+}
+
+// cos(r) for |r| <= pi/4
+template <typename V>
+KERNEL_INLINE V cosPolynomial(const V & r) {
+  const double C1 = 4.16666666666666019037e-02;
+  const double C2 = -1.38888888888741095749e-03;
+  const double C3 = 2.48015872894767294178e-05;
+  const double C4 = -2.75573143513906633035e-07;
+  const double C5 = 2.08757232129817482790e-09;
+  const double C6 = -1.13596475577881948265e-11;
+
+  V z = r * r;
+  V p = z * (C1 + z * (C2 + z * (C3 + z * (C4 + z * (C5 + z * C6)))));
+  V hz = 0.5 * z;
+  V w = 1.0 - hz;
+  return w + (((1.0 - w) - hz) + z * p);
+}
+
+template <typename V, typename L>
+KERNEL_INLINE V sinKernel(const V & x, long long shift) {
+  L quadrant;
+  V r = reduceQuarterPi(x, quadrant);
+  quadrant = quadrant + shift;
+  V result = select((quadrant & 1) != 0, cosPolynomial(r), sinPolynomial(r));
+  return select((quadrant & 2) != 0, -result, result);
+}
+
+template <typename V, typename L>
+KERNEL_INLINE V tanKernel(const V & x) {
+  L quadrant;
+  V r = reduceQuarterPi(x, quadrant);
+  V s = sinPolynomial(r);
+  V c = cosPolynomial(r);
+  return select((quadrant & 1) != 0, -c / s, s / c);
+}
+
+// log(x) for positive normal x: x = 2^k (1 + f) with 1 + f in [sqrt(2)/2, sqrt(2))
+template <typename V, typename L>
+KERNEL_INLINE V logKernel(const V & x) {
+  const double Lg1 = 6.666666666666735130e-01;
+  const double Lg2 = 3.999999999940941908e-01;
+  const double Lg3 = 2.857142874366239149e-01;
+  const double Lg4 = 2.222219843214978396e-01;
+  const double Lg5 = 1.818357216161805012e-01;
+  const double Lg6 = 1.531383769920937332e-01;
+  const double Lg7 = 1.479819860511658591e-01;
+  const double ln2_hi = 6.93147180369123816490e-01;
+  const double ln2_lo = 1.90821492927058770002e-10;
+  const double sqrt2 = 1.41421356237309514547;
+  const long long mantissaMask = 0x000fffffffffffffLL;
+  const long long oneExponent = 0x3ff0000000000000LL;
+  // exponent | bits of 2^52, read as a double, is 2^52 + exponent
+  const long long twoTo52 = 0x4330000000000000LL;
+
+  L bits = asBits(x);
+  L exponent = bits >> 52;
+  V m = asDouble((bits & mantissaMask) | oneExponent, x);
+  L big = (m > sqrt2);
+  m = select(big, m * 0.5, m);
+  exponent = select(big, exponent + 1, exponent);
+  V k = asDouble(exponent | twoTo52, x) - (4503599627370496.0 + 1023.0);
+
+  V f = m - 1.0;
+  V s = f / (2.0 + f);
+  V z = s * s;
+  V w = z * z;
+  V t1 = w * (Lg2 + w * (Lg4 + w * Lg6));
+  V t2 = z * (Lg1 + w * (Lg3 + w * (Lg5 + w * Lg7)));
+  V R = t2 + t1;
+  V hfsq = 0.5 * f * f;
+  return k * ln2_hi - ((hfsq - (s * (hfsq + R) + k * ln2_lo)) - f);
+}
+
+template <typename V, typename L>
+KERNEL_INLINE V unaryKernel(VectorFunction f, const V & x) {
+  switch (f) {
+  case VectorSin:
+    return sinKernel<V, L>(x, 0);
+  case VectorCos:
+    return sinKernel<V, L>(x, 1);
+  case VectorTan:
+    return tanKernel<V, L>(x);
+  default:
+    return logKernel<V, L>(x);
+  }
+}
+
+// inputs the polynomial kernels do not handle are recomputed with libm
+static void unaryFixup(VectorFunction f, const double * x, double * out, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i) {
+    double v = x[i];
+    if (f == VectorLog) {
+      if (!(v >= DBL_MIN && v <= DBL_MAX)) {
+        out[i] = std::log(v);
+      }
+    }
+    else if (!(std::fabs(v) <= trigLimit)) {
+      out[i] = (f == VectorSin) ? std::sin(v) : (f == VectorCos) ? std::cos(v) : std::tan(v);
+    }
+  }
+}
+
+static void unaryScalarLoop(VectorFunction f, const double * x, double * out, std::size_t i, std::size_t n) {
+  for (; i < n; ++i) {
+    out[i] = (f == VectorSqrt) ? std::sqrt(x[i]) : unaryKernel<double, long long>(f, x[i]);
+  }
+}
+
+#ifdef VECTOR_KERNELS_X86
+
+SSE2_TARGET static void unarySse2Loop(VectorFunction f, const double * x, double * out, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    if (f == VectorSqrt) {
+      _mm_storeu_pd(out + i, _mm_sqrt_pd(_mm_loadu_pd(x + i)));
+      continue;
+    }
+    v2d v;
+    std::memcpy(&v, x + i, sizeof(v));
+    v = unaryKernel<v2d, v2l>(f, v);
+    std::memcpy(out + i, &v, sizeof(v));
+  }
+  unaryScalarLoop(f, x, out, i, n);
+}
+
+AVX2_TARGET static void unaryAvx2Loop(VectorFunction f, const double * x, double * out, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    if (f == VectorSqrt) {
+      _mm256_storeu_pd(out + i, _mm256_sqrt_pd(_mm256_loadu_pd(x + i)));
+      continue;
+    }
+    v4d v;
+    std::memcpy(&v, x + i, sizeof(v));
+    v = unaryKernel<v4d, v4l>(f, v);
+    std::memcpy(out + i, &v, sizeof(v));
+  }
+  unaryScalarLoop(f, x, out, i, n);
+}
+
+#endif
+
+/***********************************************************************
+Reductions
+**********************************************************************/
+
+static void minMaxScalarLoop(const double * x, std::size_t i, std::size_t n, double & min, double & max) {
+  for (; i < n; ++i) {
+    if (x[i] < min) {
+      min = x[i];
+    }
+    if (x[i] > max) {
+      max = x[i];
+    }
+  }
+}
+
+#ifdef VECTOR_KERNELS_X86
+
+// MINPD and MAXPD return their second operand unless the first compares
+// less, or greater, so each lane keeps the scalar loop's rule for NaNs
+
+SSE2_TARGET static void minMaxSse2Loop(const double * x, std::size_t n, double & min, double & max) {
+  __m128d low = _mm_set1_pd(x[0]);
+  __m128d high = low;
+  std::size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    __m128d v = _mm_loadu_pd(x + i);
+    low = _mm_min_pd(v, low);
+    high = _mm_max_pd(v, high);
+  }
+  double lows[2], highs[2];
+  _mm_storeu_pd(lows, low);
+  _mm_storeu_pd(highs, high);
+  min = lows[0];
+  max = highs[0];
+  for (int lane = 1; lane < 2; ++lane) {
+    min = (lows[lane] < min) ? lows[lane] : min;
+    max = (highs[lane] > max) ? highs[lane] : max;
+  }
+  minMaxScalarLoop(x, i, n, min, max);
+}
+
+AVX2_TARGET static void minMaxAvx2Loop(const double * x, std::size_t n, double & min, double & max) {
+  __m256d low = _mm256_set1_pd(x[0]);
+  __m256d high = low;
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d v = _mm256_loadu_pd(x + i);
+    low = _mm256_min_pd(v, low);
+    high = _mm256_max_pd(v, high);
+  }
+  double lows[4], highs[4];
+  _mm256_storeu_pd(lows, low);
+  _mm256_storeu_pd(highs, high);
+  min = lows[0];
+  max = highs[0];
+  for (int lane = 1; lane < 4; ++lane) {
+    min = (lows[lane] < min) ? lows[lane] : min;
+    max = (highs[lane] > max) ? highs[lane] : max;
+  }
+  minMaxScalarLoop(x, i, n, min, max);
+}
+
+#endif
+
+/***********************************************************************
+Instruction set selection
+**********************************************************************/
+
+// -1 until the first kernel call or setVectorIsa
+static std::atomic<int> selectedIsa(-1);
+
+VectorIsa vectorIsaSupported() {
+#ifdef VECTOR_KERNELS_X86
+  if (__builtin_cpu_supports("avx2")) {
+    return Avx2Isa;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return Sse2Isa;
+  }
+#endif
+  return ScalarIsa;
+}
+
+VectorIsa vectorIsa() {
+  int isa = selectedIsa.load(std::memory_order_relaxed);
+  if (isa < 0) {
+    isa = vectorIsaSupported();
+    selectedIsa.store(isa, std::memory_order_relaxed);
+  }
+  return static_cast<VectorIsa>(isa);
+}
+
+bool setVectorIsa(VectorIsa isa) {
+  if (isa > vectorIsaSupported()) {
+    return false;
+  }
+  selectedIsa.store(isa, std::memory_order_relaxed);
+  return true;
+}
+
+const char * vectorIsaName(VectorIsa isa) {
+  switch (isa) {
+  case Avx2Isa:
+    return "avx2";
+  case Sse2Isa:
+    return "sse2";
+  default:
+    return "scalar";
+  }
+}
+
+void vectorBinary(VectorOp op, const double * x, bool xBroadcast,
+                  const double * y, bool yBroadcast, double * out, std::size_t n) {
+  VectorIsa isa = vectorIsa();
+  switch (op) {
+  case VectorAdd:
+    dispatch<AddKernel>(isa, x, xBroadcast, y, yBroadcast, out, n);
+    break;
+  case VectorSubtract:
+    dispatch<SubtractKernel>(isa, x, xBroadcast, y, yBroadcast, out, n);
+    break;
+  case VectorMultiply:
+    dispatch<MultiplyKernel>(isa, x, xBroadcast, y, yBroadcast, out, n);
+    break;
+  case VectorDivide:
+    dispatch<DivideKernel>(isa, x, xBroadcast, y, yBroadcast, out, n);
+    break;
+  case VectorPower:
+    dispatch<PowerKernel>(isa, x, xBroadcast, y, yBroadcast, out, n);
+    break;
+  }
+}
+
+void vectorUnary(VectorFunction f, const double * x, double * out, std::size_t n) {
+  if (n == 0) {
+    return;
+  }
+  // the fixup pass reads x again, so an aliased input must be kept
+  std::vector<double> aliased;
+  const double * in = x;
+  if (x == out && f != VectorSqrt) {
+    aliased.assign(x, x + n);
+    in = aliased.data();
+  }
+
+  switch (vectorIsa()) {
+#ifdef VECTOR_KERNELS_X86
+  case Avx2Isa:
+    unaryAvx2Loop(f, in, out, n);
+    break;
+  case Sse2Isa:
+    unarySse2Loop(f, in, out, n);
+    break;
+#endif
+  default:
+    unaryScalarLoop(f, in, out, 0, n);
+    break;
+  }
+
+  if (f != VectorSqrt) {
+    unaryFixup(f, in, out, n);
+  }
+}
+
+void vectorMinMax(const double * x, std::size_t n, double & min, double & max) {
+  switch (vectorIsa()) {
+#ifdef VECTOR_KERNELS_X86
+  case Avx2Isa:
+    minMaxAvx2Loop(x, n, min, max);
+    break;
+  case Sse2Isa:
+    minMaxSse2Loop(x, n, min, max);
+    break;
+#endif
+  default:
+    min = x[0];
+    max = x[0];
+    minMaxScalarLoop(x, 1, n, min, max);
+    break;
+  }
+}
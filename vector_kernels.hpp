@@ -0,0 +1,98 @@
+/*! \file vector_kernels.hpp
+Defines element-wise numeric kernels over contiguous arrays of doubles.
+
+The kernels back the list-aware arithmetic and transcendental builtins.
+Each one has a scalar implementation and, on x86, SSE2 and AVX2
+implementations; the widest instruction set supported by the running
+processor is selected the first time a kernel is called.
+ */
+#ifndef VECTOR_KERNELS_HPP
+#define VECTOR_KERNELS_HPP
+
+#include <cstddef>
+
+/*! \enum VectorOp
+\brief The binary operations provided by vectorBinary().
+*/
+enum VectorOp {
+  VectorAdd,
+  VectorSubtract,
+  VectorMultiply,
+  VectorDivide,
+  VectorPower
+};
+
+/*! \enum VectorFunction
+\brief The unary functions provided by vectorUnary().
+*/
+enum VectorFunction {
+  VectorSin,
+  VectorCos,
+  VectorTan,
+  VectorLog,
+  VectorSqrt
+};
+
+/*! \enum VectorIsa
+\brief The instruction sets a kernel may be executed with.
+*/
+enum VectorIsa {
+  ScalarIsa,
+  Sse2Isa,
+  Avx2Isa
+};
+
+/*! Compute out[i] = x[i] op y[i] for i in [0, n).
+
+  A broadcast operand points to a single value that is used for every i.
+  out may alias x or y when they are not broadcast.
+  \param op the operation
+  \param x the left operand
+  \param xBroadcast true if x is a single value
+  \param y the right operand
+  \param yBroadcast true if y is a single value
+  \param out the destination, n elements
+  \param n the number of elements
+*/
+void vectorBinary(VectorOp op, const double * x, bool xBroadcast,
+                  const double * y, bool yBroadcast, double * out, std::size_t n);
+
+/*! Compute out[i] = f(x[i]) for i in [0, n).
+
+  sin, cos and tan reduce their argument by a constant number of operations
+  and evaluate minimax polynomials. For |x| <= 2^19 pi/2 sin and cos are
+  within 2 ULP of libm and tan within 4 ULP; larger and non-finite arguments
+  defer to libm. log is within 1 ULP of libm for positive normal numbers and
+  defers to libm for every other input. sqrt is correctly rounded. Every
+  instruction set gives identical results. out may alias x.
+  \param f the function
+  \param x the operand, n elements
+  \param out the destination, n elements
+  \param n the number of elements
+*/
+void vectorUnary(VectorFunction f, const double * x, double * out, std::size_t n);
+
+/*! Find the least and greatest of x[0] to x[n - 1], as a loop keeping
+  x[0] and replacing it by each element that compares less, or greater,
+  would: a NaN is skipped unless it is x[0], when it is the result. Zeros of
+  either sign compare equal, and either may be returned.
+  \param x the elements, n of them
+  \param n the number of elements, at least 1
+  \param min set to the least element
+  \param max set to the greatest element
+*/
+void vectorMinMax(const double * x, std::size_t n, double & min, double & max);
+
+/// return the instruction set the kernels currently use
+VectorIsa vectorIsa();
+
+/// return the widest instruction set supported by this processor
+VectorIsa vectorIsaSupported();
+
+/// select the instruction set to use, returns false if it is not supported
+bool setVectorIsa(VectorIsa isa);
+
+/// return a printable name for an instruction set
+const char * vectorIsaName(VectorIsa isa);
+
+#endif
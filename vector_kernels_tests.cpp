@@ -0,0 +1,210 @@
+#include "catch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "vector_kernels.hpp"
+
+// equal, treating two NaNs as equal
+static bool same(double a, double b) {
+  return (std::isnan(a) && std::isnan(b)) || a == b;
+}
+
+TEST_CASE( "Test vector kernels on every supported instruction set", "[vector_kernels]" ) {
+
+  VectorIsa original = vectorIsa();
+
+  // odd length so the scalar tail after the SIMD loop is exercised
+  const std::size_t n = 37;
+  std::vector<double> x(n), y(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    x[i] = 0.25 * i - 3.0;
+    y[i] = 1.5 + 0.125 * i;
+  }
+  const double scalar = 2.5;
+
+  const VectorOp ops[] = {VectorAdd, VectorSubtract, VectorMultiply, VectorDivide, VectorPower};
+  for (int isa = ScalarIsa; isa <= vectorIsaSupported(); ++isa) {
+    INFO(vectorIsaName(static_cast<VectorIsa>(isa)));
+    REQUIRE(setVectorIsa(static_cast<VectorIsa>(isa)));
+    REQUIRE(vectorIsa() == isa);
+
+    for (VectorOp op : ops) {
+      std::vector<double> both(n), left(n), right(n);
+      vectorBinary(op, x.data(), false, y.data(), false, both.data(), n);
+      vectorBinary(op, &scalar, true, y.data(), false, left.data(), n);
+      vectorBinary(op, x.data(), false, &scalar, true, right.data(), n);
+
+      for (std::size_t i = 0; i < n; ++i) {
+        double expectBoth, expectLeft, expectRight;
+        switch (op) {
+        case VectorAdd:
+          expectBoth = x[i] + y[i]; expectLeft = scalar + y[i]; expectRight = x[i] + scalar;
+          break;
+        case VectorSubtract:
+          expectBoth = x[i] - y[i]; expectLeft = scalar - y[i]; expectRight = x[i] - scalar;
+          break;
+        case VectorMultiply:
+          expectBoth = x[i] * y[i]; expectLeft = scalar * y[i]; expectRight = x[i] * scalar;
+          break;
+        case VectorDivide:
+          expectBoth = x[i] / y[i]; expectLeft = scalar / y[i]; expectRight = x[i] / scalar;
+          break;
+        default:
+          expectBoth = std::pow(x[i], y[i]); expectLeft = std::pow(scalar, y[i]); expectRight = std::pow(x[i], scalar);
+          break;
+        }
+        // the basic operations are correctly rounded on every instruction set
+        REQUIRE(same(both[i], expectBoth));
+        REQUIRE(same(left[i], expectLeft));
+        REQUIRE(same(right[i], expectRight));
+      }
+    }
+
+    // the destination may alias an input
+    std::vector<double> inPlace(x);
+    vectorBinary(VectorMultiply, inPlace.data(), false, &scalar, true, inPlace.data(), n);
+    REQUIRE(inPlace[n - 1] == x[n - 1] * scalar);
+  }
+
+  REQUIRE(setVectorIsa(original));
+  if (vectorIsaSupported() != Avx2Isa) {
+    REQUIRE(!setVectorIsa(Avx2Isa));
+  }
+}
+
+TEST_CASE( "Test vectorMinMax on every supported instruction set", "[vector_kernels]" ) {
+
+  VectorIsa original = vectorIsa();
+
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  std::vector<double> x(37);
+  for (std::size_t i = 0; i < x.size(); ++i) {
+    x[i] = std::sin(0.7 * i) * i;
+  }
+  const double least = *std::min_element(x.begin(), x.end());
+  const double greatest = *std::max_element(x.begin(), x.end());
+
+  for (int isa = ScalarIsa; isa <= vectorIsaSupported(); ++isa) {
+    INFO(vectorIsaName(static_cast<VectorIsa>(isa)));
+    REQUIRE(setVectorIsa(static_cast<VectorIsa>(isa)));
+
+    // every length, so each lane and the scalar tail hold the extremes
+    for (std::size_t n = 1; n <= x.size(); ++n) {
+      double min, max;
+      vectorMinMax(x.data(), n, min, max);
+      REQUIRE(min == *std::min_element(x.begin(), x.begin() + n));
+      REQUIRE(max == *std::max_element(x.begin(), x.begin() + n));
+    }
+
+    // a NaN after the first element is skipped
+    std::vector<double> holes(x);
+    holes[5] = nan;
+    holes[30] = nan;
+    double min, max;
+    vectorMinMax(holes.data(), holes.size(), min, max);
+    REQUIRE(min == least);
+    REQUIRE(max == greatest);
+
+    // a NaN first is kept, as by a loop starting from it
+    holes[0] = nan;
+    vectorMinMax(holes.data(), holes.size(), min, max);
+    REQUIRE(std::isnan(min));
+    REQUIRE(std::isnan(max));
+  }
+
+  REQUIRE(setVectorIsa(original));
+}
+
+// distance in units in the last place between two finite doubles
+static long long ulpDistance(double a, double b) {
+  if (a == b) {
+    return 0;
+  }
+  long long x, y;
+  std::memcpy(&x, &a, sizeof(x));
+  std::memcpy(&y, &b, sizeof(y));
+  // map the sign-magnitude bit patterns onto a monotonic integer line
+  x = (x < 0) ? std::numeric_limits<long long>::min() - x : x;
+  y = (y < 0) ? std::numeric_limits<long long>::min() - y : y;
+  return (x > y) ? x - y : y - x;
+}
+
+TEST_CASE( "Test unary kernels against libm", "[vector_kernels]" ) {
+
+  VectorIsa original = vectorIsa();
+
+  struct { VectorFunction f; double (*reference)(double); double low, high; long long maxUlp; } cases[] = {
+    {VectorSin, std::sin, -10, 10, 2},
+    {VectorSin, std::sin, -8e5, 8e5, 2},
+    {VectorCos, std::cos, -10, 10, 2},
+    {VectorCos, std::cos, -8e5, 8e5, 2},
+    {VectorTan, std::tan, -10, 10, 4},
+    {VectorTan, std::tan, -8e5, 8e5, 4},
+    {VectorLog, std::log, 0, 10, 1},
+    {VectorLog, std::log, 0, 1e300, 1},
+    {VectorSqrt, std::sqrt, 0, 1e300, 0},
+  };
+
+  // a fixed seed keeps the inputs identical on every run
+  std::mt19937_64 generator(3574);
+  for (auto & c : cases) {
+    std::uniform_real_distribution<double> distribution(c.low, c.high);
+    std::vector<double> x(4001);
+    for (auto & v : x) {
+      v = distribution(generator);
+    }
+
+    std::vector<double> first;
+    for (int isa = ScalarIsa; isa <= vectorIsaSupported(); ++isa) {
+      INFO(vectorIsaName(static_cast<VectorIsa>(isa)) << " over [" << c.low << ", " << c.high << "]");
+      REQUIRE(setVectorIsa(static_cast<VectorIsa>(isa)));
+
+      std::vector<double> out(x.size());
+      vectorUnary(c.f, x.data(), out.data(), x.size());
+
+      long long worst = 0;
+      for (std::size_t i = 0; i < x.size(); ++i) {
+        worst = std::max(worst, ulpDistance(out[i], c.reference(x[i])));
+      }
+      REQUIRE(worst <= c.maxUlp);
+
+      // every instruction set computes the same bits
+      if (first.empty()) {
+        first = out;
+      }
+      REQUIRE(out == first);
+    }
+  }
+
+  REQUIRE(setVectorIsa(original));
+}
+
+TEST_CASE( "Test unary kernels on special values", "[vector_kernels]" ) {
+
+  const double inf = std::numeric_limits<double>::infinity();
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  const double x[] = {0.0, -0.0, 1e9, -1e300, inf, -inf, nan, 5e-324, -1.0, 1.0};
+  const std::size_t n = sizeof(x) / sizeof(x[0]);
+
+  const VectorFunction functions[] = {VectorSin, VectorCos, VectorTan, VectorLog, VectorSqrt};
+  double (*references[])(double) = {std::sin, std::cos, std::tan, std::log, std::sqrt};
+  for (int f = 0; f < 5; ++f) {
+    double out[n];
+    vectorUnary(functions[f], x, out, n);
+    for (std::size_t i = 0; i < n; ++i) {
+      INFO(f << " " << x[i]);
+      // special values match exactly, ordinary ones within the kernel bound
+      REQUIRE((same(out[i], references[f](x[i])) || ulpDistance(out[i], references[f](x[i])) <= 4));
+    }
+  }
+
+  // the destination may alias the input
+  double inPlace[] = {0.5, 1.5, 2.5, 3.5, 4.5};
+  vectorUnary(VectorCos, inPlace, inPlace, 5);
+  REQUIRE(ulpDistance(inPlace[4], std::cos(4.5)) <= 2);
+}